@@ -0,0 +1,18 @@
+QT       += core
+QT       -= gui
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = subshop-bench
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+include(../SubtitleWorkshop/core.pri)
+
+SOURCES += \
+    allocationcounter.cpp \
+    main.cpp
+
+HEADERS += \
+    allocationcounter.h
@@ -0,0 +1,78 @@
+#include "allocationcounter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+std::atomic<qint64> Count(0);
+std::atomic<qint64> Bytes(0);
+
+inline void Counted(std::size_t size) {
+    Count.fetch_add(1, std::memory_order_relaxed);
+    Bytes.fetch_add(qint64(size), std::memory_order_relaxed);
+}
+
+}
+
+#if defined(__GLIBC__)
+
+// The executable's definitions take the place of libc's, which stay
+// reachable under these names
+extern "C" {
+void *__libc_malloc(std::size_t size);
+void *__libc_calloc(std::size_t count, std::size_t size);
+void *__libc_realloc(void *pointer, std::size_t size);
+
+void *malloc(std::size_t size) {
+    Counted(size);
+    return __libc_malloc(size);
+}
+
+void *calloc(std::size_t count, std::size_t size) {
+    Counted(count * size);
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *pointer, std::size_t size) {
+    Counted(size);
+    return __libc_realloc(pointer, size);
+}
+}
+
+bool AllocationCounter::isComplete() {
+    return true;
+}
+
+#else
+
+void *operator new(std::size_t size) {
+    Counted(size);
+    if (void *pointer = std::malloc(size ? size : 1))
+        return pointer;
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void *pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, std::size_t) noexcept {
+    std::free(pointer);
+}
+
+bool AllocationCounter::isComplete() {
+    return false;
+}
+
+#endif
+
+qint64 AllocationCounter::getCount() {
+    return Count.load(std::memory_order_relaxed);
+}
+
+qint64 AllocationCounter::getBytes() {
+    return Bytes.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <QtGlobal>
+
+// Heap allocations made by the process so far. With glibc every malloc,
+// calloc and realloc is counted, which covers Qt's containers as well as
+// operator new. Elsewhere only operator new can be hooked portably, so
+// QString/QVector buffers don't show up there.
+namespace AllocationCounter {
+
+qint64 getCount();
+// Requested, not what the allocator rounds them up to
+qint64 getBytes();
+
+// Whether Qt's own buffers are counted too
+bool isComplete();
+
+}
@@ -0,0 +1,414 @@
+#include <algorithm>
+#include <random>
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSysInfo>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QThread>
+
+#include "allocationcounter.h"
+#include "retiming.h"
+#include "subparser.h"
+#include "subtitletimeline.h"
+
+namespace {
+
+// Every benchmark runs at least MinIterations times and until it took
+// MinTime in total, but no more than MaxIterations times
+const int MinIterations = 3;
+const int MaxIterations = 1000;
+const qint64 MinTimeNs = 250 * 1000000LL;
+
+// Lookups per timeline benchmark at most, a 1M cue file would take 50M
+// at the player's 50 ms interval
+const int MaxLookups = 1000000;
+
+const int CueSpacing = 2500;
+const int CueDuration = 2000;
+
+struct Result {
+    QString Name;
+    int Cues = 0;
+    // Read or written per iteration, 0 where it doesn't apply
+    qint64 Bytes = 0;
+    // Cues or lookups handled per iteration
+    qint64 Operations = 0;
+    int Iterations = 0;
+    qint64 BestNs = 0;
+    qint64 MedianNs = 0;
+    // Per iteration
+    qint64 Allocations = 0;
+    qint64 AllocatedBytes = 0;
+
+    double getMegabytesPerSecond() const {
+        return BestNs > 0 ? Bytes / (1024.0 * 1024.0) / (BestNs / 1e9) : 0.0;
+    }
+
+    double getOperationsPerSecond() const {
+        return BestNs > 0 ? Operations / (BestNs / 1e9) : 0.0;
+    }
+
+    QJsonObject toJson() const {
+        QJsonObject Object;
+        Object["name"] = Name;
+        Object["cues"] = Cues;
+        Object["bytes"] = double(Bytes);
+        Object["operations"] = double(Operations);
+        Object["iterations"] = Iterations;
+        Object["best_ns"] = double(BestNs);
+        Object["median_ns"] = double(MedianNs);
+        Object["megabytes_per_second"] = getMegabytesPerSecond();
+        Object["operations_per_second"] = getOperationsPerSecond();
+        Object["allocations"] = double(Allocations);
+        Object["allocated_bytes"] = double(AllocatedBytes);
+        return Object;
+    }
+};
+
+// Runs setup then body until the limits above are reached, only body is
+// timed and has its allocations counted. QBENCHMARK times a body too, but
+// has no untimed setup per iteration, no allocation counts, no median and
+// no JSON to compare runs with.
+template <typename Setup, typename Body>
+Result Measure(const QString &name, int cues, qint64 bytes, qint64 operations, Setup setup, Body body) {
+    QVector<qint64> Times;
+    qint64 TotalNs = 0, Allocations = 0, AllocatedBytes = 0;
+
+    while (Times.size() < MinIterations || (TotalNs < MinTimeNs && Times.size() < MaxIterations)) {
+        setup();
+
+        qint64 CountBefore = AllocationCounter::getCount();
+        qint64 BytesBefore = AllocationCounter::getBytes();
+
+        QElapsedTimer Timer;
+        Timer.start();
+        body();
+        qint64 ns = Timer.nsecsElapsed();
+
+        Allocations += AllocationCounter::getCount() - CountBefore;
+        AllocatedBytes += AllocationCounter::getBytes() - BytesBefore;
+
+        Times.append(ns);
+        TotalNs += ns;
+    }
+
+    std::sort(Times.begin(), Times.end());
+
+    Result result;
+    result.Name = name;
+    result.Cues = cues;
+    result.Bytes = bytes;
+    result.Operations = operations;
+    result.Iterations = Times.size();
+    result.BestNs = Times.first();
+    result.MedianNs = Times.at(Times.size() / 2);
+    result.Allocations = Allocations / Times.size();
+    result.AllocatedBytes = AllocatedBytes / Times.size();
+    return result;
+}
+
+template <typename Body>
+Result Measure(const QString &name, int cues, qint64 bytes, qint64 operations, Body body) {
+    return Measure(name, cues, bytes, operations, []() {}, body);
+}
+
+// Writes a synthetic subtitle file with count two-line cues
+bool WriteCorpus(const QString &filepath, int count, bool vtt) {
+    QFile File(filepath);
+    if (!File.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    QByteArray Data;
+    if (vtt) {
+        Data.append("WEBVTT\n\n");
+    }
+
+    char Line[64];
+    for (int i = 0; i < count; i++) {
+        qint64 show = qint64(i) * CueSpacing;
+        qint64 hide = show + CueDuration;
+        char sep = vtt ? '.' : ',';
+
+        if (!vtt) {
+            Data.append(QByteArray::number(i + 1)).append('\n');
+        }
+
+        qsnprintf(Line, sizeof(Line), "%02lld:%02lld:%02lld%c%03lld --> %02lld:%02lld:%02lld%c%03lld\n",
+                  show / 3600000, show / 60000 % 60, show / 1000 % 60, sep, show % 1000,
+                  hide / 3600000, hide / 60000 % 60, hide / 1000 % 60, sep, hide % 1000);
+        Data.append(Line);
+        Data.append("Synthetic subtitle line number ").append(QByteArray::number(i)).append('\n');
+        Data.append("<i>with a second, styled line</i>\n\n");
+    }
+
+    return File.write(Data) == Data.size();
+}
+
+// Same for an ASS script, with a few styles and override tags per line
+bool WriteScriptCorpus(const QString &filepath, int count) {
+    QFile File(filepath);
+    if (!File.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    QByteArray Data;
+    Data.append("[Script Info]\nScriptType: v4.00+\n\n");
+    Data.append("[V4+ Styles]\nFormat: Name, Fontname, Fontsize, Bold, Italic\n");
+    Data.append("Style: Default,Arial,20,0,0\nStyle: Sign,Arial,20,-1,0\nStyle: Song,Arial,20,0,-1\n\n");
+    Data.append("[Events]\nFormat: Layer, Start, End, Style, Name, MarginL, MarginR, MarginV, Effect, Text\n");
+
+    static const char *Styles[] = { "Default", "Sign", "Song" };
+
+    char Line[128];
+    for (int i = 0; i < count; i++) {
+        // In centiseconds
+        qint64 show = qint64(i) * CueSpacing / 10;
+        qint64 hide = show + CueDuration / 10;
+
+        qsnprintf(Line, sizeof(Line), "Dialogue: %d,%lld:%02lld:%02lld.%02lld,%lld:%02lld:%02lld.%02lld,%s,,0,0,0,,",
+                  i % 2, show / 360000, show / 6000 % 60, show / 100 % 60, show % 100,
+                  hide / 360000, hide / 6000 % 60, hide / 100 % 60, hide % 100, Styles[i % 3]);
+        Data.append(Line);
+        Data.append("{\\fad(200,200)}Synthetic subtitle line number ").append(QByteArray::number(i));
+        Data.append("\\N{\\i1}with a second, styled line{\\i0}\n");
+    }
+
+    return File.write(Data) == Data.size();
+}
+
+QString Pad(const QString &text, int width) {
+    return text.leftJustified(width);
+}
+
+void Print(const Result &result) {
+    QTextStream out(stdout);
+
+    out << Pad(result.Name, 18) << Pad(QString::number(result.Cues), 9)
+        << Pad(QString::number(result.Iterations) + "x", 7)
+        << Pad(QString::number(result.BestNs / 1e6, 'f', 2) + " ms", 13)
+        << Pad(QString::number(result.MedianNs / 1e6, 'f', 2) + " ms", 13);
+
+    if (result.Bytes > 0) {
+        out << Pad(QString::number(result.getMegabytesPerSecond(), 'f', 1) + " MB/s", 14);
+    }
+    else {
+        out << Pad(QString(), 14);
+    }
+
+    out << Pad(QString::number(result.getOperationsPerSecond() / 1e6, 'f', 2) + " M/s", 12)
+        << result.Allocations << " allocs, " << QString::number(result.AllocatedBytes / (1024.0 * 1024.0), 'f', 2) << " MB\n";
+}
+
+QList<SubtitleItem> ParseAss(const QString &filepath) {
+    QList<SubtitleItem> Items;
+    SubtitleStyleTable Styles;
+    SubParser::ParseFile(filepath, SubParser::CueFormat::ASS, Items, &Styles);
+    return Items;
+}
+
+}
+
+int main(int argc, char *argv[]) {
+    QCoreApplication a(argc, argv);
+    QTextStream err(stderr);
+
+    QCommandLineParser Parser;
+    Parser.setApplicationDescription("Time Subshop's parsers, exporters, sorting and timeline lookups on synthetic files.");
+    Parser.addHelpOption();
+
+    QCommandLineOption SizesOption("sizes", "Comma separated cue counts (default: 1000,10000,100000,1000000).", "counts", "1000,10000,100000,1000000");
+    QCommandLineOption FilterOption("filter", "Only run benchmarks whose name contains <text>.", "text");
+    QCommandLineOption JsonOption("json", "Also write the results to <file> as JSON.", "file");
+    Parser.addOptions({ SizesOption, FilterOption, JsonOption });
+
+    Parser.process(a);
+
+    QVector<int> Sizes;
+    for (const QString &size : Parser.value(SizesOption).split(',', Qt::SkipEmptyParts)) {
+        bool ok;
+        int Count = size.trimmed().toInt(&ok);
+        if (!ok || Count <= 0) {
+            err << "Invalid size \"" << size << "\"\n";
+            return 1;
+        }
+        Sizes.append(Count);
+    }
+
+    QString Filter = Parser.value(FilterOption);
+    auto isSelected = [&Filter](const QString &name) {
+        return Filter.isEmpty() || name.contains(Filter, Qt::CaseInsensitive);
+    };
+
+    QTemporaryDir Dir;
+    QList<Result> Results;
+
+    auto Record = [&Results](const Result &result) {
+        Print(result);
+        Results.append(result);
+    };
+
+    if (!AllocationCounter::isComplete()) {
+        err << "Only operator new is counted on this platform, Qt's buffers aren't\n";
+    }
+
+    for (int Count : Sizes) {
+        QString SrtPath = Dir.filePath("corpus.srt");
+        QString VttPath = Dir.filePath("corpus.vtt");
+        QString AssPath = Dir.filePath("corpus.ass");
+
+        if (!WriteCorpus(SrtPath, Count, false) || !WriteCorpus(VttPath, Count, true) || !WriteScriptCorpus(AssPath, Count)) {
+            err << "Couldn't write benchmark corpus to " << Dir.path() << "\n";
+            return 1;
+        }
+
+        qint64 SrtBytes = QFileInfo(SrtPath).size();
+        qint64 VttBytes = QFileInfo(VttPath).size();
+        qint64 AssBytes = QFileInfo(AssPath).size();
+
+        if (isSelected("ParseSrt")) {
+            Record(Measure("ParseSrt", Count, SrtBytes, Count, [&]() { SubParser::ParseSrt(SrtPath); }));
+        }
+        if (isSelected("ParseVtt")) {
+            Record(Measure("ParseVtt", Count, VttBytes, Count, [&]() { SubParser::ParseVtt(VttPath); }));
+        }
+        if (isSelected("ParseAss")) {
+            Record(Measure("ParseAss", Count, AssBytes, Count, [&]() { ParseAss(AssPath); }));
+        }
+
+        QList<SubtitleItem> Items = SubParser::ParseSrt(SrtPath);
+        SubtitleStore Store;
+        Store.append(Items);
+
+        struct ExportCase {
+            const char *Name;
+            SubParser::CueFormat Format;
+            const char *FileName;
+        };
+        const ExportCase Exports[] = {
+            { "ExportSrt", SubParser::CueFormat::SRT, "export.srt" },
+            { "ExportVtt", SubParser::CueFormat::VTT, "export.vtt" }
+        };
+
+        for (const ExportCase &exp : Exports) {
+            if (!isSelected(exp.Name))
+                continue;
+
+            QString Path = Dir.filePath(exp.FileName);
+            bool Failed = false;
+            Result result = Measure(exp.Name, Count, 0, Count, [&]() { Failed |= !SubParser::Export(Store, Path, exp.Format); });
+            if (Failed) {
+                err << exp.Name << ": couldn't write " << Path << "\n";
+                return 1;
+            }
+
+            result.Bytes = QFileInfo(Path).size();
+            Record(result);
+        }
+
+        // The same cues in a fixed random order, so runs are comparable
+        QList<SubtitleItem> Shuffled = Items;
+        std::shuffle(Shuffled.begin(), Shuffled.end(), std::mt19937(42));
+
+        if (isSelected("SortByShowTime")) {
+            QList<SubtitleItem> Sorting;
+            Record(Measure("SortByShowTime", Count, 0, Count,
+                           [&]() { Sorting = Shuffled; Sorting.detach(); },
+                           [&]() { std::sort(Sorting.begin(), Sorting.end(), SubtitleItem::SortByShowTime); }));
+        }
+
+        if (isSelected("SortStore")) {
+            SubtitleStore ShuffledStore;
+            ShuffledStore.append(Shuffled);
+
+            // Copying the store is shallow, sort() pays for detaching it
+            SubtitleStore Sorting;
+            Record(Measure("SortStore", Count, 0, Count,
+                           [&]() { Sorting = ShuffledStore; },
+                           [&]() { Sorting.sort(); }));
+        }
+
+        if (isSelected("Retime")) {
+            // A frame rate conversion of every cue, as Edit applies it. The
+            // setup puts the original times back, which isn't timed.
+            SubtitleStore Retimed = Store;
+            Retiming Retime = Retiming::Stretch(25.0 / 23.976, 1000);
+            QVector<qint64> ShowTimes(Count);
+            QVector<qint64> HideTimes(Count);
+
+            Record(Measure("Retime", Count, 0, Count,
+                           [&]() { Retimed.setTimes(0, Store.getShowTimes(), Store.getHideTimes()); },
+                           [&]() {
+                               Retime.Apply(Retimed.getShowTimes().constData(), Retimed.getHideTimes().constData(), ShowTimes.data(), HideTimes.data(), Count);
+                               Retimed.setTimes(0, ShowTimes, HideTimes);
+                           }));
+        }
+
+        // What the player asks for during playback, every 50 ms from start
+        // to end, and from random seeks. The index is built once up front,
+        // only the lookups are timed.
+        SubtitleTimeline Timeline(&Store);
+        Timeline.ActiveAt(0);
+        qint64 Duration = qint64(Count) * CueSpacing;
+
+        if (isSelected("ActiveAtPlayback")) {
+            qint64 Step = qMax<qint64>(50, Duration / MaxLookups);
+            qint64 Lookups = Duration / Step;
+
+            Record(Measure("ActiveAtPlayback", Count, 0, Lookups,
+                           [&]() {
+                               for (qint64 position = 0; position < Duration; position += Step) {
+                                   Timeline.ActiveAt(position);
+                               }
+                           }));
+        }
+
+        if (isSelected("ActiveAtSeek")) {
+            QVector<qint64> Positions(qMin(MaxLookups, Count * 10));
+            std::mt19937_64 Random(42);
+            for (qint64 &position : Positions) {
+                position = qint64(Random() % quint64(Duration));
+            }
+
+            Record(Measure("ActiveAtSeek", Count, 0, Positions.size(),
+                           [&]() {
+                               for (qint64 position : Positions) {
+                                   Timeline.ActiveAt(position);
+                               }
+                           }));
+        }
+    }
+
+    if (Parser.isSet(JsonOption)) {
+        QJsonArray Array;
+        for (const Result &result : Results) {
+            Array.append(result.toJson());
+        }
+
+        QJsonObject Root;
+        Root["timestamp"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+        Root["qt_version"] = QString(qVersion());
+        Root["os"] = QSysInfo::prettyProductName();
+        Root["cpu_architecture"] = QSysInfo::currentCpuArchitecture();
+        Root["threads"] = QThread::idealThreadCount();
+        Root["allocations_complete"] = AllocationCounter::isComplete();
+        Root["results"] = Array;
+
+        QFile File(Parser.value(JsonOption));
+        if (!File.open(QIODevice::WriteOnly) || File.write(QJsonDocument(Root).toJson()) < 0) {
+            err << "Couldn't write \"" << File.fileName() << "\"\n";
+            return 1;
+        }
+    }
+
+    return 0;
+}
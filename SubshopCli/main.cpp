@@ -0,0 +1,350 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QHash>
+#include <QTextStream>
+#include <QThreadPool>
+#include <QtConcurrent>
+
+#include "formatregistry.h"
+#include "framerate.h"
+#include "retiming.h"
+#include "subtitlelinter.h"
+
+struct Options {
+    // Empty keeps the format of each input
+    QString TargetSuffix;
+    QString OutputDir;
+    bool InPlace = false;
+
+    qint64 Shift = 0;
+    // Source frame rate over target frame rate
+    double FramerateRatio = 1.0;
+
+    bool Validate = false;
+
+    bool isWriting() const { return !TargetSuffix.isEmpty() || Shift != 0 || FramerateRatio != 1.0 || !OutputDir.isEmpty(); }
+};
+
+struct FileResult {
+    QString Path;
+    QString OutputPath;
+    bool Success = false;
+    QString Error;
+
+    int Cues = 0;
+    qint64 Bytes = 0;
+    qint64 ParseNs = 0;
+    qint64 WriteNs = 0;
+
+    QStringList Problems;
+};
+
+static QStringList Validate(const SubtitleStore &store) {
+    QVector<SubtitleLinter::Problems> RowProblems = SubtitleLinter::Lint(store);
+    QStringList Problems;
+
+    for (int i = 0; i < store.size(); i++) {
+        if (RowProblems.at(i) == SubtitleLinter::NoProblem)
+            continue;
+
+        QString Where = "cue " + QString::number(i + 1) + " (" + SubtitleItem::FormatTime(store.getShowTime(i)) + ")";
+        for (const QString &problem : SubtitleLinter::Describe(RowProblems.at(i))) {
+            Problems.append(Where + ": " + problem);
+        }
+    }
+
+    return Problems;
+}
+
+static QString OutputPath(const QString &path, const SubtitleFormat *inputFormat, const Options &options) {
+    QFileInfo Info(path);
+
+    // Files that were only recognised by their content keep their format
+    QString Suffix = options.TargetSuffix;
+    if (Suffix.isEmpty()) {
+        Suffix = FormatRegistry::Instance().ForSuffix(Info.suffix()) == inputFormat ? Info.suffix().toLower() : inputFormat->getSuffixes().first();
+    }
+
+    QString Dir = options.OutputDir.isEmpty() ? Info.absolutePath() : options.OutputDir;
+    return QDir(Dir).filePath(Info.completeBaseName() + "." + Suffix);
+}
+
+// What two paths are compared by
+static QString PathKey(const QString &path) {
+#ifdef Q_OS_WIN
+    return QFileInfo(path).absoluteFilePath().toLower();
+#else
+    return QFileInfo(path).absoluteFilePath();
+#endif
+}
+
+// Files are processed in parallel, so no output may be another file's
+// input or another file's output too. An output may only be its own
+// input with --in-place.
+static bool CheckOutputs(const QStringList &files, const Options &options, QTextStream &err) {
+    QHash<QString, QString> Inputs;
+    for (const QString &file : files) {
+        Inputs.insert(PathKey(file), file);
+    }
+
+    QHash<QString, QString> Outputs;
+    bool isValid = true;
+
+    for (const QString &file : files) {
+        // Reported when it's processed
+        const SubtitleFormat *Format = FormatRegistry::Instance().Detect(file);
+        if (!Format)
+            continue;
+
+        QString Output = OutputPath(file, Format, options);
+        QString Key = PathKey(Output);
+
+        if (Key == PathKey(file)) {
+            if (!options.InPlace) {
+                err << file << ": error: output would overwrite the input, pass --in-place or --output-dir\n";
+                isValid = false;
+            }
+        }
+        else if (Inputs.contains(Key)) {
+            err << file << ": error: output \"" << Output << "\" would overwrite the input " << Inputs.value(Key) << "\n";
+            isValid = false;
+        }
+
+        if (Outputs.contains(Key)) {
+            err << file << ": error: output \"" << Output << "\" is written for " << Outputs.value(Key) << " too\n";
+            isValid = false;
+        }
+        else {
+            Outputs.insert(Key, file);
+        }
+    }
+
+    return isValid;
+}
+
+static FileResult ProcessFile(const QString &path, const Options &options) {
+    FileResult Result;
+    Result.Path = path;
+
+    QFileInfo Info(path);
+    Result.Bytes = Info.size();
+
+    const SubtitleFormat *InputFormat = FormatRegistry::Instance().Detect(path);
+    if (!InputFormat) {
+        Result.Error = "unsupported file type \"" + Info.suffix() + "\"";
+        return Result;
+    }
+
+    QElapsedTimer Timer;
+    Timer.start();
+
+    SubtitleStore Subtitles;
+    if (!InputFormat->ReadFile(path, Subtitles)) {
+        Result.Error = "couldn't read file";
+        return Result;
+    }
+
+    Result.Cues = Subtitles.size();
+    Result.ParseNs = Timer.nsecsElapsed();
+
+    if (options.Validate) {
+        Result.Problems = Validate(Subtitles);
+    }
+
+    if (!options.isWriting()) {
+        Result.Success = true;
+        return Result;
+    }
+
+    // Framerate first, so the shift is in the target's time. Cues shifted
+    // before zero are kept at zero with their duration.
+    if (options.FramerateRatio != 1.0 || options.Shift != 0) {
+        Retiming Retime = Retiming::Stretch(options.FramerateRatio).Then(Retiming::Shift(options.Shift));
+
+        QVector<qint64> ShowTimes(Subtitles.size());
+        QVector<qint64> HideTimes(Subtitles.size());
+        Retime.Apply(Subtitles.getShowTimes().constData(), Subtitles.getHideTimes().constData(), ShowTimes.data(), HideTimes.data(), ShowTimes.size());
+
+        Subtitles.setTimes(0, ShowTimes, HideTimes);
+    }
+
+    // Checked against every other file's by CheckOutputs
+    Result.OutputPath = OutputPath(path, InputFormat, options);
+
+    const SubtitleFormat *OutputFormat = FormatRegistry::Instance().ForSuffix(QFileInfo(Result.OutputPath).suffix());
+
+    SubParser::ExportStats Stats;
+    if (!OutputFormat->Write(Subtitles, Result.OutputPath, &Stats)) {
+        Result.Error = "couldn't write \"" + Result.OutputPath + "\"";
+        return Result;
+    }
+
+    Result.WriteNs = Stats.Nanoseconds;
+    Result.Success = true;
+    return Result;
+}
+
+static QStringList CollectInputs(const QStringList &arguments) {
+    QStringList Files;
+
+    for (const QString &argument : arguments) {
+        QFileInfo Info(argument);
+        if (Info.isDir()) {
+            QStringList Patterns;
+            for (const SubtitleFormat *format : FormatRegistry::Instance().getFormats()) {
+                for (const QString &suffix : format->getSuffixes()) {
+                    Patterns.append("*." + suffix);
+                }
+            }
+
+            QDirIterator it(argument, Patterns, QDir::Files, QDirIterator::Subdirectories);
+            while (it.hasNext()) {
+                Files.append(it.next());
+            }
+        }
+        else {
+            Files.append(argument);
+        }
+    }
+
+    return Files;
+}
+
+static QString Milliseconds(qint64 ns) {
+    return QString::number(ns / 1e6, 'f', 2) + " ms";
+}
+
+int main(int argc, char *argv[]) {
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("subshop-cli");
+
+    QCommandLineParser Parser;
+    Parser.setApplicationDescription("Convert, retime and validate subtitle files in bulk.");
+    Parser.addHelpOption();
+    Parser.addPositionalArgument("inputs", "Subtitle files or directories to process.", "<inputs...>");
+
+    QCommandLineOption ToOption(QStringList() << "t" << "to", "Convert to <format> (srt, vtt, ass, ssa or subshop).", "format");
+    QCommandLineOption OutputOption(QStringList() << "o" << "output-dir", "Write results to <dir> instead of next to the inputs.", "dir");
+    QCommandLineOption InPlaceOption("in-place", "Allow overwriting the input files.");
+    QCommandLineOption ShiftOption(QStringList() << "s" << "shift", "Shift every cue by <ms> milliseconds, may be negative.", "ms");
+    QCommandLineOption FpsFromOption("fps-from", "Frame rate the subtitles were timed for.", "fps");
+    QCommandLineOption FpsToOption("fps-to", "Frame rate to retime the subtitles to.", "fps");
+    QCommandLineOption ValidateOption("validate", "Report timing and content problems.");
+    QCommandLineOption JobsOption(QStringList() << "j" << "jobs", "Process <n> files at a time (default: all cores).", "n");
+
+    Parser.addOptions({ ToOption, OutputOption, InPlaceOption, ShiftOption, FpsFromOption, FpsToOption, ValidateOption, JobsOption });
+    Parser.process(a);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    Options options;
+    options.InPlace = Parser.isSet(InPlaceOption);
+    options.Validate = Parser.isSet(ValidateOption);
+    options.OutputDir = Parser.value(OutputOption);
+
+    if (Parser.isSet(ToOption)) {
+        options.TargetSuffix = Parser.value(ToOption).toLower();
+        if (!FormatRegistry::Instance().ForSuffix(options.TargetSuffix)) {
+            err << "Unsupported target format \"" << options.TargetSuffix << "\"\n";
+            return 1;
+        }
+    }
+
+    if (Parser.isSet(ShiftOption)) {
+        bool ok;
+        options.Shift = Parser.value(ShiftOption).toLongLong(&ok);
+        if (!ok) {
+            err << "Invalid shift \"" << Parser.value(ShiftOption) << "\"\n";
+            return 1;
+        }
+    }
+
+    if (Parser.isSet(FpsFromOption) != Parser.isSet(FpsToOption)) {
+        err << "--fps-from and --fps-to go together\n";
+        return 1;
+    }
+
+    if (Parser.isSet(FpsFromOption)) {
+        // 23.976 and the like are taken as the exact NTSC rates
+        FrameRate from = FrameRate::FromFps(Parser.value(FpsFromOption).toDouble());
+        FrameRate to = FrameRate::FromFps(Parser.value(FpsToOption).toDouble());
+        if (!from.isValid() || !to.isValid()) {
+            err << "Invalid frame rates\n";
+            return 1;
+        }
+
+        options.FramerateRatio = from.getFps() / to.getFps();
+    }
+
+    if (!options.OutputDir.isEmpty() && !QDir().mkpath(options.OutputDir)) {
+        err << "Couldn't create output directory \"" << options.OutputDir << "\"\n";
+        return 1;
+    }
+
+    if (Parser.isSet(JobsOption)) {
+        QThreadPool::globalInstance()->setMaxThreadCount(qMax(1, Parser.value(JobsOption).toInt()));
+    }
+
+    QStringList Files = CollectInputs(Parser.positionalArguments());
+    if (Files.isEmpty()) {
+        Parser.showHelp(1);
+    }
+
+    if (!options.isWriting()) {
+        options.Validate = true;
+    }
+    else if (!CheckOutputs(Files, options, err)) {
+        return 1;
+    }
+
+    QElapsedTimer Timer;
+    Timer.start();
+
+    QList<FileResult> Results = QtConcurrent::blockingMapped<QList<FileResult>>(Files, [&options](const QString &path) {
+        return ProcessFile(path, options);
+    });
+
+    qint64 TotalNs = Timer.nsecsElapsed();
+
+    int Failed = 0, WithProblems = 0;
+    qint64 TotalBytes = 0;
+    for (const FileResult &result : Results) {
+        if (!result.Success) {
+            Failed++;
+            err << result.Path << ": error: " << result.Error << "\n";
+            continue;
+        }
+
+        TotalBytes += result.Bytes;
+
+        out << result.Path << ": " << result.Cues << " cues, parse " << Milliseconds(result.ParseNs);
+        if (!result.OutputPath.isEmpty()) {
+            out << ", write " << Milliseconds(result.WriteNs) << " -> " << result.OutputPath;
+        }
+        out << "\n";
+
+        if (!result.Problems.isEmpty()) {
+            WithProblems++;
+            for (const QString &problem : result.Problems) {
+                out << "  " << problem << "\n";
+            }
+        }
+    }
+
+    out << Results.size() << " files (" << Failed << " failed";
+    if (options.Validate) {
+        out << ", " << WithProblems << " with problems";
+    }
+    out << ") in " << Milliseconds(TotalNs) << " on " << QThreadPool::globalInstance()->maxThreadCount() << " threads, "
+        << QString::number(TotalBytes / (1024.0 * 1024.0) / (TotalNs / 1e9), 'f', 1) << " MB/s\n";
+
+    if (Failed > 0)
+        return 1;
+
+    return WithProblems > 0 ? 2 : 0;
+}
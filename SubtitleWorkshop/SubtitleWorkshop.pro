@@ -17,20 +17,56 @@ DEFINES += QT_DEPRECATED_WARNINGS
 # You can also select to disable deprecated APIs only up to a certain version of Qt.
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
+include(core.pri)
+
 SOURCES += \
     aboutdialog.cpp \
+    alignedtracksmodel.cpp \
+    autosavejournal.cpp \
+    cuescheduler.cpp \
+    framegrabber.cpp \
     main.cpp \
     mainwindow.cpp \
-    subparser.cpp \
-    subtitleitem.cpp \
-    undoitem.cpp
+    markedslider.cpp \
+    overlaycache.cpp \
+    referencetrack.cpp \
+    searchpanel.cpp \
+    shotanalyzer.cpp \
+    shotdetector.cpp \
+    shotindex.cpp \
+    shotworker.cpp \
+    subtitleloader.cpp \
+    subtitletablemodel.cpp \
+    trackspanel.cpp \
+    undoitem.cpp \
+    undostack.cpp \
+    waveformloader.cpp \
+    waveformpeaks.cpp \
+    waveformwidget.cpp
 
 HEADERS += \
     aboutdialog.h \
+    alignedtracksmodel.h \
+    autosavejournal.h \
+    cuescheduler.h \
+    framegrabber.h \
     mainwindow.h \
-    subparser.h \
-    subtitleitem.h \
-    undoitem.h
+    markedslider.h \
+    overlaycache.h \
+    referencetrack.h \
+    searchpanel.h \
+    shotanalyzer.h \
+    shotdetector.h \
+    shotindex.h \
+    shotworker.h \
+    subtitleloader.h \
+    subtitletablemodel.h \
+    trackspanel.h \
+    undoitem.h \
+    undostack.h \
+    waveformloader.h \
+    waveformpeaks.h \
+    waveformwidget.h
 
 FORMS += \
     aboutdialog.ui \
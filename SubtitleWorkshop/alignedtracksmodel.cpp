@@ -0,0 +1,81 @@
+#include "alignedtracksmodel.h"
+
+AlignedTracksModel::AlignedTracksModel(QObject *parent) : QAbstractTableModel(parent) {}
+
+int AlignedTracksModel::rowCount(const QModelIndex &parent) const {
+    if (parent.isValid())
+        return 0;
+
+    return Alignment.getRowCount();
+}
+
+int AlignedTracksModel::columnCount(const QModelIndex &parent) const {
+    if (parent.isValid())
+        return 0;
+
+    return FirstTrackColumn + Tracks.size();
+}
+
+QVariant AlignedTracksModel::data(const QModelIndex &index, int role) const {
+    if (!index.isValid() || index.row() >= Alignment.getRowCount())
+        return QVariant();
+
+    if (role != Qt::DisplayRole && role != Qt::ToolTipRole)
+        return QVariant();
+
+    if (index.column() == TimeColumn)
+        return SubtitleItem::FormatTime(Alignment.getRowTime(index.row()));
+
+    int track = index.column() - FirstTrackColumn;
+    const SubtitleStore *Subtitles = Tracks.at(track);
+
+    QStringList Texts;
+    for (int cue : Alignment.getCues(track, index.row())) {
+        // The store may have changed since it was lined up, until the
+        // next setTracks
+        if (cue < Subtitles->size()) {
+            Texts.append(Subtitles->getSubtitle(cue));
+        }
+    }
+
+    return Texts.join('\n');
+}
+
+QVariant AlignedTracksModel::headerData(int section, Qt::Orientation orientation, int role) const {
+    if (role != Qt::DisplayRole)
+        return QVariant();
+
+    if (orientation == Qt::Vertical)
+        return section + 1;
+
+    if (section == TimeColumn)
+        return QString("Time");
+
+    return Names.value(section - FirstTrackColumn);
+}
+
+void AlignedTracksModel::setTracks(const QVector<const SubtitleStore *> &tracks, const QStringList &names) {
+    beginResetModel();
+
+    Tracks = tracks;
+    Names = names;
+    Alignment.Align(Tracks);
+
+    endResetModel();
+}
+
+int AlignedTracksModel::getCue(int track, int row) const {
+    if (track >= Alignment.getTrackCount() || row < 0 || row >= Alignment.getRowCount())
+        return -1;
+
+    QVector<int> Cues = Alignment.getCues(track, row);
+    return Cues.isEmpty() ? -1 : Cues.first();
+}
+
+int AlignedTracksModel::getRow(int track, int cue) const {
+    // Cues added since the tracks were lined up aren't in a row yet
+    if (track >= Alignment.getTrackCount() || cue < 0 || cue >= Alignment.getCueCount(track))
+        return -1;
+
+    return Alignment.getRow(track, cue);
+}
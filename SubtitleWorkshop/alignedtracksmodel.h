@@ -0,0 +1,42 @@
+#pragma once
+
+#include <QAbstractTableModel>
+#include <QStringList>
+
+#include "trackalignment.h"
+
+// Table of several subtitle tracks side by side, a column for each and a
+// row for cues that show together, see TrackAlignment. Like the subtitle
+// table, cells are only formatted when the view asks for them.
+class AlignedTracksModel : public QAbstractTableModel {
+    Q_OBJECT
+
+public:
+    enum Column {
+        TimeColumn,
+        // Then one for each track
+        FirstTrackColumn
+    };
+
+    AlignedTracksModel(QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+    // Lines the stores up again, e.g. after they changed. They have to stay
+    // around until the next call.
+    void setTracks(const QVector<const SubtitleStore *> &tracks, const QStringList &names);
+
+    qint64 getRowTime(int row) const { return Alignment.getRowTime(row); }
+    // First of the track's cues in row, or -1
+    int getCue(int track, int row) const;
+    // Row the track's cue is in, or -1
+    int getRow(int track, int cue) const;
+
+private:
+    QVector<const SubtitleStore *> Tracks;
+    QStringList Names;
+    TrackAlignment Alignment;
+};
@@ -0,0 +1,214 @@
+#include "autosavejournal.h"
+
+#include <cstring>
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QFileInfo>
+
+#include "projectfile.h"
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Length, then checksum of the payload
+const int RecordHeaderSize = 8;
+
+}
+
+AutosaveJournal::AutosaveJournal(const QString &filepath) : FilePath(filepath), File(filepath) {}
+
+AutosaveJournal::Base AutosaveJournal::BaseFor(const QString &documentPath, const QString &sourcePath, const QString &mediaPath) {
+    Base Result;
+    Result.DocumentPath = documentPath;
+    Result.SourcePath = sourcePath;
+    Result.MediaPath = mediaPath;
+
+    if (!sourcePath.isEmpty()) {
+        QFileInfo Info(sourcePath);
+        Result.SourceSize = Info.size();
+        Result.SourceModified = Info.lastModified().toMSecsSinceEpoch();
+    }
+
+    return Result;
+}
+
+bool AutosaveJournal::isSourceUnchanged(const Base &base) {
+    if (base.SourcePath.isEmpty())
+        return true;
+
+    QFileInfo Info(base.SourcePath);
+    return Info.exists() && Info.size() == base.SourceSize && Info.lastModified().toMSecsSinceEpoch() == base.SourceModified;
+}
+
+bool AutosaveJournal::Read(const QString &filepath, Base &base, QList<QByteArray> &changes) {
+    changes.clear();
+
+    QFile Journal(filepath);
+    if (!Journal.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QByteArray Data = Journal.readAll();
+    const char *p = Data.constData();
+    const char *end = p + Data.size();
+
+    bool hasBase = false;
+    while (end - p >= RecordHeaderSize) {
+        quint32 Length, Checksum;
+        std::memcpy(&Length, p, 4);
+        std::memcpy(&Checksum, p + 4, 4);
+
+        if (Length > quint32(end - p - RecordHeaderSize) || Length < sizeof(qint32))
+            break;
+
+        const char *Payload = p + RecordHeaderSize;
+        if (qChecksum(Payload, Length) != Checksum)
+            break;
+
+        p = Payload + Length;
+
+        qint32 Type;
+        std::memcpy(&Type, Payload, sizeof(qint32));
+        QByteArray Body(Payload + sizeof(qint32), int(Length - sizeof(qint32)));
+
+        if (Type == BaseRecord) {
+            QDataStream in(Body);
+            in.setVersion(QDataStream::Qt_5_12);
+            in >> base.DocumentPath >> base.SourcePath >> base.SourceSize >> base.SourceModified >> base.MediaPath;
+            if (in.status() != QDataStream::Ok)
+                break;
+
+            hasBase = true;
+        }
+        else if (Type == ChangeRecord && hasBase) {
+            changes.append(Body);
+        }
+    }
+
+    return hasBase;
+}
+
+void AutosaveJournal::Discard(const QString &filepath) {
+    QFile::remove(filepath);
+
+    for (int generation = 0; generation < 2; generation++) {
+        QFile::remove(SnapshotPathFor(filepath, generation));
+    }
+}
+
+void AutosaveJournal::Start(const AutosaveJournal::Base &base) {
+    if (!SyncTimer) {
+        // Created here rather than in the constructor to live on the journal's thread
+        SyncTimer = new QTimer(this);
+        SyncTimer->setSingleShot(true);
+        SyncTimer->setInterval(SyncDelay);
+        connect(SyncTimer, SIGNAL(timeout()), this, SLOT(Sync()));
+    }
+
+    SyncTimer->stop();
+    File.close();
+    if (!File.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return;
+    }
+
+    QByteArray Payload;
+    QDataStream out(&Payload, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_12);
+    out << base.DocumentPath << base.SourcePath << base.SourceSize << base.SourceModified << base.MediaPath;
+
+    WriteRecord(BaseRecord, Payload);
+
+    // Changes are worthless without their base, it goes to disk right away
+    Sync();
+
+    // A snapshot the journal no longer refers to
+    if (!SnapshotPath.isEmpty() && SnapshotPath != base.SourcePath) {
+        QFile::remove(SnapshotPath);
+        SnapshotPath.clear();
+    }
+}
+
+void AutosaveJournal::Append(const QByteArray &change) {
+    if (!File.isOpen())
+        return;
+
+    WriteRecord(ChangeRecord, change);
+
+    if (!SyncTimer->isActive()) {
+        SyncTimer->start();
+    }
+
+    emit SizeChanged(File.pos());
+}
+
+void AutosaveJournal::Compact(const SubtitleStore &snapshot, const AutosaveJournal::Base &base) {
+    QString Path = NextSnapshotPath();
+
+    // The old journal and snapshot stay valid until the new ones are in place
+    if (!ProjectFile::Write(snapshot, Path)) {
+        return;
+    }
+
+    QString PreviousSnapshot = SnapshotPath;
+    SnapshotPath = Path;
+    Start(BaseFor(base.DocumentPath, Path, base.MediaPath));
+
+    if (!PreviousSnapshot.isEmpty()) {
+        QFile::remove(PreviousSnapshot);
+    }
+
+    emit SizeChanged(File.pos());
+}
+
+void AutosaveJournal::Sync() {
+    if (!File.isOpen())
+        return;
+
+    File.flush();
+
+#ifdef Q_OS_WIN
+    _commit(File.handle());
+#else
+    ::fsync(File.handle());
+#endif
+}
+
+void AutosaveJournal::Remove() {
+    if (SyncTimer) {
+        SyncTimer->stop();
+    }
+
+    File.close();
+    Discard(FilePath);
+    SnapshotPath.clear();
+}
+
+void AutosaveJournal::WriteRecord(RecordType type, const QByteArray &payload) {
+    QByteArray Record(RecordHeaderSize, '\0');
+
+    qint32 Type = type;
+    Record.append(reinterpret_cast<const char *>(&Type), sizeof(qint32));
+    Record.append(payload);
+
+    quint32 Length = quint32(Record.size() - RecordHeaderSize);
+    quint32 Checksum = qChecksum(Record.constData() + RecordHeaderSize, Length);
+    std::memcpy(Record.data(), &Length, 4);
+    std::memcpy(Record.data() + 4, &Checksum, 4);
+
+    File.write(Record);
+}
+
+QString AutosaveJournal::NextSnapshotPath() {
+    SnapshotGeneration = 1 - SnapshotGeneration;
+    return SnapshotPathFor(FilePath, SnapshotGeneration);
+}
+
+QString AutosaveJournal::SnapshotPathFor(const QString &filepath, int generation) {
+    return filepath + "." + QString::number(generation) + "." + ProjectFile::Suffix;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <QByteArray>
+#include <QFile>
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <QTimer>
+
+#include "subtitlestore.h"
+
+// Crash recovery for the open document. Every change is appended to a
+// journal file as it happens, on the journal's own thread, and flushed to
+// disk in batches at most SyncDelay ms apart. The journal starts with a
+// base record naming the file the changes apply to. Once it grows past
+// CompactSize the document is written out as a project snapshot and the
+// journal starts over from that.
+//
+// Records are stored as their length, a checksum and the payload, so one
+// torn by a crash is recognised and replay stops right before it.
+//
+// Lives on its own thread, its slots are called through queued calls.
+class AutosaveJournal : public QObject {
+    Q_OBJECT
+
+public:
+    // What the changes in a journal apply to
+    struct Base {
+        // The document's own file, empty for a new document
+        QString DocumentPath;
+        // What to load before replaying, the document or a snapshot of it.
+        // Size and modification time tell if it changed since.
+        QString SourcePath;
+        qint64 SourceSize = 0;
+        qint64 SourceModified = 0;
+        QString MediaPath;
+    };
+
+    static const qint64 CompactSize = 8 * 1024 * 1024;
+    static const int SyncDelay = 500;
+
+    AutosaveJournal(const QString &filepath);
+
+    const QString &getFilePath() const { return FilePath; }
+
+    // Base for a journal whose changes apply to source as it is now
+    static Base BaseFor(const QString &documentPath, const QString &sourcePath, const QString &mediaPath);
+    // Whether the source still is what the journal was started from
+    static bool isSourceUnchanged(const Base &base);
+
+    // Reads the journal at filepath: its base and the payloads of the
+    // changes after it, up to the first damaged record. Returns false if
+    // it has no readable base.
+    static bool Read(const QString &filepath, Base &base, QList<QByteArray> &changes);
+    // Deletes the journal at filepath and its snapshots
+    static void Discard(const QString &filepath);
+
+public slots:
+    // Starts the journal over from base
+    void Start(const AutosaveJournal::Base &base);
+    void Append(const QByteArray &change);
+
+    // Writes snapshot next to the journal and starts over from it
+    void Compact(const SubtitleStore &snapshot, const AutosaveJournal::Base &base);
+
+    // Flushes what was written and waits for the disk
+    void Sync();
+
+    // Deletes the journal and its snapshot, e.g. after a clean exit
+    void Remove();
+
+signals:
+    void SizeChanged(qint64 bytes);
+
+private:
+    enum RecordType : qint32 {
+        BaseRecord = 1,
+        ChangeRecord = 2
+    };
+
+    QString FilePath;
+    QFile File;
+    QTimer *SyncTimer = nullptr;
+
+    // Alternates between two names, so the one the journal on disk refers
+    // to is never overwritten before the journal is replaced
+    int SnapshotGeneration = 0;
+    QString SnapshotPath;
+
+    void WriteRecord(RecordType type, const QByteArray &payload);
+    QString NextSnapshotPath();
+    static QString SnapshotPathFor(const QString &filepath, int generation);
+};
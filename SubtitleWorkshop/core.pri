@@ -0,0 +1,36 @@
+# Subtitle model and file formats, shared by every target
+# that doesn't need QtWidgets or QtMultimedia.
+
+QT += concurrent
+
+INCLUDEPATH += $$PWD
+
+SOURCES += \
+    $$PWD/formatregistry.cpp \
+    $$PWD/framerate.cpp \
+    $$PWD/projectfile.cpp \
+    $$PWD/retiming.cpp \
+    $$PWD/subparser.cpp \
+    $$PWD/subtitleitem.cpp \
+    $$PWD/subtitlelinter.cpp \
+    $$PWD/subtitlesearch.cpp \
+    $$PWD/subtitlestore.cpp \
+    $$PWD/subtitlestyletable.cpp \
+    $$PWD/subtitletimeline.cpp \
+    $$PWD/textencoding.cpp \
+    $$PWD/trackalignment.cpp
+
+HEADERS += \
+    $$PWD/formatregistry.h \
+    $$PWD/framerate.h \
+    $$PWD/projectfile.h \
+    $$PWD/retiming.h \
+    $$PWD/subparser.h \
+    $$PWD/subtitleitem.h \
+    $$PWD/subtitlelinter.h \
+    $$PWD/subtitlesearch.h \
+    $$PWD/subtitlestore.h \
+    $$PWD/subtitlestyletable.h \
+    $$PWD/subtitletimeline.h \
+    $$PWD/textencoding.h \
+    $$PWD/trackalignment.h
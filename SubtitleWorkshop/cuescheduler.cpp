@@ -0,0 +1,153 @@
+#include "cuescheduler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+CueScheduler::CueScheduler(SubtitleTimeline *timeline, QObject *parent) : QObject(parent) {
+    Timelines.append(timeline);
+    Active.resize(1);
+
+    Timer = new QTimer(this);
+    Timer->setSingleShot(true);
+    Timer->setTimerType(Qt::PreciseTimer);
+    connect(Timer, SIGNAL(timeout()), this, SLOT(BoundaryReached()));
+
+    Clock.start();
+}
+
+void CueScheduler::AddTimeline(SubtitleTimeline *timeline) {
+    Timelines.append(timeline);
+    Active.append(QVector<int>());
+
+    Invalidate();
+}
+
+void CueScheduler::RemoveTimeline(SubtitleTimeline *timeline) {
+    int i = Timelines.indexOf(timeline);
+    if (i <= 0)
+        return;
+
+    Timelines.remove(i);
+    Active.remove(i);
+
+    Invalidate();
+}
+
+qint64 CueScheduler::getPosition() const {
+    if (!Playing)
+        return AnchorPosition;
+
+    return AnchorPosition + qint64(Clock.elapsed() * Rate);
+}
+
+const QVector<int> &CueScheduler::Refresh() {
+    qint64 Position = getPosition();
+
+    for (int i = 0; i < Timelines.size(); i++) {
+        Active[i] = Timelines.at(i)->ActiveAt(Position);
+    }
+
+    Arm(Position);
+
+    return Active.first();
+}
+
+const QVector<int> &CueScheduler::getActive(const SubtitleTimeline *timeline) const {
+    int index = Timelines.indexOf(const_cast<SubtitleTimeline *>(timeline));
+    if (index < 0) {
+        static const QVector<int> None;
+        return None;
+    }
+
+    return Active.at(index);
+}
+
+void CueScheduler::setPosition(qint64 position) {
+    // Ticks come a little late, going back for them would flicker cues that
+    // have just switched
+    qint64 Behind = getPosition() - position;
+    if (!Playing || Behind < 0 || Behind >= SyncTolerance) {
+        Anchor(position);
+    }
+
+    Check();
+}
+
+void CueScheduler::Seek(qint64 position) {
+    Anchor(position);
+    Check();
+}
+
+void CueScheduler::setPlaying(bool playing) {
+    if (playing == Playing)
+        return;
+
+    Anchor(getPosition());
+    Playing = playing;
+
+    Check();
+}
+
+void CueScheduler::setRate(qreal rate) {
+    Anchor(getPosition());
+    Rate = rate;
+
+    Check();
+}
+
+void CueScheduler::Invalidate() {
+    // Edits come in bursts, so the check waits for the event loop. There's
+    // no boundary to catch up to when it runs.
+    NextBoundary = std::numeric_limits<qint64>::min();
+    Timer->start(0);
+}
+
+void CueScheduler::BoundaryReached() {
+    // The timer can be early by the part of a millisecond it rounded away,
+    // the player's next tick corrects for drift either way
+    if (Playing && getPosition() < NextBoundary) {
+        Anchor(NextBoundary);
+    }
+
+    Check();
+}
+
+void CueScheduler::Anchor(qint64 position) {
+    AnchorPosition = position;
+    Clock.restart();
+}
+
+void CueScheduler::Check() {
+    qint64 Position = getPosition();
+
+    bool isChanged = false;
+    for (int i = 0; i < Timelines.size(); i++) {
+        if (Timelines.at(i)->ActiveAt(Position) != Active.at(i)) {
+            isChanged = true;
+        }
+    }
+
+    Arm(Position);
+
+    if (isChanged)
+        emit ActiveChanged();
+}
+
+void CueScheduler::Arm(qint64 position) {
+    // The first change on any track. Each timeline's span is the one
+    // around its lookup just now.
+    NextBoundary = std::numeric_limits<qint64>::max();
+    for (const SubtitleTimeline *Timeline : qAsConst(Timelines)) {
+        NextBoundary = std::min(NextBoundary, Timeline->getValidUntil());
+    }
+
+    // Paused or rewinding, there's nothing to wait for
+    if (!Playing || Rate <= 0 || NextBoundary == std::numeric_limits<qint64>::max()) {
+        Timer->stop();
+        return;
+    }
+
+    double Delay = std::ceil((NextBoundary - position) / Rate);
+    Timer->start(int(qBound(0.0, Delay, double(std::numeric_limits<int>::max()))));
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QTimer>
+#include <QVector>
+
+#include "subtitletimeline.h"
+
+// Tells when the cues on screen change during playback. The playhead is
+// extrapolated from the last position the player reported, and a precise
+// timer is armed for the next time a cue shows or hides, so cues switch on
+// time instead of at whichever position tick comes after. The player's
+// position, seeks, pauses and rate changes keep it in sync.
+//
+// Every track on screen has its timeline here, they all go by the one
+// clock. A check looks at each track's cached span, so it costs the same
+// however many cues the tracks have.
+class CueScheduler : public QObject {
+    Q_OBJECT
+
+public:
+    // Reported positions behind the extrapolated one by less than this are
+    // taken as the player lagging in reporting, not as a seek
+    static const qint64 SyncTolerance = 200;
+
+    // The first timeline is the edited track's, it stays for good
+    CueScheduler(SubtitleTimeline *timeline, QObject *parent = nullptr);
+
+    void AddTimeline(SubtitleTimeline *timeline);
+    void RemoveTimeline(SubtitleTimeline *timeline);
+
+    qint64 getPosition() const;
+    bool isPlaying() const { return Playing; }
+
+    // Rows of every track showing now, remembered as the ones on screen.
+    // Returns the first track's.
+    const QVector<int> &Refresh();
+    // Rows of the timeline's track as of the last Refresh, none if it
+    // hasn't been added
+    const QVector<int> &getActive(const SubtitleTimeline *timeline) const;
+
+public slots:
+    // From the player's position updates
+    void setPosition(qint64 position);
+    // Where the player was just sent, always taken as is
+    void Seek(qint64 position);
+    void setPlaying(bool playing);
+    void setRate(qreal rate);
+
+    // After changes to the subtitles, a batch of them is looked at once
+    void Invalidate();
+
+signals:
+    // The rows showing aren't the ones Refresh last returned
+    void ActiveChanged();
+
+private slots:
+    void BoundaryReached();
+
+private:
+    QVector<SubtitleTimeline *> Timelines;
+
+    QTimer *Timer;
+    QElapsedTimer Clock;
+    qint64 AnchorPosition = 0;
+    bool Playing = false;
+    qreal Rate = 1.0;
+
+    // Per timeline
+    QVector<QVector<int>> Active;
+    qint64 NextBoundary = 0;
+
+    void Anchor(qint64 position);
+    void Check();
+    void Arm(qint64 position);
+};
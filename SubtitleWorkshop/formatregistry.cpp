@@ -0,0 +1,197 @@
+#include "formatregistry.h"
+
+#include <climits>
+
+#include <QFile>
+#include <QFileInfo>
+
+#include "projectfile.h"
+
+namespace {
+
+// The start of a file without a UTF-8 BOM
+QByteArray StripBom(const QByteArray &head) {
+    return head.startsWith("\xEF\xBB\xBF") ? head.mid(3) : head;
+}
+
+int ProbeSrt(const QByteArray &head) {
+    // A cue number alone on a line, followed by a timing line
+    QList<QByteArray> Lines = StripBom(head).split('\n');
+
+    int i = 0;
+    while (i < Lines.size() && Lines.at(i).trimmed().isEmpty()) i++;
+    if (i + 1 >= Lines.size())
+        return 0;
+
+    bool isNumber;
+    Lines.at(i).trimmed().toInt(&isNumber);
+    if (isNumber && Lines.at(i + 1).contains("-->"))
+        return 90;
+
+    return 0;
+}
+
+int ProbeVtt(const QByteArray &head) {
+    return StripBom(head).startsWith("WEBVTT") ? 100 : 0;
+}
+
+int ProbeScript(const QByteArray &head, bool ssa) {
+    QByteArray Lower = head.toLower();
+    if (!Lower.contains("[script info]"))
+        return 0;
+
+    // v4.00+ is ASS, plain v4.00 is SSA
+    bool isAss = Lower.contains("[v4+ styles]") || Lower.contains("v4.00+");
+    bool isSsa = Lower.contains("[v4 styles]") || (!isAss && Lower.contains("v4.00"));
+
+    if (ssa)
+        return isSsa ? 100 : 40;
+
+    return isAss ? 100 : 50;
+}
+
+SubtitleFormat FromParser(const QString &name, const QStringList &suffixes, SubParser::CueFormat format, const SubtitleFormat::Probe &probe) {
+    return SubtitleFormat(name, suffixes, [format](const QString &filepath, int batchSize, const SubParser::BatchHandler &handler, SubtitleStyleTable *styles, TextEncoding *encoding) {
+        return SubParser::ParseBatches(filepath, format, batchSize, handler, styles, encoding);
+    }, [format](const SubtitleStore &store, const QString &filepath, SubParser::ExportStats *stats) {
+        return SubParser::Export(store, filepath, format, stats);
+    }, probe);
+}
+
+}
+
+SubtitleFormat::SubtitleFormat(const QString &name, const QStringList &suffixes, const Reader &reader, const Writer &writer, const Probe &probe)
+    : Name(name), Suffixes(suffixes), ReadCues(reader), WriteCues(writer), ProbeHead(probe) {}
+
+bool SubtitleFormat::Read(const QString &filepath, int batchSize, const SubParser::BatchHandler &handler, SubtitleStyleTable *styles, TextEncoding *encoding) const {
+    return ReadCues(filepath, batchSize, handler, styles, encoding);
+}
+
+bool SubtitleFormat::Write(const SubtitleStore &store, const QString &filepath, SubParser::ExportStats *stats) const {
+    return WriteCues(store, filepath, stats);
+}
+
+int SubtitleFormat::Match(const QByteArray &head) const {
+    return ProbeHead ? ProbeHead(head) : 0;
+}
+
+bool SubtitleFormat::ReadFile(const QString &filepath, SubtitleStore &store) const {
+    store.clear();
+
+    SubtitleStyleTable Styles;
+    TextEncoding Encoding;
+    bool success = Read(filepath, INT_MAX, [&store](QList<SubtitleItem> &batch, qint64, qint64) {
+        store.append(batch);
+        return true;
+    }, &Styles, &Encoding);
+
+    store.setStyles(Styles);
+    store.setEncoding(Encoding);
+    return success;
+}
+
+FormatRegistry &FormatRegistry::Instance() {
+    static FormatRegistry Registry;
+    return Registry;
+}
+
+FormatRegistry::FormatRegistry() {
+    RegisterBuiltins();
+}
+
+FormatRegistry::~FormatRegistry() {
+    qDeleteAll(Formats);
+}
+
+void FormatRegistry::Register(const SubtitleFormat &format) {
+    SubtitleFormat *Format = new SubtitleFormat(format);
+    Formats.append(Format);
+
+    for (const QString &suffix : Format->getSuffixes()) {
+        BySuffix.insert(suffix.toLower(), Format);
+    }
+}
+
+const SubtitleFormat *FormatRegistry::ForSuffix(const QString &suffix) const {
+    return BySuffix.value(suffix.toLower(), nullptr);
+}
+
+const SubtitleFormat *FormatRegistry::Detect(const QString &filepath) const {
+    const SubtitleFormat *BySuffixFormat = ForSuffix(QFileInfo(filepath).suffix());
+
+    QFile File(filepath);
+    if (!File.open(QIODevice::ReadOnly)) {
+        return BySuffixFormat;
+    }
+
+    // UTF-16 and legacy code pages look like nothing to the probes as they
+    // are, binary formats like nothing once transcoded
+    QByteArray Head = File.read(ProbeSize);
+    QByteArray Text = Head;
+    TextEncoding Encoding = TextEncoding::Detect(Head.constData(), Head.size());
+    if (!Encoding.isUtf8()) {
+        Text = Encoding.ToUtf8(Head.constData(), Head.size());
+    }
+
+    // The suffix only breaks ties
+    const SubtitleFormat *Best = nullptr;
+    int BestScore = 0;
+    for (const SubtitleFormat *format : Formats) {
+        int score = qMax(format->Match(Text), format->Match(Head));
+        if (score > BestScore || (score > 0 && score == BestScore && format == BySuffixFormat)) {
+            Best = format;
+            BestScore = score;
+        }
+    }
+
+    return Best ? Best : BySuffixFormat;
+}
+
+QString FormatRegistry::FileFilter() const {
+    QStringList Patterns;
+    for (const SubtitleFormat *format : Formats) {
+        for (const QString &suffix : format->getSuffixes()) {
+            Patterns.append("*." + suffix);
+        }
+    }
+
+    return "Subtitle Files (" + Patterns.join(' ') + ")";
+}
+
+void FormatRegistry::RegisterBuiltins() {
+    Register(FromParser("SubRip", QStringList() << "srt", SubParser::CueFormat::SRT, ProbeSrt));
+    Register(FromParser("WebVTT", QStringList() << "vtt", SubParser::CueFormat::VTT, ProbeVtt));
+    Register(FromParser("Advanced SubStation Alpha", QStringList() << "ass", SubParser::CueFormat::ASS, [](const QByteArray &head) {
+        return ProbeScript(head, false);
+    }));
+    Register(FromParser("SubStation Alpha", QStringList() << "ssa", SubParser::CueFormat::SSA, [](const QByteArray &head) {
+        return ProbeScript(head, true);
+    }));
+
+    // Projects read whole, only the GUI keeps their media path and history
+    Register(SubtitleFormat("Subshop Project", QStringList() << ProjectFile::Suffix, [](const QString &filepath, int batchSize, const SubParser::BatchHandler &handler, SubtitleStyleTable *styles, TextEncoding *encoding) {
+        SubtitleStore Project;
+        if (!ProjectFile::Read(filepath, Project))
+            return false;
+
+        if (styles) *styles = Project.getStyles();
+        if (encoding) *encoding = Project.getEncoding();
+
+        for (int first = 0; first < Project.size(); first += batchSize) {
+            QList<SubtitleItem> Batch;
+            int last = int(qMin<qint64>(qint64(first) + batchSize, Project.size()));
+            for (int i = first; i < last; i++) {
+                Batch.append(Project.at(i));
+            }
+
+            if (!handler(Batch, last, Project.size()))
+                return false;
+        }
+
+        return true;
+    }, [](const SubtitleStore &store, const QString &filepath, SubParser::ExportStats *stats) {
+        return ProjectFile::Write(store, filepath, ProjectFile::Extras(), stats);
+    }, [](const QByteArray &head) {
+        return ProjectFile::IsProject(head) ? 100 : 0;
+    }));
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <functional>
+
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+#include "subparser.h"
+#include "subtitlestore.h"
+#include "subtitlestyletable.h"
+
+// A subtitle file format: how to recognise a file of it, read one and
+// write one
+class SubtitleFormat {
+public:
+    // Streams the cues of a file in batches, see SubParser::ParseBatches
+    typedef std::function<bool(const QString &filepath, int batchSize, const SubParser::BatchHandler &handler, SubtitleStyleTable *styles, TextEncoding *encoding)> Reader;
+    typedef std::function<bool(const SubtitleStore &store, const QString &filepath, SubParser::ExportStats *stats)> Writer;
+    // How sure the format is that head, the start of a file, is one of its
+    // own: 0 for not at all up to 100
+    typedef std::function<int(const QByteArray &head)> Probe;
+
+    SubtitleFormat(const QString &name, const QStringList &suffixes, const Reader &reader, const Writer &writer, const Probe &probe);
+
+    const QString &getName() const { return Name; }
+    const QStringList &getSuffixes() const { return Suffixes; }
+
+    bool Read(const QString &filepath, int batchSize, const SubParser::BatchHandler &handler, SubtitleStyleTable *styles, TextEncoding *encoding = nullptr) const;
+    bool Write(const SubtitleStore &store, const QString &filepath, SubParser::ExportStats *stats = nullptr) const;
+    int Match(const QByteArray &head) const;
+
+    // Reads the whole file into store, styles and encoding included
+    bool ReadFile(const QString &filepath, SubtitleStore &store) const;
+
+private:
+    QString Name;
+    QStringList Suffixes;
+    Reader ReadCues;
+    Writer WriteCues;
+    Probe ProbeHead;
+};
+
+// Every subtitle format the program knows, looked up by suffix or by
+// sniffing a file's first few KB. The GUI and the CLI both go through it,
+// so a new format only has to be registered here.
+//
+// Formats are registered before any other thread uses the registry and
+// live as long as the program, so the pointers handed out stay valid.
+class FormatRegistry {
+public:
+    // The registry with the built-in formats
+    static FormatRegistry &Instance();
+
+    ~FormatRegistry();
+
+    void Register(const SubtitleFormat &format);
+
+    // nullptr if nothing handles it
+    const SubtitleFormat *ForSuffix(const QString &suffix) const;
+
+    // The format the file's content looks like, or the one its suffix
+    // names if no probe recognises it
+    const SubtitleFormat *Detect(const QString &filepath) const;
+
+    const QList<SubtitleFormat *> &getFormats() const { return Formats; }
+
+    // "Subtitle Files (*.srt *.vtt ...)" for file dialogs
+    QString FileFilter() const;
+
+    // How much of a file the probes get to see. They always see it as UTF-8.
+    static const int ProbeSize = 4096;
+
+private:
+    FormatRegistry();
+
+    QList<SubtitleFormat *> Formats;
+    QHash<QString, SubtitleFormat *> BySuffix;
+
+    void RegisterBuiltins();
+};
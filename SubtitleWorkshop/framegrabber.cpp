@@ -0,0 +1,127 @@
+#include "framegrabber.h"
+
+#include "shotdetector.h"
+
+namespace {
+
+// Averages 2x2 pixels at the middle of every thumbnail cell, luma(x, y)
+// gives a pixel's brightness
+template<typename Luma>
+QByteArray Sample(int width, int height, Luma luma) {
+    const int W = ShotDetector::ThumbnailWidth;
+    const int H = ShotDetector::ThumbnailHeight;
+
+    QByteArray Result(W * H, Qt::Uninitialized);
+    uchar *Pixels = reinterpret_cast<uchar *>(Result.data());
+
+    for (int ty = 0; ty < H; ty++) {
+        int y = qMin(height - 2, (2 * ty + 1) * height / (2 * H));
+
+        for (int tx = 0; tx < W; tx++) {
+            int x = qMin(width - 2, (2 * tx + 1) * width / (2 * W));
+
+            int Sum = luma(x, y) + luma(x + 1, y) + luma(x, y + 1) + luma(x + 1, y + 1);
+            Pixels[ty * W + tx] = uchar(Sum / 4);
+        }
+    }
+
+    return Result;
+}
+
+// 0xAARRGGBB, or 0xBBGGRRAA when swapped
+inline int RgbLuma(quint32 pixel, bool swapped) {
+    int r = swapped ? (pixel >> 8) & 0xff : (pixel >> 16) & 0xff;
+    int g = swapped ? (pixel >> 16) & 0xff : (pixel >> 8) & 0xff;
+    int b = swapped ? (pixel >> 24) & 0xff : pixel & 0xff;
+
+    return (r * 77 + g * 150 + b * 29) >> 8;
+}
+
+}
+
+FrameGrabber::FrameGrabber(QMediaPlayer *player) : QAbstractVideoSurface(player), Player(player) {}
+
+QList<QVideoFrame::PixelFormat> FrameGrabber::supportedPixelFormats(QAbstractVideoBuffer::HandleType type) const {
+    // Frames in textures would have to be read back first
+    if (type != QAbstractVideoBuffer::NoHandle)
+        return QList<QVideoFrame::PixelFormat>();
+
+    return {
+        QVideoFrame::Format_YUV420P,
+        QVideoFrame::Format_YV12,
+        QVideoFrame::Format_NV12,
+        QVideoFrame::Format_NV21,
+        QVideoFrame::Format_YUV422P,
+        QVideoFrame::Format_Y8,
+        QVideoFrame::Format_UYVY,
+        QVideoFrame::Format_YUYV,
+        QVideoFrame::Format_RGB32,
+        QVideoFrame::Format_ARGB32,
+        QVideoFrame::Format_ARGB32_Premultiplied,
+        QVideoFrame::Format_BGR32,
+        QVideoFrame::Format_BGRA32
+    };
+}
+
+bool FrameGrabber::present(const QVideoFrame &frame) {
+    if (!frame.isValid())
+        return false;
+
+    emit FrameGrabbed(frame.startTime() >= 0 ? frame.startTime() / 1000 : Player->position(), frame);
+    return true;
+}
+
+QByteArray FrameGrabber::Thumbnail(const QVideoFrame &frame) {
+    QVideoFrame Frame(frame);
+    if (!Frame.isValid() || Frame.width() < 2 || Frame.height() < 2)
+        return QByteArray();
+
+    if (!Frame.map(QAbstractVideoBuffer::ReadOnly))
+        return QByteArray();
+
+    const uchar *Bits = Frame.bits(0);
+    int Stride = Frame.bytesPerLine(0);
+
+    QByteArray Result;
+
+    switch (Frame.pixelFormat()) {
+        case QVideoFrame::Format_YUV420P:
+        case QVideoFrame::Format_YV12:
+        case QVideoFrame::Format_NV12:
+        case QVideoFrame::Format_NV21:
+        case QVideoFrame::Format_YUV422P:
+        case QVideoFrame::Format_Y8:
+            // The first plane is the luma itself
+            Result = Sample(Frame.width(), Frame.height(), [&](int x, int y) {
+                return int(Bits[y * Stride + x]);
+            });
+            break;
+
+        case QVideoFrame::Format_UYVY:
+        case QVideoFrame::Format_YUYV: {
+            int Offset = Frame.pixelFormat() == QVideoFrame::Format_UYVY ? 1 : 0;
+            Result = Sample(Frame.width(), Frame.height(), [&](int x, int y) {
+                return int(Bits[y * Stride + 2 * x + Offset]);
+            });
+            break;
+        }
+
+        case QVideoFrame::Format_RGB32:
+        case QVideoFrame::Format_ARGB32:
+        case QVideoFrame::Format_ARGB32_Premultiplied:
+        case QVideoFrame::Format_BGR32:
+        case QVideoFrame::Format_BGRA32: {
+            bool Swapped = Frame.pixelFormat() == QVideoFrame::Format_BGR32 || Frame.pixelFormat() == QVideoFrame::Format_BGRA32;
+            Result = Sample(Frame.width(), Frame.height(), [&](int x, int y) {
+                return RgbLuma(reinterpret_cast<const quint32 *>(Bits + y * Stride)[x], Swapped);
+            });
+            break;
+        }
+
+        default:
+            break;
+    }
+
+    Frame.unmap();
+    return Result;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <QAbstractVideoSurface>
+#include <QMediaPlayer>
+#include <QVideoFrame>
+
+// Video output that hands every frame on as it is, for something on another
+// thread to look at, so presenting costs the player's thread nothing. The
+// frame keeps the decoder's buffer alive until it has been looked at.
+class FrameGrabber : public QAbstractVideoSurface {
+    Q_OBJECT
+
+public:
+    // Frames the backend doesn't time get the player's position
+    FrameGrabber(QMediaPlayer *player);
+
+    QList<QVideoFrame::PixelFormat> supportedPixelFormats(QAbstractVideoBuffer::HandleType type = QAbstractVideoBuffer::NoHandle) const override;
+    bool present(const QVideoFrame &frame) override;
+
+    // Grey thumbnail of the frame, the size ShotDetector takes, or empty if
+    // it can't be read. Averaged from a few pixels per cell, straight from
+    // the luma plane for YUV formats, so it costs far less than decoding
+    // the frame did.
+    static QByteArray Thumbnail(const QVideoFrame &frame);
+
+signals:
+    // time is the frame's in ms
+    void FrameGrabbed(qint64 time, const QVideoFrame &frame);
+
+private:
+    QMediaPlayer *Player;
+};
@@ -0,0 +1,62 @@
+#include "framerate.h"
+
+#include <cmath>
+
+namespace {
+
+// Rounded towards negative infinity, times can be negative
+qint64 FloorDiv(qint64 a, qint64 b) {
+    qint64 q = a / b;
+    return (a % b != 0 && (a < 0) != (b < 0)) ? q - 1 : q;
+}
+
+qint64 CeilDiv(qint64 a, qint64 b) {
+    return -FloorDiv(-a, b);
+}
+
+}
+
+FrameRate::FrameRate(qint64 numerator, qint64 denominator) : Numerator(numerator), Denominator(denominator) {}
+
+FrameRate FrameRate::FromFps(double fps) {
+    if (!(fps > 0))
+        return FrameRate();
+
+    for (const FrameRate &rate : Common()) {
+        if (std::abs(rate.getFps() - fps) < 0.01) return rate;
+    }
+
+    return FrameRate(qRound64(fps * 1000), 1000);
+}
+
+QVector<FrameRate> FrameRate::Common() {
+    return {
+        FrameRate(24000, 1001), FrameRate(24), FrameRate(25), FrameRate(30000, 1001),
+        FrameRate(30), FrameRate(50), FrameRate(60000, 1001), FrameRate(60)
+    };
+}
+
+QString FrameRate::getName() const {
+    QString Result = QString::number(getFps(), 'f', 3);
+
+    while (Result.endsWith('0')) Result.chop(1);
+    if (Result.endsWith('.')) Result.chop(1);
+
+    return Result;
+}
+
+qint64 FrameRate::FrameAt(qint64 time) const {
+    return isValid() ? FloorDiv(time * Numerator, 1000 * Denominator) : 0;
+}
+
+qint64 FrameRate::TimeOf(qint64 frame) const {
+    return isValid() ? CeilDiv(frame * 1000 * Denominator, Numerator) : 0;
+}
+
+qint64 FrameRate::Snap(qint64 time) const {
+    if (!isValid())
+        return time;
+
+    // Halfway between two frames goes to the later one
+    return TimeOf(FloorDiv(2 * time * Numerator + 1000 * Denominator, 2000 * Denominator));
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <QString>
+#include <QVector>
+
+// A video frame rate, kept as a fraction so the NTSC rates (24000/1001 and
+// the like) stay on their real frame boundaries instead of drifting by a
+// frame every few minutes. Frame n starts at the first whole millisecond at
+// or after n / fps seconds, which is when a player would be showing it.
+class FrameRate {
+public:
+    FrameRate() {}
+    FrameRate(qint64 numerator, qint64 denominator = 1);
+
+    // The common rate within a hundredth of fps, e.g. 23.976 is 24000/1001,
+    // anything else to the nearest thousandth
+    static FrameRate FromFps(double fps);
+    // 23.976, 24, 25, 29.97, 30, 50, 59.94 and 60
+    static QVector<FrameRate> Common();
+
+    bool isValid() const { return Numerator > 0 && Denominator > 0; }
+    double getFps() const { return isValid() ? double(Numerator) / Denominator : 0.0; }
+    // E.g. "23.976" or "25"
+    QString getName() const;
+
+    // Frame showing at time, negative before zero
+    qint64 FrameAt(qint64 time) const;
+    // Time frame starts showing
+    qint64 TimeOf(qint64 frame) const;
+    // Start of the frame nearest to time
+    qint64 Snap(qint64 time) const;
+
+    friend bool operator==(const FrameRate &lhs, const FrameRate &rhs) {
+        return lhs.Numerator * rhs.Denominator == rhs.Numerator * lhs.Denominator;
+    }
+    friend bool operator!=(const FrameRate &lhs, const FrameRate &rhs) { return !(lhs == rhs); }
+
+private:
+    qint64 Numerator = 0;
+    qint64 Denominator = 1;
+};
@@ -1,12 +1,19 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
 
-MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent), ui(new Ui::MainWindow) {
+MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent), ui(new Ui::MainWindow), Timeline(&Subtitles), Search(&Subtitles), Linter(&Subtitles) {
     ui->setupUi(this);
 
     SetupButtonIcons();
     SetupVideoWidget();
     SetupSubtitlesTable();
+    SetupLoader();
+    SetupSearchPanel();
+    SetupJournal();
+    SetupWaveform();
+    SetupFrameStepping();
+    SetupTracks();
+    SetupShotDetection();
     ConnectEvents();
 
     // Media Player Group
@@ -17,9 +24,37 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent), ui(new Ui::MainWi
 
     // Subtitle Group
     ui->SubtitleGroupBox->setEnabled(false);
+
+    // Once the window is up, journals left by a crash are offered back
+    QTimer::singleShot(0, this, SLOT(CheckForRecovery()));
 }
 
 MainWindow::~MainWindow() {
+    CancelLoading();
+
+    for (ReferenceTrack *Track : qAsConst(ReferenceTracks)) {
+        Track->Cancel();
+    }
+
+    loaderThread->quit();
+    loaderThread->wait();
+
+    CancelWaveform();
+    CancelShotDetection();
+
+    waveformThread->quit();
+    waveformThread->wait();
+
+    // A clean exit leaves nothing to recover
+    if (journal) {
+        AutosaveJournal *Journal = journal;
+        QMetaObject::invokeMethod(journal, [Journal]() { Journal->Remove(); }, Qt::BlockingQueuedConnection);
+
+        journalThread->quit();
+        journalThread->wait();
+        delete journalLock;
+    }
+
     delete ui;
 }
 
@@ -51,13 +86,16 @@ void MainWindow::dropEvent(QDropEvent *e) {
         QFileInfo fileInfo(path);
         QString suffix(fileInfo.suffix());
 
-        // Uhuu Buhuu:: Make things do stuff no one else can get done.
-        if (SubtitleFileSelector.contains(suffix)) {
+        // A known suffix decides, anything else is sniffed
+        if (FormatRegistry::Instance().ForSuffix(suffix)) {
             OpenSubtitleFile(path);
         }
-        else if (MediaFileSelector.contains(suffix)) {
+        else if (MediaSuffixes.contains(suffix, Qt::CaseInsensitive)) {
             OpenMediaFile(path);
         }
+        else if (FormatRegistry::Instance().Detect(path)) {
+            OpenSubtitleFile(path);
+        }
         else {
             QMessageBox::critical(this, "Error", "Unsupported file type \"" + suffix + "\"");
             return;
@@ -88,7 +126,8 @@ void MainWindow::SetupButtonIcons() {
 
 void MainWindow::SetupVideoWidget() {
     videoItem = new QGraphicsVideoItem();
-    subTextItem = new QGraphicsTextItem();
+    subOverlayItem = new QGraphicsPixmapItem();
+    subOverlayItem->setTransformationMode(Qt::SmoothTransformation);
 
     scene = new QGraphicsScene(this);
 
@@ -97,38 +136,192 @@ void MainWindow::SetupVideoWidget() {
     view->show();
 
     scene->addItem(videoItem);
-    scene->addItem(subTextItem);
+    scene->addItem(subOverlayItem);
 
     player = new QMediaPlayer(this, QMediaPlayer::VideoSurface);
     player->setVideoOutput(videoItem);
-    player->setNotifyInterval(50);
+    // Cues are switched by the scheduler, the ticks only move the playhead
+    player->setNotifyInterval(100);
     player->setVolume(ui->VolumeSlider->value());
 
-    subTextItem->setPlainText(QString());
-    subTextItem->setDefaultTextColor(QColorConstants::White);
-
-    QFont subtitleFont = subTextItem->font();
+    QFont subtitleFont = font();
     subtitleFont.setPixelSize(26);
-    subTextItem->setFont(subtitleFont);
 
-    QGraphicsDropShadowEffect *shadowEffect = new QGraphicsDropShadowEffect(this);
-    shadowEffect->setOffset(1, 1);
-    subTextItem->setGraphicsEffect(shadowEffect);
+    // White text with its shadow, drawn once per cue and scale
+    overlays = new OverlayCache(subtitleFont, this);
+
+    cues = new CueScheduler(&Timeline, this);
+    connect(cues, SIGNAL(ActiveChanged()), this, SLOT(ActiveSubsChanged()));
 }
 
 void MainWindow::SetupSubtitlesTable() {
-    subtitlesModel = new QStandardItemModel(Subtitles.size(), 3, this);
-    subtitlesModel->setHorizontalHeaderItem(0, new QStandardItem(QString("Show")));
-    subtitlesModel->setHorizontalHeaderItem(1, new QStandardItem(QString("Hide")));
-    subtitlesModel->setHorizontalHeaderItem(2, new QStandardItem(QString("Subtitle")));
-
+    subtitlesModel = new SubtitleTableModel(&Subtitles, this);
     ui->SubTableView->setModel(subtitlesModel);
+
+    // Fixed row heights keep the view from measuring every row of big files
+    ui->SubTableView->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+
+    // Any change to the list goes through the model, so this keeps the
+    // views in sync. The timeline is updated row by row below.
+    connect(subtitlesModel, SIGNAL(rowsInserted(QModelIndex,int,int)), this, SLOT(SubtitlesChanged()));
+    connect(subtitlesModel, SIGNAL(rowsRemoved(QModelIndex,int,int)), this, SLOT(SubtitlesChanged()));
+    connect(subtitlesModel, SIGNAL(rowsMoved(QModelIndex,int,int,QModelIndex,int)), this, SLOT(SubtitlesChanged()));
+    connect(subtitlesModel, SIGNAL(dataChanged(QModelIndex,QModelIndex)), this, SLOT(SubtitlesChanged()));
+    connect(subtitlesModel, SIGNAL(layoutChanged()), this, SLOT(SubtitlesChanged()));
+    connect(subtitlesModel, SIGNAL(modelReset()), this, SLOT(SubtitlesChanged()));
+
+    // The timeline, the search index and the linter follow the changes row by row
+    connect(subtitlesModel, SIGNAL(rowsInserted(QModelIndex,int,int)), this, SLOT(SubtitleRowsInserted(QModelIndex,int,int)));
+    connect(subtitlesModel, SIGNAL(rowsAboutToBeRemoved(QModelIndex,int,int)), this, SLOT(SubtitleRowsAboutToBeRemoved(QModelIndex,int,int)));
+    connect(subtitlesModel, SIGNAL(rowsRemoved(QModelIndex,int,int)), this, SLOT(SubtitleRowsRemoved(QModelIndex,int,int)));
+    connect(subtitlesModel, SIGNAL(rowsMoved(QModelIndex,int,int,QModelIndex,int)), this, SLOT(SubtitleRowsMoved(QModelIndex,int,int,QModelIndex,int)));
+    connect(subtitlesModel, SIGNAL(dataChanged(QModelIndex,QModelIndex)), this, SLOT(SubtitleDataChanged(QModelIndex,QModelIndex)));
+    connect(subtitlesModel, SIGNAL(modelReset()), this, SLOT(SubtitlesReset()));
+    connect(subtitlesModel, SIGNAL(layoutChanged()), this, SLOT(SubtitlesReordered()));
+
+    subtitlesModel->setLinter(&Linter);
+
+    problemsLabel = new QLabel(this);
+    statusBar()->addPermanentWidget(problemsLabel);
+
+    // Bursts of changes, like a file loading in batches, are counted once
+    problemsTimer = new QTimer(this);
+    problemsTimer->setSingleShot(true);
+    problemsTimer->setInterval(100);
+    connect(problemsTimer, SIGNAL(timeout()), this, SLOT(UpdateProblems()));
+}
+
+void MainWindow::SetupLoader() {
+    qRegisterMetaType<QList<SubtitleItem>>("QList<SubtitleItem>");
+    qRegisterMetaType<SubtitleStyleTable>("SubtitleStyleTable");
+
+    // Subtitle files are parsed on this thread, one at a time
+    loaderThread = new QThread(this);
+    loaderThread->start();
+
+    loadProgressBar = new QProgressBar(this);
+    loadProgressBar->setRange(0, 100);
+    loadProgressBar->setMaximumWidth(200);
+    loadProgressBar->setVisible(false);
+
+    loadCancelButton = new QToolButton(this);
+    loadCancelButton->setIcon(style()->standardIcon(QStyle::SP_DialogCancelButton));
+    loadCancelButton->setToolTip("Cancel loading");
+    loadCancelButton->setVisible(false);
+
+    statusBar()->addPermanentWidget(loadProgressBar);
+    statusBar()->addPermanentWidget(loadCancelButton);
+
+    connect(loadCancelButton, SIGNAL(clicked()), this, SLOT(CancelSubtitleLoading()));
+}
+
+void MainWindow::SetupSearchPanel() {
+    searchPanel = new SearchPanel(&Search, &Subtitles, this);
+    addDockWidget(Qt::RightDockWidgetArea, searchPanel);
+    searchPanel->hide();
+
+    connect(searchPanel, SIGNAL(HitActivated(int)), this, SLOT(SelectSubFromTable(int)));
+    connect(searchPanel, SIGNAL(ReplaceAllRequested()), this, SLOT(ReplaceAllAction()));
+}
+
+void MainWindow::SetupWaveform() {
+    waveformThread = new QThread(this);
+    waveformThread->start();
+
+    // Under the video, above the cue editor
+    waveform = new WaveformWidget(&Subtitles, &Timeline, this);
+    ui->gridLayout->addWidget(waveform, 3, 0, 1, 7);
+
+    connect(waveform, SIGNAL(SeekRequested(qint64)), this, SLOT(WaveformSeekRequested(qint64)));
+}
+
+void MainWindow::SetupTracks() {
+    tracksPanel = new TracksPanel(this);
+    addDockWidget(Qt::BottomDockWidgetArea, tracksPanel);
+    tracksPanel->hide();
+
+    ui->menuSubtitle->addSeparator();
+    ui->menuSubtitle->addAction(tracksPanel->toggleViewAction());
+
+    connect(tracksPanel, SIGNAL(RowActivated(qint64,int)), this, SLOT(TrackRowActivated(qint64,int)));
+
+    UpdateTracks();
+}
+
+void MainWindow::SetupShotDetection() {
+    shotsLabel = new QLabel(this);
+    statusBar()->addPermanentWidget(shotsLabel);
+}
+
+void MainWindow::SetupFrameStepping() {
+    frameRateGroup = new QActionGroup(this);
+    frameRateGroup->setExclusive(true);
+
+    frameLabel = new QLabel(this);
+    statusBar()->addPermanentWidget(frameLabel);
+
+    connect(frameRateGroup, SIGNAL(triggered(QAction*)), this, SLOT(FrameRateSelected(QAction*)));
+
+    UpdateFrameRateMenu();
+    UpdateFrameLabel();
+}
+
+void MainWindow::SetupJournal() {
+    History.setMemoryBudget(HistoryMemoryBudget);
+
+    QDir().mkpath(JournalDirectory());
+    QString Name = QString::number(QCoreApplication::applicationPid()) + "-" + QString::number(QDateTime::currentMSecsSinceEpoch());
+
+    // Held as long as this instance runs, so no other one recovers from
+    // it. Without the lock another instance would take the journal for an
+    // abandoned one and discard it, so another name is tried.
+    QString Path;
+    for (int i = 0; i < JournalAttempts && journalLock == nullptr; i++) {
+        Path = JournalDirectory() + "/" + Name + (i > 0 ? "-" + QString::number(i) : QString()) + ".journal";
+
+        journalLock = new QLockFile(Path + ".lock");
+        if (!journalLock->tryLock(0)) {
+            delete journalLock;
+            journalLock = nullptr;
+        }
+    }
+
+    if (journalLock == nullptr) {
+        QTimer::singleShot(0, this, [this]() {
+            QMessageBox::warning(this, "Warning", "Couldn't lock an autosave journal in \"" + JournalDirectory() + "\".\nChanges won't be autosaved in this session.");
+        });
+        return;
+    }
+
+    journalThread = new QThread(this);
+    journal = new AutosaveJournal(Path);
+    journal->moveToThread(journalThread);
+
+    connect(journalThread, SIGNAL(finished()), journal, SLOT(deleteLater()));
+    connect(journal, SIGNAL(SizeChanged(qint64)), this, SLOT(JournalSizeChanged(qint64)));
+
+    journalThread->start();
+
+    // Changes are journaled where they enter the history, so whatever can
+    // be undone can be recovered
+    AutosaveJournal *Journal = journal;
+    History.setRecorder([Journal](const UndoItem &item, bool undone) {
+        QByteArray Change;
+        QDataStream out(&Change, QIODevice::WriteOnly);
+        out.setVersion(QDataStream::Qt_5_12);
+        out << undone;
+        item.Write(out);
+
+        QMetaObject::invokeMethod(Journal, [Journal, Change]() { Journal->Append(Change); }, Qt::QueuedConnection);
+    });
 }
 
 void MainWindow::ConnectEvents() {
     // File Menu
     connect(ui->ActionNew, SIGNAL(triggered()), this, SLOT(NewAction()));
     connect(ui->ActionOpen, SIGNAL(triggered()), this, SLOT(OpenAction()));
+    connect(ui->ActionOpenReference, SIGNAL(triggered()), this, SLOT(OpenReferenceAction()));
+    connect(ui->ActionCloseReferences, SIGNAL(triggered()), this, SLOT(CloseReferencesAction()));
     connect(ui->ActionSave, SIGNAL(triggered()), this, SLOT(SaveAction()));
     connect(ui->ActionSaveAs, SIGNAL(triggered()), this, SLOT(SaveAsAction()));
     connect(ui->ActionClose, SIGNAL(triggered()), this, SLOT(CloseAction()));
@@ -137,6 +330,13 @@ void MainWindow::ConnectEvents() {
     // Edit Menu
     connect(ui->ActionEditUndo, SIGNAL(triggered()), this, SLOT(UndoAction()));
     connect(ui->ActionEditRedo, SIGNAL(triggered()), this, SLOT(RedoAction()));
+    connect(ui->ActionEditFind, SIGNAL(triggered()), this, SLOT(FindAction()));
+    connect(ui->ActionEditSnapAllToFrames, SIGNAL(triggered()), this, SLOT(SnapAllToFramesAction()));
+    connect(ui->ActionEditConvertFrameRate, SIGNAL(triggered()), this, SLOT(ConvertFrameRateAction()));
+    connect(ui->ActionEditShiftTimes, SIGNAL(triggered()), this, SLOT(ShiftTimesAction()));
+    connect(ui->ActionEditStretchTimes, SIGNAL(triggered()), this, SLOT(StretchTimesAction()));
+    connect(ui->ActionEditSyncTimes, SIGNAL(triggered()), this, SLOT(SyncTimesAction()));
+    connect(ui->ActionEditSnapToShots, SIGNAL(triggered()), this, SLOT(SnapToShotsAction()));
 
     // Media Menu
     connect(ui->ActionMediaOpen, SIGNAL(triggered()), this, SLOT(OpenMediaAction()));
@@ -145,6 +345,11 @@ void MainWindow::ConnectEvents() {
     connect(ui->ActionMediaStop, SIGNAL(triggered()), this, SLOT(StopVideo()));
     connect(ui->ActionMediaSeekBackward, SIGNAL(triggered()), this, SLOT(SeekBackwards()));
     connect(ui->ActionMediaSeekForward, SIGNAL(triggered()), this, SLOT(SeekForwards()));
+    connect(ui->ActionMediaFramePrevious, SIGNAL(triggered()), this, SLOT(PreviousFrame()));
+    connect(ui->ActionMediaFrameNext, SIGNAL(triggered()), this, SLOT(NextFrame()));
+    connect(ui->ActionMediaFramesBackward, SIGNAL(triggered()), this, SLOT(StepFramesBackward()));
+    connect(ui->ActionMediaFramesForward, SIGNAL(triggered()), this, SLOT(StepFramesForward()));
+    connect(ui->ActionMediaFrameStepSize, SIGNAL(triggered()), this, SLOT(FrameStepSizeAction()));
     connect(ui->ActionMediaAudioVolumeUp, SIGNAL(triggered()), this, SLOT(VolumeUp()));
     connect(ui->ActionMediaAudioVolumeDown, SIGNAL(triggered()), this, SLOT(VolumeDown()));
     connect(ui->ActionMediaAudioToggleMute, SIGNAL(triggered()), this, SLOT(ToggleMuteAudio()));
@@ -159,7 +364,10 @@ void MainWindow::ConnectEvents() {
     // Media Player
     connect(player, SIGNAL(seekableChanged(bool)), this, SLOT(VideoSeekableChanged(bool)));
     connect(player, SIGNAL(positionChanged(qint64)), this, SLOT(VideoPositionChanged(qint64)));
+    connect(player, SIGNAL(stateChanged(QMediaPlayer::State)), this, SLOT(VideoStateChanged(QMediaPlayer::State)));
+    connect(player, SIGNAL(playbackRateChanged(qreal)), cues, SLOT(setRate(qreal)));
     connect(player, SIGNAL(durationChanged(qint64)), this, SLOT(VideoDurationChanged(qint64)));
+    connect(player, SIGNAL(metaDataChanged()), this, SLOT(VideoMetaDataChanged()));
 
     connect(ui->TimelineSlider, SIGNAL(sliderMoved(int)), this, SLOT(TimelineSliderChanged(int)));
     connect(ui->TogglePlayButton, SIGNAL(clicked()), this, SLOT(TogglePlayVideo()));
@@ -199,23 +407,39 @@ void MainWindow::UpdateUI() {
 
     // Update Subtitle Text
     subTextScaleFactor = std::clamp(scene->itemsBoundingRect().width() / 622, 0.0, 1.0);
-    subTextItem->setScale(subTextScaleFactor);
+    overlays->setScale(subTextScaleFactor, ui->GraphicsView->devicePixelRatioF());
 
-    UpdateSubPosition();
+    // Cues rendered at the old scale are gone, the warmed ones too
+    WarmedSubtitleIndex = -1;
+    ShowOverlay(subOverlayHtml);
+
+    for (int track = 0; track < referenceOverlayItems.size(); track++) {
+        ShowReferenceOverlay(track, referenceOverlayHtml.at(track));
+    }
 }
 
 void MainWindow::UpdateSubPosition() {
-    QSizeF textRectSize = subTextItem->boundingRect().size() * subTextScaleFactor;
-    qreal target_y = videoItem->size().height() - textRectSize.height();
-    qreal target_x = (videoItem->size().width() - textRectSize.width()) / 2;
-    subTextItem->setPos(target_x, target_y);
+    QList<QGraphicsPixmapItem *> Items = { subOverlayItem };
+    Items.append(referenceOverlayItems);
+
+    // The edited track at the bottom, the reference tracks stacked above
+    // it. Ones without a cue showing take no room.
+    qreal Bottom = videoItem->size().height();
+    for (QGraphicsPixmapItem *Item : qAsConst(Items)) {
+        // The pixmap is drawn at the scale already
+        QSizeF textRectSize = Item->boundingRect().size();
+        qreal target_y = Bottom - textRectSize.height();
+        qreal target_x = (videoItem->size().width() - textRectSize.width()) / 2;
+        Item->setPos(target_x, target_y);
+
+        Bottom = target_y;
+    }
 }
 
-QTime MainWindow::MsToTime(int ms) {
-    if (ms < 0)
-        return QTime();
-
-    int hours, minutes, seconds, milliseconds = ms;
+QTime MainWindow::MsToTime(qint64 ms) {
+    // Times past a day show as its last ms, ApplySubtitle keeps them as
+    // they are unless they were edited
+    int hours, minutes, seconds, milliseconds = int(qBound<qint64>(0, ms, MaxEditTime));
 
     if (milliseconds < 3600000)
         hours = 0;
@@ -283,26 +507,28 @@ void MainWindow::NewAction() {
         return;
     }
 
-    subtitlesModel->clear();
-    Subtitles.clear();
+    CancelLoading();
+
+    subtitlesModel->Clear();
 
     SubFilePath.clear();
     setWindowTitle("untitled - Subshop");
 
-    UndoItems.clear();
-    RedoItems.clear();
+    History.Clear();
 
     EditingSubtitleIndex = -1;
     PrevEditinSubtitleIndex = EditingSubtitleIndex;
 
-    subTextItem->setPlainText(QString());
+    ShowOverlay(QString());
 
     ui->SubtitleTextEdit->setPlainText(QString());
-    ui->ShowSubTimeEdit->setTime(QTime());
-    ui->HideSubTimeEdit->setTime(QTime());
+    ui->ShowSubTimeEdit->setTime(QTime(0, 0));
+    ui->HideSubTimeEdit->setTime(QTime(0, 0));
 
     ui->SubtitleGroupBox->setEnabled(true);
     SetIsSaved(false);
+
+    StartJournal();
 }
 
 void MainWindow::OpenAction() {
@@ -320,31 +546,50 @@ void MainWindow::OpenAction() {
     OpenSubtitleFile(file);
 }
 
+void MainWindow::OpenReferenceAction() {
+    QString file = QFileDialog::getOpenFileName(this, "Open Reference Track", QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation), SubtitleFileSelector);
+
+    if (file.isEmpty()) return;
+
+    if (!QFile(file).exists()) {
+        QMessageBox::critical(this, "Error", "File \"" + file + "\" doesn't exist");
+        return;
+    }
+
+    OpenReferenceTrack(file);
+}
+
+void MainWindow::CloseReferencesAction() {
+    for (ReferenceTrack *Track : qAsConst(ReferenceTracks)) {
+        cues->RemoveTimeline(Track->getTimeline());
+        delete Track;
+    }
+
+    for (QGraphicsPixmapItem *Item : qAsConst(referenceOverlayItems)) {
+        scene->removeItem(Item);
+        delete Item;
+    }
+
+    ReferenceTracks.clear();
+    referenceOverlayItems.clear();
+    referenceOverlayHtml.clear();
+
+    UpdateTracks();
+    UpdateSubPosition();
+}
+
 void MainWindow::SaveAction() {
     if (SubFilePath.isEmpty()) {
         SaveAsAction();
         return;
     }
 
-    QString suffix(QFileInfo(SubFilePath).suffix());
-    if (suffix == "srt") {
-        if (!SubParser::ExportSrt(Subtitles, SubFilePath)) {
-            QMessageBox::critical(this, "Error", "Could't save subtitle file to \"" + SubFilePath + "\"");
-            return;
-        }
-    }
-    else if (suffix == "vtt") {
-        if (!SubParser::ExportVtt(Subtitles, SubFilePath)) {
-            QMessageBox::critical(this, "Error", "Could't save subtitle file to \"" + SubFilePath + "\"");
-            return;
-        }
-    }
-    else {
-        QMessageBox::critical(this, "Error", "Unsupported file type \"" + suffix + "\"");
+    if (!WriteSubtitleFile(SubFilePath)) {
         return;
     }
 
     SetIsSaved(true);
+    CompactJournal();
 }
 
 void MainWindow::SaveAsAction() {
@@ -354,21 +599,7 @@ void MainWindow::SaveAsAction() {
         return;
     }
 
-    QString suffix(QFileInfo(file).suffix());
-    if (suffix == "srt") {
-        if (!SubParser::ExportSrt(Subtitles, file)) {
-            QMessageBox::critical(this, "Error", "Could't save subtitle file to \"" + file + "\"");
-            return;
-        }
-    }
-    else if (suffix == "vtt") {
-        if (!SubParser::ExportVtt(Subtitles, file)) {
-            QMessageBox::critical(this, "Error", "Could't save subtitle file to \"" + file + "\"");
-            return;
-        }
-    }
-    else {
-        QMessageBox::critical(this, "Error", "Unsupported file type \"" + suffix + "\"");
+    if (!WriteSubtitleFile(file)) {
         return;
     }
 
@@ -377,6 +608,45 @@ void MainWindow::SaveAsAction() {
     setWindowTitle(fileInfo.fileName() + " - Subshop");
 
     SetIsSaved(true);
+    CompactJournal();
+}
+
+bool MainWindow::WriteSubtitleFile(const QString &Path) {
+    QString suffix(QFileInfo(Path).suffix());
+    const SubtitleFormat *Format = FormatRegistry::Instance().ForSuffix(suffix);
+    if (!Format) {
+        QMessageBox::critical(this, "Error", "Unsupported file type \"" + suffix + "\"");
+        return false;
+    }
+
+    // A project being saved over must not be mapped anymore
+    if (QFileInfo(Path) == QFileInfo(SubFilePath)) {
+        Subtitles.detach();
+    }
+
+    SubParser::ExportStats Stats;
+    bool Written;
+    if (Format == FormatRegistry::Instance().ForSuffix(ProjectFile::Suffix)) {
+        ProjectFile::Extras Extras;
+        Extras.MediaPath = MediaFilePath;
+        Extras.History = History.Save();
+        Written = ProjectFile::Write(Subtitles, Path, Extras, &Stats);
+    }
+    else {
+        Written = Format->Write(Subtitles, Path, &Stats);
+    }
+
+    if (!Written) {
+        QMessageBox::critical(this, "Error", "Could't save subtitle file to \"" + Path + "\"");
+        return false;
+    }
+
+    statusBar()->showMessage(QString("Saved %1 subtitles in %2 ms (%3 MB/s)")
+                             .arg(Stats.Cues)
+                             .arg(Stats.Nanoseconds / 1e6, 0, 'f', 1)
+                             .arg(Stats.getMegabytesPerSecond(), 0, 'f', 1), 5000);
+
+    return true;
 }
 
 void MainWindow::CloseAction() {
@@ -384,8 +654,10 @@ void MainWindow::CloseAction() {
         return;
     }
 
-    subtitlesModel->clear();
-    Subtitles.clear();
+    CancelLoading();
+    RemoveJournal();
+
+    subtitlesModel->Clear();
 
     SubFilePath.clear();
     setWindowTitle("Subshop");
@@ -393,14 +665,13 @@ void MainWindow::CloseAction() {
     EditingSubtitleIndex = -1;
     PrevEditinSubtitleIndex = EditingSubtitleIndex;
 
-    UndoItems.clear();
-    RedoItems.clear();
+    History.Clear();
 
-    subTextItem->setPlainText(QString());
+    ShowOverlay(QString());
 
     ui->SubtitleTextEdit->setPlainText(QString());
-    ui->ShowSubTimeEdit->setTime(QTime());
-    ui->HideSubTimeEdit->setTime(QTime());
+    ui->ShowSubTimeEdit->setTime(QTime(0, 0));
+    ui->HideSubTimeEdit->setTime(QTime(0, 0));
 
     ui->SubtitleGroupBox->setEnabled(false);
     hasFileOpen = false;
@@ -412,117 +683,380 @@ void MainWindow::ExitAction() {
 
 // Edit
 void MainWindow::UndoAction() {
-    if (UndoItems.isEmpty()) {
+    if (!History.canUndo()) {
         return;
     }
 
-    SubtitleItem NewItem;
-    UndoItem undo = UndoItems.last();
-    UndoItem::ItemType itemType = undo.getItemType();
-
-    if (itemType == UndoItem::ItemType::ADD) {
-        int i = Subtitles.indexOf(undo.getNewItem());
-        if (i >= 0) {
-            Subtitles.removeAt(i);
-            subtitlesModel->removeRow(i);
-        }
-    }
-    else if (itemType == UndoItem::ItemType::REMOVE) {
-        SubtitleItem SubItem = undo.getNewItem();
-        if (Subtitles.indexOf(SubItem) != -1) {
-            RedoItems.removeLast();
-            return;
-        }
+    UndoCommand Command = History.Undo();
+    SelectSubFromTable(Command.Undo(subtitlesModel));
 
-        subtitlesModel->setItem(Subtitles.size(), 0, new QStandardItem(SubItem.getShowTimestamp().toString("hh:mm:ss,zzz")));
-        subtitlesModel->setItem(Subtitles.size(), 1, new QStandardItem(SubItem.getHideTimestamp().toString("hh:mm:ss,zzz")));
-        subtitlesModel->setItem(Subtitles.size(), 2, new QStandardItem(SubItem.getSubtitle()));
+    SetIsSaved(false);
 
-        Subtitles.push_back(SubItem);
+    ShowAvailableSub();
+}
 
-        NewItem = SubItem;
+void MainWindow::RedoAction() {
+    if (!History.canRedo()) {
+        return;
     }
-    else if (itemType == UndoItem::ItemType::EDIT) {
-        int i = Subtitles.indexOf(undo.getNewItem());
-        if (i >= 0) {
-            SubtitleItem SubItem(undo.getOldItem());
 
-            subtitlesModel->setItem(i, 0, new QStandardItem(SubItem.getShowTimestamp().toString("hh:mm:ss,zzz")));
-            subtitlesModel->setItem(i, 1, new QStandardItem(SubItem.getHideTimestamp().toString("hh:mm:ss,zzz")));
-            subtitlesModel->setItem(i, 2, new QStandardItem(SubItem.getSubtitle()));
+    UndoCommand Command = History.Redo();
+    SelectSubFromTable(Command.Redo(subtitlesModel));
 
-            Subtitles.replace(i, SubItem);
+    SetIsSaved(false);
 
-            NewItem = SubItem;
-        }
+    ShowAvailableSub();
+}
+
+void MainWindow::FindAction() {
+    searchPanel->Activate();
+}
+
+void MainWindow::ReplaceAllAction() {
+    if (!hasFileOpen || isLoading) {
+        return;
     }
 
-    RedoItems.append(undo);
-    UndoItems.removeLast();
+    QVector<SubtitleSearch::Replacement> Replacements = Search.Replace(searchPanel->getQuery(), searchPanel->getReplacement());
+    if (Replacements.isEmpty()) {
+        return;
+    }
 
-    subtitlesModel->sort(0);
-    std::sort(Subtitles.begin(), Subtitles.end(), SubtitleItem::SortByShowTime);
+    // Only the text changes, so every cue stays in its row
+    History.BeginMacro("Replace All");
+    for (const SubtitleSearch::Replacement &replacement : Replacements) {
+        SubtitleItem OldItem = Subtitles.at(replacement.Row);
+        SubtitleItem NewItem = OldItem;
+        NewItem.setSubtitle(replacement.Text);
 
-    SelectSubFromTable(Subtitles.indexOf(NewItem));
+        History.Push(UndoItem(OldItem, NewItem, UndoItem::ItemType::EDIT));
+        subtitlesModel->Replace(replacement.Row, NewItem);
+    }
+    History.EndMacro();
 
     SetIsSaved(false);
+    statusBar()->showMessage(QString("Replaced in %1 subtitles").arg(Replacements.size()), 5000);
 
     ShowAvailableSub();
 }
 
-void MainWindow::RedoAction() {
-    if (RedoItems.isEmpty()) {
+void MainWindow::SnapAllToFramesAction() {
+    if (!hasFileOpen || isLoading || Subtitles.isEmpty())
+        return;
+
+    const QVector<qint64> &ShowTimes = Subtitles.getShowTimes();
+    const QVector<qint64> &HideTimes = Subtitles.getHideTimes();
+
+    // Snapping never changes the order, every cue stays in its row
+    QVector<qint64> NewShowTimes(ShowTimes.size());
+    QVector<qint64> NewHideTimes(HideTimes.size());
+    for (int i = 0; i < ShowTimes.size(); i++) {
+        NewShowTimes[i] = VideoFrameRate.Snap(ShowTimes.at(i));
+        NewHideTimes[i] = VideoFrameRate.Snap(HideTimes.at(i));
+    }
+
+    if (NewShowTimes == ShowTimes && NewHideTimes == HideTimes) {
+        statusBar()->showMessage("Every subtitle is already on a frame boundary", 5000);
         return;
     }
 
-    SubtitleItem NewItem;
-    UndoItem redo = RedoItems.last();
-    UndoItem::ItemType itemType = redo.getItemType();
+    ApplyTimes(0, NewShowTimes, NewHideTimes, "Snap to Frames");
+    statusBar()->showMessage(QString("Snapped %1 subtitles to %2 fps frames").arg(Subtitles.size()).arg(VideoFrameRate.getName()), 5000);
+}
 
-    if (itemType == UndoItem::ItemType::ADD) {
-        SubtitleItem SubItem = redo.getNewItem();
-        if (Subtitles.indexOf(SubItem) != -1) {
-            RedoItems.removeLast();
-            return;
+void MainWindow::ConvertFrameRateAction() {
+    if (!hasFileOpen || isLoading || Subtitles.isEmpty())
+        return;
+
+    QDialog Dialog(this);
+    Dialog.setWindowTitle("Convert Frame Rate");
+
+    QFormLayout *Layout = new QFormLayout(&Dialog);
+    QComboBox *FromBox = new QComboBox(&Dialog);
+    QComboBox *ToBox = new QComboBox(&Dialog);
+
+    for (QComboBox *box : { FromBox, ToBox }) {
+        box->setEditable(true);
+        for (const FrameRate &rate : FrameRate::Common()) {
+            box->addItem(rate.getName());
         }
+    }
 
-        subtitlesModel->setItem(Subtitles.size(), 0, new QStandardItem(SubItem.getShowTimestamp().toString("hh:mm:ss,zzz")));
-        subtitlesModel->setItem(Subtitles.size(), 1, new QStandardItem(SubItem.getHideTimestamp().toString("hh:mm:ss,zzz")));
-        subtitlesModel->setItem(Subtitles.size(), 2, new QStandardItem(SubItem.getSubtitle()));
+    FromBox->setCurrentText(VideoFrameRate.getName());
+    ToBox->setCurrentText(FrameRate(25).getName());
 
-        Subtitles.push_back(SubItem);
+    QDialogButtonBox *Buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, &Dialog);
+    connect(Buttons, SIGNAL(accepted()), &Dialog, SLOT(accept()));
+    connect(Buttons, SIGNAL(rejected()), &Dialog, SLOT(reject()));
 
-        NewItem = SubItem;
+    Layout->addRow("Timed for:", FromBox);
+    Layout->addRow("Convert to:", ToBox);
+    Layout->addRow(Buttons);
+
+    if (Dialog.exec() != QDialog::Accepted)
+        return;
+
+    FrameRate From = FrameRate::FromFps(FromBox->currentText().toDouble());
+    FrameRate To = FrameRate::FromFps(ToBox->currentText().toDouble());
+    if (!From.isValid() || !To.isValid()) {
+        QMessageBox::critical(this, "Error", "Invalid frame rate");
+        return;
     }
-    else if (itemType == UndoItem::ItemType::REMOVE) {
-        int i = Subtitles.indexOf(redo.getNewItem());
-        if (i >= 0) {
-            Subtitles.removeAt(i);
-            subtitlesModel->removeRow(i);
-        }
+
+    if (From == To)
+        return;
+
+    // A frame keeps its number, so its time scales by the ratio of the rates
+    Retime(Retiming::Stretch(From.getFps() / To.getFps()), 0, Subtitles.size(), "Convert Frame Rate");
+    statusBar()->showMessage(QString("Converted %1 subtitles from %2 to %3 fps").arg(Subtitles.size()).arg(From.getName(), To.getName()), 5000);
+}
+
+void MainWindow::ShiftTimesAction() {
+    if (!hasFileOpen || isLoading || Subtitles.isEmpty())
+        return;
+
+    int First, Count;
+    if (!RetimeRange(First, Count))
+        return;
+
+    QDialog Dialog(this);
+    Dialog.setWindowTitle("Shift Times");
+
+    QFormLayout *Layout = new QFormLayout(&Dialog);
+    QSpinBox *OffsetBox = new QSpinBox(&Dialog);
+    OffsetBox->setRange(-MaxRetimeOffset, MaxRetimeOffset);
+    OffsetBox->setSingleStep(100);
+    OffsetBox->setSuffix(" ms");
+
+    Layout->addRow("Shift by:", OffsetBox);
+
+    if (!ExecRetimeDialog(Dialog, Layout, First, Count))
+        return;
+
+    Retime(Retiming::Shift(OffsetBox->value()), First, Count, "Shift Times");
+}
+
+void MainWindow::StretchTimesAction() {
+    if (!hasFileOpen || isLoading || Subtitles.isEmpty())
+        return;
+
+    int First, Count;
+    if (!RetimeRange(First, Count))
+        return;
+
+    QDialog Dialog(this);
+    Dialog.setWindowTitle("Stretch Times");
+
+    QFormLayout *Layout = new QFormLayout(&Dialog);
+    QDoubleSpinBox *RatioBox = new QDoubleSpinBox(&Dialog);
+    RatioBox->setRange(1.0, 1000.0);
+    RatioBox->setDecimals(3);
+    RatioBox->setValue(100.0);
+    RatioBox->setSuffix(" %");
+
+    Layout->addRow("Stretch to:", RatioBox);
+
+    if (!ExecRetimeDialog(Dialog, Layout, First, Count))
+        return;
+
+    // The first subtitle stays where it is and the rest move away from it
+    Retime(Retiming::Stretch(RatioBox->value() / 100.0, Subtitles.getShowTime(First)), First, Count, "Stretch Times");
+}
+
+void MainWindow::SyncTimesAction() {
+    if (!hasFileOpen || isLoading || Subtitles.isEmpty())
+        return;
+
+    int First, Count;
+    if (!RetimeRange(First, Count))
+        return;
+
+    int Last = First + Count - 1;
+    if (Count < 2 || Subtitles.getShowTime(First) == Subtitles.getShowTime(Last)) {
+        QMessageBox::warning(this, "Warning", "Syncing needs two subtitles that show at different times");
+        return;
+    }
+
+    QDialog Dialog(this);
+    Dialog.setWindowTitle("Sync Times");
+
+    QFormLayout *Layout = new QFormLayout(&Dialog);
+    QTimeEdit *FirstEdit = new QTimeEdit(MsToTime(Subtitles.getShowTime(First)), &Dialog);
+    QTimeEdit *LastEdit = new QTimeEdit(MsToTime(Subtitles.getShowTime(Last)), &Dialog);
+
+    for (QTimeEdit *edit : { FirstEdit, LastEdit }) {
+        edit->setDisplayFormat("hh:mm:ss,zzz");
+    }
+
+    Layout->addRow(QString("Subtitle %1 shows at:").arg(First + 1), FirstEdit);
+    Layout->addRow(QString("Subtitle %1 shows at:").arg(Last + 1), LastEdit);
+
+    if (!ExecRetimeDialog(Dialog, Layout, First, Count))
+        return;
+
+    if (FirstEdit->time() == LastEdit->time()) {
+        QMessageBox::critical(this, "Error", QString("Subtitles %1 and %2 can't show at the same time").arg(First + 1).arg(Last + 1));
+        return;
+    }
+
+    // Lines up both and everything between and around them follows
+    Retiming Sync = Retiming::Sync(Subtitles.getShowTime(First), FirstEdit->time().msecsSinceStartOfDay(),
+                                   Subtitles.getShowTime(Last), LastEdit->time().msecsSinceStartOfDay());
+    if (!Sync.isValid()) {
+        QMessageBox::critical(this, "Error", QString("Subtitle %1 has to show before subtitle %2").arg(First + 1).arg(Last + 1));
+        return;
     }
-    else if (itemType == UndoItem::ItemType::EDIT) {
-        int i = Subtitles.indexOf(redo.getOldItem());
-        if (i >= 0) {
-            SubtitleItem SubItem(redo.getNewItem());
 
-            subtitlesModel->setItem(i, 0, new QStandardItem(SubItem.getShowTimestamp().toString("hh:mm:ss,zzz")));
-            subtitlesModel->setItem(i, 1, new QStandardItem(SubItem.getHideTimestamp().toString("hh:mm:ss,zzz")));
-            subtitlesModel->setItem(i, 2, new QStandardItem(SubItem.getSubtitle()));
+    Retime(Sync, First, Count, "Sync Times");
+}
+
+bool MainWindow::RetimeRange(int &first, int &count) {
+    // Ranges rather than indexes, selecting a 100k rows makes a lot of them.
+    // Cells of a row can be in ranges of their own, so they're merged.
+    QVector<QPair<int, int>> Ranges;
+    for (const QItemSelectionRange &range : ui->SubTableView->selectionModel()->selection()) {
+        Ranges.append(qMakePair(range.top(), range.bottom()));
+    }
 
-            Subtitles.replace(i, SubItem);
+    std::sort(Ranges.begin(), Ranges.end());
 
-            NewItem = SubItem;
+    int SelectedFirst = Ranges.isEmpty() ? 0 : Ranges.first().first;
+    int SelectedLast = Ranges.isEmpty() ? -1 : Ranges.first().second;
+    for (const QPair<int, int> &range : qAsConst(Ranges)) {
+        if (range.first > SelectedLast + 1) {
+            // Rows between the ranges would be retimed along with them
+            QMessageBox::warning(this, "Warning", "Only subtitles selected in one block can be retimed");
+            return false;
         }
+
+        SelectedLast = qMax(SelectedLast, range.second);
+    }
+
+    // A single row is selected whenever a cue shows, that isn't a choice
+    if (SelectedLast > SelectedFirst) {
+        first = SelectedFirst;
+        count = SelectedLast - SelectedFirst + 1;
+    }
+    else {
+        first = 0;
+        count = Subtitles.size();
+    }
+
+    return true;
+}
+
+bool MainWindow::ExecRetimeDialog(QDialog &dialog, QFormLayout *layout, int first, int count) {
+    QString Rows = count == Subtitles.size() ? QString("All %1 subtitles").arg(count) : QString("Subtitles %1 to %2").arg(first + 1).arg(first + count);
+
+    QDialogButtonBox *Buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, &dialog);
+    connect(Buttons, SIGNAL(accepted()), &dialog, SLOT(accept()));
+    connect(Buttons, SIGNAL(rejected()), &dialog, SLOT(reject()));
+
+    layout->insertRow(0, "Retime:", new QLabel(Rows, &dialog));
+    layout->addRow(Buttons);
+
+    return dialog.exec() == QDialog::Accepted;
+}
+
+void MainWindow::Retime(const Retiming &retiming, int first, int count, const QString &text) {
+    if (count <= 0 || retiming.isIdentity())
+        return;
+
+    if (!retiming.isValid()) {
+        QMessageBox::critical(this, "Error", "Retiming would reverse the order of the subtitles");
+        return;
+    }
+
+    // Show times stay between the rows around the range and at or after
+    // zero, which keeps every row where it is without sorting
+    qint64 MinShow = first > 0 ? qMax<qint64>(0, Subtitles.getShowTime(first - 1)) : 0;
+    qint64 MaxShow = first + count < Subtitles.size() ? Subtitles.getShowTime(first + count) : std::numeric_limits<qint64>::max();
+
+    QVector<qint64> NewShowTimes(count);
+    QVector<qint64> NewHideTimes(count);
+    int Held = retiming.Apply(Subtitles.getShowTimes().constData() + first, Subtitles.getHideTimes().constData() + first,
+                              NewShowTimes.data(), NewHideTimes.data(), count, MinShow, MaxShow);
+
+    // Held cues all show at the bound and pile up on each other there
+    if (Held > 0) {
+        QString Bound = first > 0 || MaxShow != std::numeric_limits<qint64>::max() ? "at the subtitles around the selection" : "at zero";
+        int result = QMessageBox::question(this, "Confirm", QString("%1 of %2 subtitles would be stopped %3 and show on top of each other. Retime anyway?").arg(Held).arg(count).arg(Bound),
+                                           QMessageBox::Yes | QMessageBox::Cancel, QMessageBox::Cancel);
+        if (result != QMessageBox::Yes)
+            return;
+    }
+
+    // A shift that nothing got in the way of is undone by its offset alone
+    if (Held == 0 && retiming.isShift()) {
+        History.Push(UndoItem::Shifted(first, count, retiming.getShift()), text);
+        subtitlesModel->ShiftTimes(first, count, retiming.getShift());
+
+        SetIsSaved(false);
+        ShowAvailableSub();
+    }
+    else {
+        ApplyTimes(first, NewShowTimes, NewHideTimes, text);
+    }
+
+    if (Held > 0) {
+        statusBar()->showMessage(QString("Retimed %1 subtitles, %2 stopped at zero or at the subtitles around them").arg(count).arg(Held), 5000);
+    }
+    else {
+        statusBar()->showMessage(QString("Retimed %1 subtitles").arg(count), 5000);
+    }
+}
+
+void MainWindow::SnapToShotsAction() {
+    if (!hasFileOpen || isLoading)
+        return;
+
+    if (EditingSubtitleIndex < 0 || EditingSubtitleIndex >= Subtitles.size()) {
+        QMessageBox::warning(this, "Warning", "Please, select a subtitle first");
+        return;
+    }
+
+    if (shotAnalyzer == nullptr || shotAnalyzer->getIndex().getCuts().isEmpty()) {
+        statusBar()->showMessage("No shot changes found in the media yet", 5000);
+        return;
+    }
+
+    const ShotIndex &Shots = shotAnalyzer->getIndex();
+    SubtitleItem OldItem = Subtitles.at(EditingSubtitleIndex);
+    SubtitleItem NewItem = OldItem;
+
+    // Either end without a shot change close by stays where it is
+    qint64 Show = Shots.Nearest(OldItem.getShowTime(), ShotSnapDistance);
+    if (Show >= 0 && Show < OldItem.getHideTime()) {
+        NewItem.setShowTime(Show);
+    }
+
+    qint64 Hide = Shots.Nearest(OldItem.getHideTime(), ShotSnapDistance);
+    if (Hide >= 0 && Hide > NewItem.getShowTime()) {
+        NewItem.setHideTime(Hide);
+    }
+
+    if (NewItem.getShowTime() == OldItem.getShowTime() && NewItem.getHideTime() == OldItem.getHideTime()) {
+        statusBar()->showMessage("No shot change near the subtitle", 5000);
+        return;
     }
 
-    UndoItems.append(redo);
-    RedoItems.removeLast();
+    // The show time can pass a neighbour's, Replace puts the cue back in order
+    History.Push(UndoItem(OldItem, NewItem, UndoItem::ItemType::EDIT), "Snap to Shot Changes");
+    subtitlesModel->Replace(EditingSubtitleIndex, NewItem);
+
+    SetIsSaved(false);
+
+    // Lands on the snapped cue, so the fields show its new times
+    SeekTo(NewItem.getShowTime());
+    ShowAvailableSub();
+}
 
-    subtitlesModel->sort(0);
-    std::sort(Subtitles.begin(), Subtitles.end(), SubtitleItem::SortByShowTime);
+void MainWindow::ApplyTimes(int first, const QVector<qint64> &showTimes, const QVector<qint64> &hideTimes, const QString &text) {
+    QVector<qint64> OldShowTimes = Subtitles.getShowTimes().mid(first, showTimes.size());
+    QVector<qint64> OldHideTimes = Subtitles.getHideTimes().mid(first, hideTimes.size());
 
-    SelectSubFromTable(Subtitles.indexOf(NewItem));
+    History.Push(UndoItem::Retimed(first, OldShowTimes, OldHideTimes, showTimes, hideTimes), text);
+    subtitlesModel->SetTimes(first, showTimes, hideTimes);
 
     SetIsSaved(false);
 
@@ -546,6 +1080,14 @@ void MainWindow::OpenMediaAction() {
 }
 
 void MainWindow::CloseMediaAction() {
+    MediaFilePath.clear();
+    CancelWaveform();
+    waveform->Clear();
+    CancelShotDetection();
+
+    DetectedFrameRate = FrameRate();
+    UpdateFrameRateMenu();
+
     player->setMedia(QMediaContent());
     player->stop();
 
@@ -566,9 +1108,19 @@ void MainWindow::AboutHelpAction() {
 
 // Media player
 void MainWindow::OpenMediaFile(const QString &Path) {
+    MediaFilePath = Path;
     player->setMedia(QUrl::fromLocalFile(Path));
     player->play();
 
+    LoadWaveform(Path);
+
+    // Started once the duration is known
+    CancelShotDetection();
+
+    // Until the media says otherwise the last rate is kept
+    DetectedFrameRate = FrameRate();
+    UpdateFrameRateMenu();
+
     ui->TogglePlayButton->setIcon(style()->standardIcon(QStyle::SP_MediaPause));
     ui->StopButton->setIcon(style()->standardIcon(QStyle::SP_MediaStop));
 
@@ -584,6 +1136,9 @@ void MainWindow::VideoSeekableChanged(bool) {
 
 void MainWindow::VideoDurationChanged(qint64 value) {
     ui->TimelineSlider->setMaximum(value);
+    waveform->setDuration(value);
+
+    StartShotDetection(value);
 }
 
 void MainWindow::VideoPositionChanged(qint64 value) {
@@ -593,18 +1148,144 @@ void MainWindow::VideoPositionChanged(qint64 value) {
     if (!ui->TimelineSlider->isSliderDown())
         ui->TimelineSlider->setValue(value);
 
-    int SubDuration = QTime(0, 0, 0).msecsTo(ui->DurationSubTimeEdit->time());
-
-    ui->ShowSubTimeEdit->setTime(MsToTime(CurrentPosition));
-    ui->HideSubTimeEdit->setTime(MsToTime(CurrentPosition + SubDuration));
+    waveform->setPosition(value);
+    UpdateFrameLabel();
 
     ui->TimelineLabel->setText(MsToTime(CurrentPosition).toString("hh:mm:ss,zzz") + " / " + MsToTime(TotalDuration).toString("hh:mm:ss,zzz"));
 
-    ShowAvailableSub();
+    // Between cues the editor follows the playhead, for adding a new one
+    // there. Otherwise it only changes along with the cues on screen.
+    if (EditingSubtitleIndex < 0) {
+        FollowPlayhead(value);
+    }
+
+    cues->setPosition(value);
+}
+
+void MainWindow::VideoStateChanged(QMediaPlayer::State state) {
+    cues->setPlaying(state == QMediaPlayer::PlayingState);
+}
+
+void MainWindow::VideoMetaDataChanged() {
+    FrameRate Detected = FrameRate::FromFps(player->metaData(QMediaMetaData::VideoFrameRate).toDouble());
+    if (!Detected.isValid() || Detected == DetectedFrameRate)
+        return;
+
+    DetectedFrameRate = Detected;
+    VideoFrameRate = Detected;
+
+    UpdateFrameRateMenu();
+    UpdateFrameLabel();
 }
 
 void MainWindow::TimelineSliderChanged(int value) {
-    player->setPosition(value);
+    SeekTo(value);
+}
+
+void MainWindow::WaveformSeekRequested(qint64 position) {
+    if (player->mediaStatus() == QMediaPlayer::NoMedia)
+        return;
+
+    SeekTo(position);
+}
+
+void MainWindow::LoadWaveform(const QString &mediaPath) {
+    CancelWaveform();
+    waveform->Clear();
+    waveform->setStatus("Reading audio...");
+
+    waveformLoader = new WaveformLoader(mediaPath, ++waveformLoadId);
+    waveformLoader->moveToThread(waveformThread);
+
+    connect(waveformLoader, SIGNAL(ProgressChanged(int,int)), this, SLOT(WaveformLoadProgress(int,int)));
+    connect(waveformLoader, SIGNAL(Finished(int,bool)), this, SLOT(WaveformLoadFinished(int,bool)));
+
+    QMetaObject::invokeMethod(waveformLoader, "Run", Qt::QueuedConnection);
+}
+
+void MainWindow::CancelWaveform() {
+    if (waveformLoader == nullptr)
+        return;
+
+    // Deletes itself, and the decoder with it, back on its own thread
+    waveformLoader->Cancel();
+    waveformLoader->deleteLater();
+    waveformLoader = nullptr;
+}
+
+void MainWindow::WaveformLoadProgress(int loadId, int percent) {
+    if (waveformLoader == nullptr || loadId != waveformLoadId)
+        return;
+
+    waveform->setStatus(QString("Reading audio... %1%").arg(percent));
+}
+
+void MainWindow::WaveformLoadFinished(int loadId, bool success) {
+    if (waveformLoader == nullptr || loadId != waveformLoadId)
+        return;
+
+    if (success) {
+        waveform->setPeaks(waveformLoader->getPeaks());
+    }
+    else {
+        waveform->setStatus("No audio");
+    }
+
+    waveformLoader->deleteLater();
+    waveformLoader = nullptr;
+}
+
+void MainWindow::StartShotDetection(qint64 duration) {
+    if (shotAnalyzer != nullptr || MediaFilePath.isEmpty() || duration <= 0)
+        return;
+
+    shotAnalyzer = new ShotAnalyzer(MediaFilePath, this);
+
+    connect(shotAnalyzer, SIGNAL(ProgressChanged(int)), this, SLOT(ShotDetectionProgress(int)));
+    connect(shotAnalyzer, SIGNAL(CutsChanged()), this, SLOT(ShotCutsChanged()));
+    connect(shotAnalyzer, SIGNAL(Finished(bool)), this, SLOT(ShotDetectionFinished(bool)));
+
+    shotAnalyzer->Start(duration);
+}
+
+void MainWindow::CancelShotDetection() {
+    ui->TimelineSlider->setMarkers(QVector<qint64>());
+    shotsLabel->clear();
+
+    if (shotAnalyzer == nullptr)
+        return;
+
+    // What was analysed so far is kept for the next time
+    delete shotAnalyzer;
+    shotAnalyzer = nullptr;
+}
+
+void MainWindow::ShotDetectionProgress(int percent) {
+    if (sender() != shotAnalyzer)
+        return;
+
+    shotsLabel->setText(QString("Finding shot changes %1%").arg(percent));
+}
+
+void MainWindow::ShotCutsChanged() {
+    if (sender() != shotAnalyzer)
+        return;
+
+    ui->TimelineSlider->setMarkers(shotAnalyzer->getIndex().getCuts());
+}
+
+void MainWindow::ShotDetectionFinished(bool success) {
+    if (sender() != shotAnalyzer)
+        return;
+
+    // The analyzer stays, it holds the cuts to snap to
+    if (success) {
+        shotsLabel->setText(QString("%1 shot changes").arg(shotAnalyzer->getIndex().getCuts().size()));
+    }
+    else {
+        shotsLabel->setText("No shot changes");
+        statusBar()->showMessage("Couldn't find shot changes, the video can't be decoded", 5000);
+    }
 }
 
 void MainWindow::TogglePlayVideo() {
@@ -630,17 +1311,90 @@ void MainWindow::StopVideo() {
 }
 
 void MainWindow::SeekForwards() {
+    // Half a second, landing on a frame
+    SeekFrames(qMax(1, qRound(VideoFrameRate.getFps() / 2)));
+}
+
+void MainWindow::SeekBackwards() {
+    SeekFrames(-qMax(1, qRound(VideoFrameRate.getFps() / 2)));
+}
+
+void MainWindow::PreviousFrame() {
+    // Single frames only mean something on a still picture
+    if (player->state() == QMediaPlayer::PlayingState)
+        TogglePlayVideo();
+
+    SeekFrames(-1);
+}
+
+void MainWindow::NextFrame() {
+    if (player->state() == QMediaPlayer::PlayingState)
+        TogglePlayVideo();
+
+    SeekFrames(1);
+}
+
+void MainWindow::StepFramesBackward() {
+    SeekFrames(-FrameStepSize);
+}
+
+void MainWindow::StepFramesForward() {
+    SeekFrames(FrameStepSize);
+}
+
+void MainWindow::FrameStepSizeAction() {
+    bool ok;
+    int Size = QInputDialog::getInt(this, "Frame Step Size", "Frames to step by:", FrameStepSize, 1, 10000, 1, &ok);
+    if (ok) {
+        FrameStepSize = Size;
+    }
+}
+
+void MainWindow::FrameRateSelected(QAction *action) {
+    VideoFrameRate = FrameRate::FromFps(action->data().toDouble());
+    UpdateFrameLabel();
+}
+
+void MainWindow::SeekFrames(qint64 frames) {
     if (player->mediaStatus() == QMediaPlayer::NoMedia)
         return;
 
-    player->setPosition(player->position() + 500);
+    qint64 Frame = qMax<qint64>(0, VideoFrameRate.FrameAt(player->position()) + frames);
+    SeekTo(VideoFrameRate.TimeOf(Frame));
 }
 
-void MainWindow::SeekBackwards() {
-    if (player->mediaStatus() == QMediaPlayer::NoMedia)
+void MainWindow::UpdateFrameRateMenu() {
+    // Actions belong to the menu, clearing it takes them out of the group
+    ui->menuFrameRate->clear();
+
+    QVector<FrameRate> Rates = FrameRate::Common();
+    if (DetectedFrameRate.isValid() && !Rates.contains(DetectedFrameRate)) {
+        Rates.append(DetectedFrameRate);
+    }
+
+    for (const FrameRate &rate : Rates) {
+        QString Text = rate.getName() + " fps";
+        if (rate == DetectedFrameRate) {
+            Text += " (detected)";
+        }
+
+        QAction *Action = ui->menuFrameRate->addAction(Text);
+        Action->setCheckable(true);
+        Action->setChecked(rate == VideoFrameRate);
+        Action->setData(rate.getFps());
+        frameRateGroup->addAction(Action);
+    }
+}
+
+void MainWindow::UpdateFrameLabel() {
+    QString Rate = VideoFrameRate.getName() + " fps";
+
+    if (player->mediaStatus() == QMediaPlayer::NoMedia) {
+        frameLabel->setText(Rate);
         return;
+    }
 
-    player->setPosition(player->position() - 500);
+    frameLabel->setText(QString("Frame %1 @ %2").arg(VideoFrameRate.FrameAt(player->position())).arg(Rate));
 }
 
 void MainWindow::VolumeUp() {
@@ -672,76 +1426,531 @@ void MainWindow::OpenSubtitleFile(const QString &Path) {
     QFileInfo fileInfo(SubFilePath);
     setWindowTitle(fileInfo.fileName() + " - Subshop");
 
-    UndoItems.clear();
-    RedoItems.clear();
+    History.Clear();
 
     EditingSubtitleIndex = -1;
     PrevEditinSubtitleIndex = EditingSubtitleIndex;
 
-    QString suffix(fileInfo.suffix());
-    if (suffix == "srt") {
-        Subtitles = SubParser::ParseSrt(SubFilePath);
+    const SubtitleFormat *format = FormatRegistry::Instance().Detect(SubFilePath);
+    if (!format) {
+        QMessageBox::critical(this, "Error", "Unsupported file type \"" + fileInfo.suffix() + "\"");
+        CloseAction();
+        return;
     }
-    else if (suffix == "vtt") {
-        Subtitles = SubParser::ParseVtt(SubFilePath);
+
+    CancelLoading();
+
+    // Journaling starts over once the file is in
+    RemoveJournal();
+
+    // Projects are mapped rather than parsed, no loader needed
+    if (format == FormatRegistry::Instance().ForSuffix(ProjectFile::Suffix)) {
+        OpenProjectFile(SubFilePath);
+        return;
+    }
+
+    subtitlesModel->Clear();
+
+    // The table fills in as batches arrive, see SubtitleBatchLoaded
+    ui->SubtitleGroupBox->setEnabled(false);
+    SetIsSaved(true);
+    SetLoading(true);
+
+    subtitleLoader = new SubtitleLoader(SubFilePath, format, ++subtitleLoadId);
+    subtitleLoader->moveToThread(loaderThread);
+
+    connect(subtitleLoader, SIGNAL(StylesLoaded(int,SubtitleStyleTable)), this, SLOT(SubtitleStylesLoaded(int,SubtitleStyleTable)));
+    connect(subtitleLoader, SIGNAL(BatchLoaded(int,QList<SubtitleItem>)), this, SLOT(SubtitleBatchLoaded(int,QList<SubtitleItem>)));
+    connect(subtitleLoader, SIGNAL(ProgressChanged(int,int)), this, SLOT(SubtitleLoadProgress(int,int)));
+    connect(subtitleLoader, SIGNAL(Finished(int,bool)), this, SLOT(SubtitleLoadFinished(int,bool)));
+
+    QMetaObject::invokeMethod(subtitleLoader, "Run", Qt::QueuedConnection);
+}
+
+void MainWindow::OpenProjectFile(const QString &Path) {
+    SubtitleStore Project;
+    ProjectFile::Extras Extras;
+    if (!ProjectFile::Read(Path, Project, &Extras)) {
+        QMessageBox::critical(this, "Error", "Couldn't read project file \"" + Path + "\"");
+        hasFileOpen = false;
+        CloseAction();
+        return;
+    }
+
+    // The history addresses cues by row, so it only fits the rows as they
+    // were saved. Sorting moves them, and the history is dropped then.
+    bool isSorted = Project.isSorted();
+    subtitlesModel->Reset(Project);
+
+    if (isSorted) {
+        History.Restore(Extras.History);
     }
     else {
-        QMessageBox::critical(this, "Error", "Unsupported file type \"" + suffix + "\"");
+        subtitlesModel->Sort();
+        History.Clear();
+        statusBar()->showMessage("The project's cues were out of order, its undo history was dropped", 5000);
+    }
+
+    ui->SubtitleGroupBox->setEnabled(true);
+    SetIsSaved(true);
+
+    if (!Extras.MediaPath.isEmpty() && QFile::exists(Extras.MediaPath)) {
+        OpenMediaFile(Extras.MediaPath);
+    }
+
+    StartJournal();
+    ShowAvailableSub();
+}
+
+void MainWindow::SubtitleStylesLoaded(int loadId, const SubtitleStyleTable &styles) {
+    if (subtitleLoader == nullptr || loadId != subtitleLoadId)
+        return;
+
+    // What's loaded so far, the whole table comes with Finished
+    Subtitles.setStyles(styles);
+}
+
+void MainWindow::SubtitleBatchLoaded(int loadId, const QList<SubtitleItem> &batch) {
+    // Batches of a cancelled load can still be queued
+    if (subtitleLoader == nullptr || loadId != subtitleLoadId)
+        return;
+
+    subtitlesModel->Append(batch);
+
+    ui->SubtitleGroupBox->setEnabled(true);
+}
+
+void MainWindow::SubtitleLoadProgress(int loadId, int percent) {
+    if (subtitleLoader == nullptr || loadId != subtitleLoadId)
+        return;
+
+    loadProgressBar->setValue(percent);
+}
+
+void MainWindow::SubtitleLoadFinished(int loadId, bool success) {
+    if (subtitleLoader == nullptr || loadId != subtitleLoadId)
+        return;
+
+    // The loader is done with its style table and encoding once it has finished
+    Subtitles.setStyles(subtitleLoader->getStyles());
+    Subtitles.setEncoding(subtitleLoader->getEncoding());
+
+    subtitleLoader->deleteLater();
+    subtitleLoader = nullptr;
+    SetLoading(false);
+
+    if (!success) {
+        QMessageBox::critical(this, "Error", "Couldn't read subtitle file \"" + SubFilePath + "\"");
+        hasFileOpen = false;
         CloseAction();
         return;
     }
 
-    subtitlesModel->clear();
-    for (int i = 0; i < Subtitles.size(); i++) {
-        subtitlesModel->setItem(i, 0, new QStandardItem(Subtitles.at(i).getShowTimestamp().toString("hh:mm:ss,zzz")));
-        subtitlesModel->setItem(i, 1, new QStandardItem(Subtitles.at(i).getHideTimestamp().toString("hh:mm:ss,zzz")));
-        subtitlesModel->setItem(i, 2, new QStandardItem(Subtitles.at(i).getSubtitle()));
+    if (!Subtitles.isSorted()) {
+        subtitlesModel->Sort();
     }
 
-    subtitlesModel->sort(0);
+    ui->SubtitleGroupBox->setEnabled(true);
+    StartJournal();
+    ShowAvailableSub();
+}
+
+void MainWindow::CancelSubtitleLoading() {
+    if (subtitleLoader == nullptr)
+        return;
+
+    hasFileOpen = false;
+    CloseAction();
+}
+
+void MainWindow::CancelLoading() {
+    if (subtitleLoader == nullptr)
+        return;
+
+    // The loader deletes itself once its thread gets back to the event loop
+    subtitleLoader->Cancel();
+    subtitleLoader->deleteLater();
+    subtitleLoader = nullptr;
+
+    SetLoading(false);
+}
+
+void MainWindow::SetLoading(bool value) {
+    isLoading = value;
+
+    loadProgressBar->setValue(0);
+    loadProgressBar->setVisible(value);
+    loadCancelButton->setVisible(value);
+
+    // Cues can't be edited or saved before the whole file is in
+    ui->ApplySubButton->setEnabled(!value);
+    ui->RemoveSubButton->setEnabled(!value);
+    ui->ActionSave->setEnabled(!value);
+    ui->ActionSaveAs->setEnabled(!value);
+    ui->ActionEditUndo->setEnabled(!value);
+    ui->ActionEditRedo->setEnabled(!value);
+}
+
+void MainWindow::StartJournal() {
+    isJournalCompacting = false;
+    if (!journal)
+        return;
+
+    // Loading the file again gives the same cues with the same ids, so the
+    // journal can refer to it
+    AutosaveJournal::Base Base = AutosaveJournal::BaseFor(SubFilePath, SubFilePath, MediaFilePath);
+
+    AutosaveJournal *Journal = journal;
+    QMetaObject::invokeMethod(journal, [Journal, Base]() { Journal->Start(Base); }, Qt::QueuedConnection);
+}
+
+void MainWindow::CompactJournal() {
+    if (!journal)
+        return;
+
+    isJournalCompacting = true;
+
+    // The copy only shares the store's columns, edits made meanwhile detach from it
+    SubtitleStore Snapshot = Subtitles;
+    AutosaveJournal::Base Base = AutosaveJournal::BaseFor(SubFilePath, QString(), MediaFilePath);
+
+    AutosaveJournal *Journal = journal;
+    QMetaObject::invokeMethod(journal, [Journal, Snapshot, Base]() { Journal->Compact(Snapshot, Base); }, Qt::QueuedConnection);
+}
+
+void MainWindow::RemoveJournal() {
+    isJournalCompacting = false;
+    if (!journal)
+        return;
+
+    AutosaveJournal *Journal = journal;
+    QMetaObject::invokeMethod(journal, [Journal]() { Journal->Remove(); }, Qt::QueuedConnection);
+}
+
+void MainWindow::JournalSizeChanged(qint64 bytes) {
+    if (bytes < AutosaveJournal::CompactSize) {
+        isJournalCompacting = false;
+        return;
+    }
+
+    // Appends queued before the snapshot was taken still report the old size
+    if (!isJournalCompacting) {
+        CompactJournal();
+    }
+}
+
+QString MainWindow::JournalDirectory() const {
+    return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/autosave";
+}
+
+void MainWindow::CheckForRecovery() {
+    QDir Directory(JournalDirectory());
+    const QFileInfoList Journals = Directory.entryInfoList(QStringList() << "*.journal", QDir::Files, QDir::Time);
+
+    for (const QFileInfo &info : Journals) {
+        QString Path = info.absoluteFilePath();
+        if (journal && Path == QFileInfo(journal->getFilePath()).absoluteFilePath())
+            continue;
+
+        // Still in use by another instance
+        QLockFile Lock(Path + ".lock");
+        if (!Lock.tryLock(0))
+            continue;
+
+        AutosaveJournal::Base Base;
+        QList<QByteArray> Changes;
+        if (AutosaveJournal::Read(Path, Base, Changes) && !Changes.isEmpty()) {
+            QString filename = QFileInfo(Base.DocumentPath).fileName();
+            if (filename.isEmpty())
+                filename = "untitled";
+
+            int result = QMessageBox::question(this, "Recover", "Subshop didn't exit properly while \"" + filename + "\" had unsaved changes.\nDo you want to recover them?", QMessageBox::Yes | QMessageBox::No, QMessageBox::Yes);
+            if (result == QMessageBox::Yes && RecoverJournal(Base, Changes)) {
+                // One document at a time, any other journal waits for the next start
+                AutosaveJournal::Discard(Path);
+                return;
+            }
+        }
+
+        AutosaveJournal::Discard(Path);
+    }
+}
+
+bool MainWindow::RecoverJournal(const AutosaveJournal::Base &base, const QList<QByteArray> &changes) {
+    if (!AutosaveJournal::isSourceUnchanged(base)) {
+        QMessageBox::critical(this, "Error", "File \"" + base.SourcePath + "\" has changed since, the changes can't be applied to it");
+        return false;
+    }
+
+    SubtitleStore Recovered;
+    if (!base.SourcePath.isEmpty()) {
+        const SubtitleFormat *Format = FormatRegistry::Instance().Detect(base.SourcePath);
+        if (!Format || !Format->ReadFile(base.SourcePath, Recovered)) {
+            QMessageBox::critical(this, "Error", "Couldn't read subtitle file \"" + base.SourcePath + "\"");
+            return false;
+        }
+    }
+
+    CancelLoading();
+    History.Clear();
+
+    // Snapshots get deleted once recovered, the store can't keep borrowing from one
+    subtitlesModel->Reset(Recovered);
+    Subtitles.detach();
+
+    if (!Subtitles.isSorted()) {
+        subtitlesModel->Sort();
+    }
+
+    // The changes are applied the way they were, the history they came from isn't restored
+    for (const QByteArray &change : changes) {
+        QDataStream in(change);
+        in.setVersion(QDataStream::Qt_5_12);
+
+        bool undone;
+        in >> undone;
+        UndoItem Item = UndoItem::Read(in);
+        if (in.status() != QDataStream::Ok)
+            break;
+
+        if (undone) {
+            Item.Undo(subtitlesModel);
+        }
+        else {
+            Item.Redo(subtitlesModel);
+        }
+    }
+
+    SubFilePath = base.DocumentPath;
+    EditingSubtitleIndex = -1;
+    PrevEditinSubtitleIndex = EditingSubtitleIndex;
 
     ui->SubtitleGroupBox->setEnabled(true);
-    SetIsSaved(true);
+    SetIsSaved(false);
+
+    if (!base.MediaPath.isEmpty() && QFile::exists(base.MediaPath)) {
+        OpenMediaFile(base.MediaPath);
+    }
+
+    // From here on the recovered cues are journaled by this instance
+    CompactJournal();
+    ShowAvailableSub();
+
+    return true;
 }
 
 void MainWindow::ShowAvailableSub() {
-    int Position = player->position();
+    const QVector<int> &ActiveRows = cues->Refresh();
 
     ClearSubtitle();
 
-    for (int i = 0; i < Subtitles.size(); i++) {
-        int SubShowTime = QTime(0, 0, 0).msecsTo(Subtitles.at(i).getShowTimestamp());
-        int SubHideTime = QTime(0, 0, 0).msecsTo(Subtitles.at(i).getHideTimestamp());
+    if (!ActiveRows.isEmpty()) {
+        DisplaySubtitle(ActiveRows);
+        tracksPanel->SelectCue(ActiveRows.first());
+    }
+    else {
+        FollowPlayhead(cues->getPosition());
+    }
 
-        int NextSubShowTime = -1;
-        if (Subtitles.size()-1 >= i+1) {
-            NextSubShowTime = QTime(0, 0, 0).msecsTo(Subtitles.at(i+1).getShowTimestamp());
+    for (int track = 0; track < ReferenceTracks.size(); track++) {
+        ReferenceTrack *Track = ReferenceTracks.at(track);
+        if (Track->isLoaded()) {
+            ShowReferenceOverlay(track, OverlayHtml(Track->getSubtitles(), cues->getActive(Track->getTimeline())));
         }
+    }
 
-        if (SubShowTime <= Position && Position <= SubHideTime && (Position != NextSubShowTime)) {
-            DisplaySubtitle(Subtitles.at(i));
-            break;
+    WarmOverlays(cues->getPosition());
+}
+
+void MainWindow::ActiveSubsChanged() {
+    ShowAvailableSub();
+}
+
+void MainWindow::SeekTo(qint64 position) {
+    player->setPosition(position);
+    cues->Seek(position);
+}
+
+void MainWindow::WarmOverlays(qint64 position) {
+    // Only once the next cue to show changes, not on every tick
+    int Next = Timeline.NextAfter(position);
+    if (Next == WarmedSubtitleIndex)
+        return;
+
+    WarmedSubtitleIndex = Next;
+
+    // Each on its own, cues that overlap are rendered together when they show
+    for (int row = Next; row < std::min(Next + WarmedOverlays, Subtitles.size()); row++) {
+        overlays->Warm(OverlayHtml(Subtitles, { row }));
+    }
+}
+
+void MainWindow::SubtitlesChanged() {
+    cues->Invalidate();
+    tracksPanel->ScheduleRefresh();
+    WarmedSubtitleIndex = -1;
+    waveform->update();
+    searchPanel->ScheduleRefresh();
+    problemsTimer->start();
+}
+
+void MainWindow::SubtitlesReset() {
+    Timeline.Invalidate();
+
+    // Maybe another file, whose name heads its column
+    UpdateTracks();
+
+    // Another file, nothing cached is going to show again
+    overlays->Clear();
+    WarmedSubtitleIndex = -1;
+
+    Search.InvalidateAll();
+    Linter.Invalidate();
+}
+
+void MainWindow::OpenReferenceTrack(const QString &Path) {
+    ReferenceTrack *Track = new ReferenceTrack(Path, this);
+    if (!Track->Load(loaderThread)) {
+        QMessageBox::critical(this, "Error", "Unsupported file type \"" + QFileInfo(Path).suffix() + "\"");
+        delete Track;
+        return;
+    }
+
+    connect(Track, SIGNAL(LoadFinished(bool)), this, SLOT(ReferenceTrackLoaded(bool)));
+
+    // Its overlay and column show up once it's loaded
+    ReferenceTracks.append(Track);
+
+    QGraphicsPixmapItem *Item = new QGraphicsPixmapItem();
+    Item->setTransformationMode(Qt::SmoothTransformation);
+    scene->addItem(Item);
+
+    referenceOverlayItems.append(Item);
+    referenceOverlayHtml.append(QString());
+
+    statusBar()->showMessage("Loading " + Track->getName() + "...", 5000);
+}
+
+void MainWindow::ReferenceTrackLoaded(bool success) {
+    ReferenceTrack *Track = qobject_cast<ReferenceTrack *>(sender());
+    int track = ReferenceTracks.indexOf(Track);
+    if (track < 0)
+        return;
+
+    if (!success) {
+        QMessageBox::critical(this, "Error", "Couldn't read subtitle file \"" + Track->getFilePath() + "\"");
+
+        ReferenceTracks.removeAt(track);
+        delete referenceOverlayItems.takeAt(track);
+        referenceOverlayHtml.removeAt(track);
+        Track->deleteLater();
+        return;
+    }
+
+    statusBar()->showMessage("Loaded " + Track->getName(), 5000);
+
+    cues->AddTimeline(Track->getTimeline());
+    UpdateTracks();
+    tracksPanel->show();
+
+    ShowAvailableSub();
+}
+
+void MainWindow::UpdateTracks() {
+    QVector<const SubtitleStore *> Tracks = { &Subtitles };
+    QStringList Names = { SubFilePath.isEmpty() ? QString("Subtitles") : QFileInfo(SubFilePath).fileName() };
+
+    for (ReferenceTrack *Track : qAsConst(ReferenceTracks)) {
+        if (Track->isLoaded()) {
+            Tracks.append(&Track->getSubtitles());
+            Names.append(Track->getName());
         }
     }
+
+    tracksPanel->setTracks(Tracks, Names);
+}
+
+void MainWindow::TrackRowActivated(qint64 time, int row) {
+    // Rows with a cue of the edited track select it, the rest only seek
+    if (row >= 0) {
+        SelectSubFromTable(row);
+    }
+    else if (player->mediaStatus() != QMediaPlayer::NoMedia) {
+        SeekTo(time);
+    }
+}
+
+void MainWindow::SubtitlesReordered() {
+    Timeline.Invalidate();
+
+    // Cues are indexed by id, so searching doesn't care about their order
+    Linter.Invalidate();
 }
 
-void MainWindow::DisplaySubtitle(const SubtitleItem &subItem) {
-    int index = Subtitles.indexOf(subItem);
-    if (index == -1)
+void MainWindow::SubtitleRowsInserted(const QModelIndex &, int first, int last) {
+    for (int row = first; row <= last; row++) {
+        Search.Invalidate(Subtitles.getId(row));
+    }
+
+    Timeline.RowsInserted(first, last);
+    Linter.RowsInserted(first, last);
+}
+
+void MainWindow::SubtitleRowsAboutToBeRemoved(const QModelIndex &, int first, int last) {
+    for (int row = first; row <= last; row++) {
+        Search.Invalidate(Subtitles.getId(row));
+    }
+}
+
+void MainWindow::SubtitleRowsRemoved(const QModelIndex &, int first, int last) {
+    Timeline.RowsRemoved(first, last);
+    Linter.RowsRemoved(first, last);
+}
+
+void MainWindow::SubtitleRowsMoved(const QModelIndex &, int start, int, const QModelIndex &, int row) {
+    // The destination was counted with the moved row still in place
+    int to = row > start ? row - 1 : row;
+    Timeline.RowMoved(start, to);
+    Linter.RowMoved(start, to);
+}
+
+void MainWindow::SubtitleDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight) {
+    Timeline.RowsChanged(topLeft.row(), bottomRight.row());
+    Linter.RowsChanged(topLeft.row(), bottomRight.row());
+
+    // Retiming leaves the text alone
+    if (bottomRight.column() < SubtitleTableModel::SubtitleColumn)
         return;
 
-    // Display Subtitle on Video
-    subTextItem->setHtml(subItem.getSubtitle().replace('\n', "<br>"));
-    UpdateSubPosition();
+    for (int row = topLeft.row(); row <= bottomRight.row(); row++) {
+        Search.Invalidate(Subtitles.getId(row));
+    }
+}
 
-    // Fill active Subtitle values on fields
-    int SubShowTime = QTime(0, 0, 0).msecsTo(subItem.getShowTimestamp());
-    int SubHideTime = QTime(0, 0, 0).msecsTo(subItem.getHideTimestamp());
+void MainWindow::UpdateProblems() {
+    int Count = Linter.getProblemCount();
+    problemsLabel->setText(Count > 0 ? QString("%1 subtitles with problems").arg(Count) : QString());
+
+    // Neighbours of a changed row may have gained or lost a problem too
+    subtitlesModel->ProblemsChanged();
+    ui->SubTableView->viewport()->update();
+}
+
+void MainWindow::DisplaySubtitle(const QVector<int> &rows) {
+    int index = rows.first();
+    if (0 > index || index >= Subtitles.size())
+        return;
+
+    SubtitleItem subItem = Subtitles.at(index);
 
-    ui->ShowSubTimeEdit->setTime(subItem.getShowTimestamp());
-    ui->HideSubTimeEdit->setTime(subItem.getHideTimestamp());
+    // Display every active Subtitle on Video, overlapping ones stack up
+    ShowOverlay(OverlayHtml(Subtitles, rows));
+
+    // Fill active Subtitle values on fields
+    ui->ShowSubTimeEdit->setTime(MsToTime(subItem.getShowTime()));
+    ui->HideSubTimeEdit->setTime(MsToTime(subItem.getHideTime()));
     ui->SubtitleTextEdit->setPlainText(subItem.getSubtitle());
-    ui->DurationSubTimeEdit->setTime(MsToTime(SubHideTime - SubShowTime));
+    ui->DurationSubTimeEdit->setTime(MsToTime(subItem.getDuration()));
 
     // Select active Subtitle on table
     ui->SubTableView->selectRow(index);
@@ -751,11 +1960,51 @@ void MainWindow::DisplaySubtitle(const SubtitleItem &subItem) {
     isSubApplied = true;
 }
 
+QString MainWindow::OverlayHtml(const SubtitleStore &subtitles, const QVector<int> &rows) const {
+    // Script cues are rendered from their override tags, comments aren't shown
+    const SubtitleStyleTable &Styles = subtitles.getStyles();
+
+    QStringList Lines;
+    for (int row : rows) {
+        if (!Styles.hasScript()) {
+            Lines.append(subtitles.getSubtitle(row).replace('\n', "<br>"));
+        }
+        else if (!Styles.isComment(subtitles.getStyle(row))) {
+            Lines.append(Styles.ToHtml(subtitles.getSubtitle(row), subtitles.getStyle(row)));
+        }
+    }
+
+    return Lines.join("<br>");
+}
+
+void MainWindow::ShowOverlay(const QString &html) {
+    subOverlayHtml = html;
+    subOverlayItem->setPixmap(overlays->Get(html));
+    UpdateSubPosition();
+}
+
+void MainWindow::ShowReferenceOverlay(int track, const QString &html) {
+    // Tinted, so they can't be taken for the edited track's. Cues with
+    // colours of their own keep them.
+    QString Tinted = html.isEmpty() ? html : QString("<font color=\"%1\">%2</font>").arg(ReferenceOverlayColor, html);
+
+    referenceOverlayHtml[track] = html;
+    referenceOverlayItems.at(track)->setPixmap(overlays->Get(Tinted));
+    UpdateSubPosition();
+}
+
+void MainWindow::FollowPlayhead(qint64 position) {
+    int SubDuration = ui->DurationSubTimeEdit->time().msecsSinceStartOfDay();
+
+    ui->ShowSubTimeEdit->setTime(MsToTime(position));
+    ui->HideSubTimeEdit->setTime(MsToTime(position + SubDuration));
+}
+
 void MainWindow::ClearSubtitle() {
-    subTextItem->setPlainText(QString());
+    ShowOverlay(QString());
 
-    ui->ShowSubTimeEdit->setTime(QTime());
-    ui->HideSubTimeEdit->setTime(QTime());
+    ui->ShowSubTimeEdit->setTime(QTime(0, 0));
+    ui->HideSubTimeEdit->setTime(QTime(0, 0));
     ui->SubtitleTextEdit->setPlainText(QString());
 
     ui->SubTableView->clearSelection();
@@ -770,7 +2019,7 @@ void MainWindow::SelectSubFromTable(int row) {
 
     if (!isSubApplied && EditingSubtitleIndex >= 0) {
         SubtitleItem currentSub = Subtitles.at(EditingSubtitleIndex);
-        QString Timestamps = currentSub.getShowTimestamp().toString("hh:mm:ss,zzz") + " - " + currentSub.getHideTimestamp().toString("hh:mm:ss,zzz");
+        QString Timestamps = SubtitleItem::FormatTime(currentSub.getShowTime()) + " - " + SubtitleItem::FormatTime(currentSub.getHideTime());
 
         int result = QMessageBox::question(this, "Confirm", "Subtitle at \"" + Timestamps + "\" has changed. Apply?", QMessageBox::Yes | QMessageBox::No | QMessageBox::Cancel, QMessageBox::Yes);
         if (result == QMessageBox::Yes) {
@@ -782,7 +2031,7 @@ void MainWindow::SelectSubFromTable(int row) {
         }
     }
 
-    player->setPosition(QTime(0, 0, 0).msecsTo(Subtitles.at(row).getShowTimestamp()));
+    SeekTo(Subtitles.getShowTime(row));
 }
 
 void MainWindow::SubTableRowClicked(QModelIndex index) {
@@ -798,25 +2047,25 @@ void MainWindow::GotoNextSub() {
 }
 
 void MainWindow::SubShowTimeChanged() {
-    int SubShowTime = QTime(0, 0, 0).msecsTo(ui->ShowSubTimeEdit->time());
-    int SubHideTime = QTime(0, 0, 0).msecsTo(ui->HideSubTimeEdit->time());
+    int SubShowTime = ui->ShowSubTimeEdit->time().msecsSinceStartOfDay();
+    int SubHideTime = ui->HideSubTimeEdit->time().msecsSinceStartOfDay();
 
     if (SubHideTime - SubShowTime < 0) {
-        int SubDuration = QTime(0, 0, 0).msecsTo(ui->DurationSubTimeEdit->time());
+        int SubDuration = ui->DurationSubTimeEdit->time().msecsSinceStartOfDay();
         ui->HideSubTimeEdit->setTime(MsToTime(SubShowTime + SubDuration));
     }
 }
 
 void MainWindow::SubHideTimeChanged() {
-    int SubShowTime = QTime(0, 0, 0).msecsTo(ui->ShowSubTimeEdit->time());
-    int SubHideTime = QTime(0, 0, 0).msecsTo(ui->HideSubTimeEdit->time());
+    int SubShowTime = ui->ShowSubTimeEdit->time().msecsSinceStartOfDay();
+    int SubHideTime = ui->HideSubTimeEdit->time().msecsSinceStartOfDay();
 
     ui->DurationSubTimeEdit->setTime(MsToTime(SubHideTime - SubShowTime));
 }
 
 void MainWindow::SubDurationChanged() {
-    int SubShowTime = QTime(0, 0, 0).msecsTo(ui->ShowSubTimeEdit->time());
-    int SubDuration = QTime(0, 0, 0).msecsTo(ui->DurationSubTimeEdit->time());
+    int SubShowTime = ui->ShowSubTimeEdit->time().msecsSinceStartOfDay();
+    int SubDuration = ui->DurationSubTimeEdit->time().msecsSinceStartOfDay();
 
     ui->HideSubTimeEdit->setTime(MsToTime(SubShowTime + SubDuration));
 }
@@ -828,15 +2077,30 @@ void MainWindow::SubTextToggleTag(const QString &tag) {
         return;
     }
 
+    QString Open, Close;
+    SubTextTags(tag, Open, Close);
+
     QString selectedText(textCursor.selectedText());
-    QString regExp("<" + tag + ">(.*)</" + tag + ">");
+    QString regExp(QRegExp::escape(Open) + "(.*)" + QRegExp::escape(Close));
 
     if (QRegExp(regExp).exactMatch(selectedText)) {
         selectedText.replace(QRegExp(regExp), "\\1");
         textCursor.insertText(selectedText);
     }
     else {
-        textCursor.insertText("<" + tag + ">" + selectedText + "</" + tag + ">");
+        textCursor.insertText(Open + selectedText + Close);
+    }
+}
+
+void MainWindow::SubTextTags(const QString &tag, QString &open, QString &close) {
+    // Scripts style text with override tags
+    if (Subtitles.getStyles().hasScript()) {
+        open = "{\\" + tag + "1}";
+        close = "{\\" + tag + "0}";
+    }
+    else {
+        open = "<" + tag + ">";
+        close = "</" + tag + ">";
     }
 }
 
@@ -860,7 +2124,10 @@ void MainWindow::SubCursorPosChanged() {
     QString selectedText(textCursor.selectedText());
 
     for (int i = 0; i < TagsLength; i++) {
-        QString regExp("<" + Tags[i] + ">(.*)</" + Tags[i] + ">");
+        QString Open, Close;
+        SubTextTags(Tags[i], Open, Close);
+
+        QString regExp(QRegExp::escape(Open) + "(.*)" + QRegExp::escape(Close));
         Buttons[i]->setChecked(QRegExp(regExp).exactMatch(selectedText));
     }
 }
@@ -887,9 +2154,29 @@ void MainWindow::ApplySubtitle() {
         return;
     }
 
+    if (isLoading) {
+        return;
+    }
+
     QString SubText = ui->SubtitleTextEdit->toPlainText();
-    QTime SubShowTime = ui->ShowSubTimeEdit->time();
-    QTime SubHideTime = ui->HideSubTimeEdit->time();
+    qint64 SubShowTime = ui->ShowSubTimeEdit->time().msecsSinceStartOfDay();
+    qint64 SubHideTime = ui->HideSubTimeEdit->time().msecsSinceStartOfDay();
+
+    if (ui->ActionEditSnapToFrames->isChecked()) {
+        SubShowTime = VideoFrameRate.Snap(SubShowTime);
+        SubHideTime = VideoFrameRate.Snap(SubHideTime);
+    }
+
+    // A cue past what the time edits can hold keeps the times they left alone
+    if (EditingSubtitleIndex >= 0) {
+        qint64 OldShowTime = Subtitles.getShowTime(EditingSubtitleIndex);
+        qint64 OldHideTime = Subtitles.getHideTime(EditingSubtitleIndex);
+
+        if (OldShowTime > MaxEditTime && ui->ShowSubTimeEdit->time() == MsToTime(OldShowTime))
+            SubShowTime = OldShowTime;
+        if (OldHideTime > MaxEditTime && ui->HideSubTimeEdit->time() == MsToTime(OldHideTime))
+            SubHideTime = OldHideTime;
+    }
 
     SubtitleItem SubItem(SubShowTime, SubHideTime, SubText);
 
@@ -899,25 +2186,18 @@ void MainWindow::ApplySubtitle() {
     }
 
     if (EditingSubtitleIndex < 0) {
-        subtitlesModel->setItem(Subtitles.size(), 0, new QStandardItem(SubShowTime.toString("hh:mm:ss,zzz")));
-        subtitlesModel->setItem(Subtitles.size(), 1, new QStandardItem(SubHideTime.toString("hh:mm:ss,zzz")));
-        subtitlesModel->setItem(Subtitles.size(), 2, new QStandardItem(SubText));
-
-        Subtitles.push_back(SubItem);
-        UndoItems.append(UndoItem(SubItem, UndoItem::ItemType::ADD));
+        int row = subtitlesModel->Insert(SubItem);
+        History.Push(UndoItem(Subtitles.at(row), UndoItem::ItemType::ADD), "Add Subtitle");
     }
     else {
-        subtitlesModel->setItem(EditingSubtitleIndex, 0, new QStandardItem(SubShowTime.toString("hh:mm:ss,zzz")));
-        subtitlesModel->setItem(EditingSubtitleIndex, 1, new QStandardItem(SubHideTime.toString("hh:mm:ss,zzz")));
-        subtitlesModel->setItem(EditingSubtitleIndex, 2, new QStandardItem(SubText));
+        SubtitleItem OldItem = Subtitles.at(EditingSubtitleIndex);
+        SubItem.setId(OldItem.getId());
+        SubItem.setStyle(OldItem.getStyle());
 
-        UndoItems.append(UndoItem(Subtitles.at(EditingSubtitleIndex), SubItem, UndoItem::ItemType::EDIT));
-        Subtitles.replace(EditingSubtitleIndex, SubItem);
+        History.Push(UndoItem(OldItem, SubItem, UndoItem::ItemType::EDIT), "Edit Subtitle");
+        subtitlesModel->Replace(EditingSubtitleIndex, SubItem);
     }
 
-    subtitlesModel->sort(0);
-    std::sort(Subtitles.begin(), Subtitles.end(), SubtitleItem::SortByShowTime);
-
     isSubApplied = true;
     SetIsSaved(false);
 
@@ -932,22 +2212,21 @@ void MainWindow::RemoveSubtitle() {
         return;
     }
 
+    if (isLoading) {
+        return;
+    }
+
     if (EditingSubtitleIndex < 0) {
         QMessageBox::warning(this, "Warning", "Please, select a subtitle first");
         return;
     }
 
-    subtitlesModel->removeRow(EditingSubtitleIndex);
-    subtitlesModel->sort(0);
-
-    UndoItems.append(UndoItem(Subtitles.at(EditingSubtitleIndex), UndoItem::ItemType::REMOVE));
-
-    Subtitles.removeAt(EditingSubtitleIndex);
-    std::sort(Subtitles.begin(), Subtitles.end(), SubtitleItem::SortByShowTime);
+    History.Push(UndoItem(Subtitles.at(EditingSubtitleIndex), UndoItem::ItemType::REMOVE), "Remove Subtitle");
+    subtitlesModel->Remove(EditingSubtitleIndex);
 
     ui->SubtitleTextEdit->setPlainText(QString());
-    ui->ShowSubTimeEdit->setTime(QTime());
-    ui->HideSubTimeEdit->setTime(QTime());
+    ui->ShowSubTimeEdit->setTime(QTime(0, 0));
+    ui->HideSubTimeEdit->setTime(QTime(0, 0));
 
     EditingSubtitleIndex = -1;
     isSubApplied = true;
@@ -11,22 +11,60 @@
 #include <QTextStream>
 #include <QMessageBox>
 #include <QFileDialog>
+#include <QInputDialog>
+#include <QDialogButtonBox>
+#include <QFormLayout>
+#include <QComboBox>
+#include <QSpinBox>
+#include <QDoubleSpinBox>
+#include <QTimeEdit>
 #include <QMimeData>
 #include <QFile>
+#include <QDir>
+#include <QDateTime>
+#include <QTimer>
+#include <QLockFile>
+#include <QActionGroup>
 
-#include <QStandardItemModel>
+#include <QHeaderView>
+
+#include <QThread>
+#include <QStatusBar>
+#include <QProgressBar>
+#include <QToolButton>
+#include <QLabel>
 
 #include <QGraphicsVideoItem>
 #include <QGraphicsScene>
 #include <QGraphicsView>
-#include <QGraphicsDropShadowEffect>
+#include <QGraphicsPixmapItem>
 #include <QMediaPlayer>
+#include <QMediaMetaData>
 
 #include "aboutdialog.h"
 
+#include "autosavejournal.h"
+#include "cuescheduler.h"
 #include "subtitleitem.h"
+#include "subtitlestore.h"
 #include "subparser.h"
-#include "undoitem.h"
+#include "formatregistry.h"
+#include "framerate.h"
+#include "overlaycache.h"
+#include "projectfile.h"
+#include "referencetrack.h"
+#include "retiming.h"
+#include "subtitleloader.h"
+#include "subtitletablemodel.h"
+#include "subtitletimeline.h"
+#include "subtitlesearch.h"
+#include "subtitlelinter.h"
+#include "searchpanel.h"
+#include "shotanalyzer.h"
+#include "trackspanel.h"
+#include "undostack.h"
+#include "waveformloader.h"
+#include "waveformwidget.h"
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
@@ -51,47 +89,162 @@ private:
     Ui::MainWindow *ui;
 
     QString SubFilePath;
+    QString MediaFilePath;
 
-    const QString SubtitleFileSelector = "Subtitle Files (*.srt *.vtt)";
-    const QString MediaFileSelector = "Media Files (*.mp4 *.mkv *.webm *.avi *.flv *.mov *.vob *.ogv);;All Files (*.*)";
+    const QString SubtitleFileSelector = FormatRegistry::Instance().FileFilter();
+    const QStringList MediaSuffixes = { "mp4", "mkv", "webm", "avi", "flv", "mov", "vob", "ogv" };
+    const QString MediaFileSelector = "Media Files (*." + MediaSuffixes.join(" *.") + ");;All Files (*.*)";
     bool hasFileOpen = false;
     bool isSaved = false;
 
-    QList<SubtitleItem> Subtitles;
+    SubtitleStore Subtitles;
     int PrevEditinSubtitleIndex = -1;
     int EditingSubtitleIndex = -1;
     bool isSubApplied = true;
 
-    QList<UndoItem> UndoItems;
-    QList<UndoItem> RedoItems;
-
-    QStandardItemModel *subtitlesModel;
+    UndoStack History;
+    // Memory the undo history may take, its oldest steps go beyond that.
+    // Bulk retimes of big files keep every time they changed.
+    const qint64 HistoryMemoryBudget = 128 * 1024 * 1024;
+    // Largest shift the Shift Times dialog takes, a day either way
+    const int MaxRetimeOffset = 24 * 60 * 60 * 1000;
+    // The time edits hold a QTime, which can't go past a day
+    const qint64 MaxEditTime = 24 * 60 * 60 * 1000 - 1;
+
+    SubtitleTableModel *subtitlesModel;
+    SubtitleTimeline Timeline;
+    // Switches the cues on screen, see CueScheduler
+    CueScheduler *cues;
+    SubtitleSearch Search;
+    SubtitleLinter Linter;
+    QLabel *problemsLabel;
+    QTimer *problemsTimer;
+    SearchPanel *searchPanel;
+
+    QThread *loaderThread;
+    SubtitleLoader *subtitleLoader = nullptr;
+    // Told apart by this rather than by sender, see SubtitleLoader
+    int subtitleLoadId = 0;
+    QProgressBar *loadProgressBar;
+    QToolButton *loadCancelButton;
+    bool isLoading = false;
+
+    // Every change is journaled on this thread, see AutosaveJournal. All
+    // three stay null when no journal could be locked.
+    QThread *journalThread = nullptr;
+    AutosaveJournal *journal = nullptr;
+    QLockFile *journalLock = nullptr;
+    // Journal names tried before autosave is turned off
+    const int JournalAttempts = 5;
+    bool isJournalCompacting = false;
+
+    // The media's audio is decoded to peaks on this thread
+    QThread *waveformThread;
+    WaveformLoader *waveformLoader = nullptr;
+    int waveformLoadId = 0;
+    WaveformWidget *waveform;
+
+    // Detected from the media unless picked from the Frame Rate menu, frame
+    // steps and snapping go by it
+    FrameRate VideoFrameRate = FrameRate(24000, 1001);
+    FrameRate DetectedFrameRate;
+    int FrameStepSize = 10;
+    QActionGroup *frameRateGroup;
+    QLabel *frameLabel;
+
+    // Shot changes of the media are found in the background, see ShotAnalyzer
+    ShotAnalyzer *shotAnalyzer = nullptr;
+    QLabel *shotsLabel;
+    // How far a cue's times are moved to a shot change at most
+    const qint64 ShotSnapDistance = 500;
 
     QGraphicsVideoItem *videoItem;
-    QGraphicsTextItem *subTextItem;
+    // The cue on screen is a pixmap from the overlay cache, see OverlayCache
+    QGraphicsPixmapItem *subOverlayItem;
+    QString subOverlayHtml;
+    OverlayCache *overlays;
+    // Upcoming cues rendered ahead of playback
+    const int WarmedOverlays = 5;
+    int WarmedSubtitleIndex = -1;
     qreal subTextScaleFactor = 1.0;
+
+    // Read only tracks shown along with the edited one, each with its
+    // overlay stacked above the edited track's
+    QList<ReferenceTrack *> ReferenceTracks;
+    QList<QGraphicsPixmapItem *> referenceOverlayItems;
+    QStringList referenceOverlayHtml;
+    const QString ReferenceOverlayColor = "#f0e68c";
+    TracksPanel *tracksPanel;
     QGraphicsScene *scene;
     QMediaPlayer *player;
 
     void SetupButtonIcons();
     void SetupVideoWidget();
     void SetupSubtitlesTable();
+    void SetupLoader();
+    void SetupSearchPanel();
+    void SetupJournal();
+    void SetupWaveform();
+    void SetupFrameStepping();
+    void SetupTracks();
+    void SetupShotDetection();
     void ConnectEvents();
 
     void UpdateUI();
     void UpdateSubPosition();
 
-    QTime MsToTime(int ms);
+    QTime MsToTime(qint64 ms);
 
     bool CheckIfSaved();
+    bool WriteSubtitleFile(const QString &Path);
     void SetIsSaved(bool value);
 
     void ShowAvailableSub();
+    void SeekTo(qint64 position);
+
+    // Markup for bold/italic/... in the open file's format
+    void SubTextTags(const QString &tag, QString &open, QString &close);
+
+    void CancelLoading();
+    void SetLoading(bool value);
+
+    void UpdateFrameRateMenu();
+    void UpdateFrameLabel();
+    // Moves the playhead to frames from the frame showing now
+    void SeekFrames(qint64 frames);
+    // Retimes rows [first, first + showTimes.size()) as one undo step
+    void ApplyTimes(int first, const QVector<qint64> &showTimes, const QVector<qint64> &hideTimes, const QString &text);
+    // Rows the retiming actions apply to, the selected ones when there are
+    // a few or else all of them. False, with a warning, if the selection
+    // isn't one block of rows.
+    bool RetimeRange(int &first, int &count);
+    // Adds which rows are retimed and the buttons to a retiming dialog and
+    // runs it, false if cancelled
+    bool ExecRetimeDialog(QDialog &dialog, QFormLayout *layout, int first, int count);
+    // Retimes rows [first, first + count) as one undo step, keeping them
+    // in order with the rows around them
+    void Retime(const Retiming &retiming, int first, int count, const QString &text);
+
+    void LoadWaveform(const QString &mediaPath);
+    void CancelWaveform();
+    void StartShotDetection(qint64 duration);
+    void CancelShotDetection();
+
+    // Start the journal over from the document as it is on disk, or from a
+    // snapshot when the cues no longer match what the file would load as
+    void StartJournal();
+    void CompactJournal();
+    void RemoveJournal();
+
+    QString JournalDirectory() const;
+    bool RecoverJournal(const AutosaveJournal::Base &base, const QList<QByteArray> &changes);
 
 private slots:
     // File Menu
     void NewAction();
     void OpenAction();
+    void OpenReferenceAction();
+    void CloseReferencesAction();
     void SaveAction();
     void SaveAsAction();
     void CloseAction();
@@ -100,6 +253,14 @@ private slots:
     // Edit Menu
     void UndoAction();
     void RedoAction();
+    void FindAction();
+    void ReplaceAllAction();
+    void SnapAllToFramesAction();
+    void SnapToShotsAction();
+    void ConvertFrameRateAction();
+    void ShiftTimesAction();
+    void StretchTimesAction();
+    void SyncTimesAction();
 
     // Media Menu
     void OpenMediaAction();
@@ -114,12 +275,26 @@ private slots:
     void VideoSeekableChanged(bool value);
     void VideoDurationChanged(qint64 value);
     void VideoPositionChanged(qint64 value);
+    void VideoStateChanged(QMediaPlayer::State state);
+    void VideoMetaDataChanged();
 
     void TimelineSliderChanged(int value);
+    void WaveformSeekRequested(qint64 position);
+    void WaveformLoadProgress(int loadId, int percent);
+    void WaveformLoadFinished(int loadId, bool success);
+    void ShotDetectionProgress(int percent);
+    void ShotCutsChanged();
+    void ShotDetectionFinished(bool success);
     void TogglePlayVideo();
     void StopVideo();
     void SeekForwards();
     void SeekBackwards();
+    void PreviousFrame();
+    void NextFrame();
+    void StepFramesBackward();
+    void StepFramesForward();
+    void FrameStepSizeAction();
+    void FrameRateSelected(QAction *action);
     void VolumeUp();
     void VolumeDown();
     void ToggleMuteAudio();
@@ -127,9 +302,41 @@ private slots:
 
     // Subtitle Group
     void OpenSubtitleFile(const QString &Path);
-
-    void DisplaySubtitle(const SubtitleItem &subItem);
+    void OpenProjectFile(const QString &Path);
+
+    void SubtitleStylesLoaded(int loadId, const SubtitleStyleTable &styles);
+    void SubtitleBatchLoaded(int loadId, const QList<SubtitleItem> &batch);
+    void SubtitleLoadProgress(int loadId, int percent);
+    void SubtitleLoadFinished(int loadId, bool success);
+    void CancelSubtitleLoading();
+
+    void SubtitlesChanged();
+    void ActiveSubsChanged();
+
+    void OpenReferenceTrack(const QString &Path);
+    void ReferenceTrackLoaded(bool success);
+    void UpdateTracks();
+    void TrackRowActivated(qint64 time, int row);
+    void SubtitlesReset();
+    void SubtitlesReordered();
+    void SubtitleRowsInserted(const QModelIndex &parent, int first, int last);
+    void SubtitleRowsAboutToBeRemoved(const QModelIndex &parent, int first, int last);
+    void SubtitleRowsRemoved(const QModelIndex &parent, int first, int last);
+    void SubtitleRowsMoved(const QModelIndex &parent, int start, int end, const QModelIndex &destination, int row);
+    void SubtitleDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight);
+    void UpdateProblems();
+
+    void JournalSizeChanged(qint64 bytes);
+    void CheckForRecovery();
+
+    void DisplaySubtitle(const QVector<int> &rows);
+    QString OverlayHtml(const SubtitleStore &subtitles, const QVector<int> &rows) const;
+    void ShowOverlay(const QString &html);
+    void ShowReferenceOverlay(int track, const QString &html);
+    void WarmOverlays(qint64 position);
     void ClearSubtitle();
+    // Puts a new cue's times at position, for when no cue is showing
+    void FollowPlayhead(qint64 position);
 
     void SelectSubFromTable(int row);
 
@@ -0,0 +1,47 @@
+#include "markedslider.h"
+
+#include <QPainter>
+#include <QStyleOptionSlider>
+
+MarkedSlider::MarkedSlider(QWidget *parent) : QSlider(parent) {}
+
+void MarkedSlider::setMarkers(const QVector<qint64> &markers) {
+    Markers = markers;
+    update();
+}
+
+void MarkedSlider::paintEvent(QPaintEvent *e) {
+    QSlider::paintEvent(e);
+
+    if (Markers.isEmpty() || maximum() <= minimum() || orientation() != Qt::Horizontal)
+        return;
+
+    QStyleOptionSlider Option;
+    initStyleOption(&Option);
+
+    QRect Groove = style()->subControlRect(QStyle::CC_Slider, &Option, QStyle::SC_SliderGroove, this);
+    QRect Handle = style()->subControlRect(QStyle::CC_Slider, &Option, QStyle::SC_SliderHandle, this);
+
+    // Values map to where the middle of the handle would be
+    int Span = Groove.width() - Handle.width();
+    int Left = Groove.left() + Handle.width() / 2;
+
+    QPainter painter(this);
+    QColor Color = palette().color(QPalette::Highlight);
+    Color.setAlpha(160);
+    painter.setPen(Color);
+
+    // Markers closer than a pixel apart are drawn once
+    int LastX = -1;
+    for (qint64 marker : qAsConst(Markers)) {
+        if (marker < minimum() || marker > maximum())
+            continue;
+
+        int x = Left + QStyle::sliderPositionFromValue(minimum(), maximum(), int(marker), Span, Option.upsideDown);
+        if (x == LastX)
+            continue;
+
+        painter.drawLine(x, Groove.top() - 2, x, Groove.bottom() + 2);
+        LastX = x;
+    }
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <QSlider>
+#include <QVector>
+
+// Slider with markers drawn across its groove at given values, e.g. the
+// shot changes of the media on the timeline
+class MarkedSlider : public QSlider {
+    Q_OBJECT
+
+public:
+    MarkedSlider(QWidget *parent = nullptr);
+
+    // Sorted
+    void setMarkers(const QVector<qint64> &markers);
+
+protected:
+    void paintEvent(QPaintEvent *e);
+
+private:
+    QVector<qint64> Markers;
+};
@@ -0,0 +1,137 @@
+#include "overlaycache.h"
+
+#include <QAbstractTextDocumentLayout>
+#include <QFontDatabase>
+#include <QPainter>
+#include <QTextDocument>
+#include <QtMath>
+
+namespace {
+
+// What QGraphicsDropShadowEffect used to draw, its one pixel of blur
+// doesn't show at subtitle sizes
+const QColor ShadowColor(63, 63, 63, 180);
+const qreal ShadowOffset = 1.0;
+
+}
+
+QImage OverlayRenderer::Render(const QString &html, const QFont &font, qreal scale) {
+    QTextDocument Document;
+    Document.setDefaultFont(font);
+    Document.setHtml(html);
+
+    QSizeF Size = Document.size() * scale;
+    QImage Text(qCeil(Size.width()), qCeil(Size.height()), QImage::Format_ARGB32_Premultiplied);
+    Text.fill(Qt::transparent);
+
+    {
+        QPainter painter(&Text);
+        painter.setRenderHint(QPainter::TextAntialiasing);
+        painter.scale(scale, scale);
+
+        // Text without a colour of its own is white, like the text item had it
+        QAbstractTextDocumentLayout::PaintContext Context;
+        Context.palette.setColor(QPalette::Text, Qt::white);
+        Document.documentLayout()->draw(&painter, Context);
+    }
+
+    // The shadow is the text's own shape in the shadow colour
+    QImage Shadow = Text;
+    {
+        QPainter painter(&Shadow);
+        painter.setCompositionMode(QPainter::CompositionMode_SourceIn);
+        painter.fillRect(Shadow.rect(), ShadowColor);
+    }
+
+    int Offset = qMax(1, qRound(ShadowOffset * scale));
+
+    QImage Result(Text.width() + Offset, Text.height() + Offset, QImage::Format_ARGB32_Premultiplied);
+    Result.fill(Qt::transparent);
+
+    QPainter painter(&Result);
+    painter.drawImage(Offset, Offset, Shadow);
+    painter.drawImage(0, 0, Text);
+
+    return Result;
+}
+
+void OverlayRenderer::RenderQueued(const QString &html, const QFont &font, qreal scale) {
+    emit Rendered(html, scale, Render(html, font, scale));
+}
+
+OverlayCache::OverlayCache(const QFont &font, QObject *parent) : QObject(parent), Font(font), Pixmaps(MemoryBudget) {
+    RenderThread = new QThread(this);
+    Renderer = new OverlayRenderer();
+    Renderer->moveToThread(RenderThread);
+
+    connect(RenderThread, SIGNAL(finished()), Renderer, SLOT(deleteLater()));
+    connect(Renderer, SIGNAL(Rendered(QString,qreal,QImage)), this, SLOT(Rendered(QString,qreal,QImage)));
+
+    RenderThread->start();
+}
+
+OverlayCache::~OverlayCache() {
+    RenderThread->quit();
+    RenderThread->wait();
+}
+
+void OverlayCache::setScale(qreal scale, qreal devicePixelRatio) {
+    if (qFuzzyCompare(scale, Scale) && qFuzzyCompare(devicePixelRatio, DevicePixelRatio))
+        return;
+
+    Scale = scale;
+    DevicePixelRatio = devicePixelRatio;
+    Clear();
+}
+
+void OverlayCache::Clear() {
+    // Renders still queued come back at the old scale and get dropped
+    Pixmaps.clear();
+    Pending.clear();
+}
+
+QPixmap OverlayCache::Get(const QString &html) {
+    if (html.isEmpty())
+        return QPixmap();
+
+    if (QPixmap *Cached = Pixmaps.object(html))
+        return *Cached;
+
+    return Insert(html, OverlayRenderer::Render(html, Font, getRenderScale()));
+}
+
+void OverlayCache::Warm(const QString &html) {
+    if (html.isEmpty() || Pixmaps.contains(html) || Pending.contains(html))
+        return;
+
+    // Left to Get on the GUI thread then
+    if (!QFontDatabase::supportsThreadedFontRendering())
+        return;
+
+    Pending.insert(html);
+    QMetaObject::invokeMethod(Renderer, "RenderQueued", Qt::QueuedConnection, Q_ARG(QString, html), Q_ARG(QFont, Font), Q_ARG(qreal, getRenderScale()));
+}
+
+void OverlayCache::Rendered(const QString &html, qreal scale, const QImage &image) {
+    // Left from before a change of scale, the same html may be pending
+    // again at the new one
+    if (!qFuzzyCompare(scale, getRenderScale()))
+        return;
+
+    if (!Pending.remove(html))
+        return;
+
+    Insert(html, image);
+}
+
+QPixmap OverlayCache::Insert(const QString &html, const QImage &image) {
+    QPixmap Pixmap = QPixmap::fromImage(image);
+    Pixmap.setDevicePixelRatio(DevicePixelRatio);
+
+    // Costs are bytes. One bigger than the whole budget would be refused,
+    // it's capped so it pushes out everything else instead.
+    int Cost = int(qBound<qint64>(1, qint64(image.width()) * image.height() * 4, MemoryBudget));
+    Pixmaps.insert(html, new QPixmap(Pixmap), Cost);
+
+    return Pixmap;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <QCache>
+#include <QFont>
+#include <QImage>
+#include <QObject>
+#include <QPixmap>
+#include <QSet>
+#include <QThread>
+
+// Draws overlay HTML into an image, white text with its drop shadow baked
+// in. Only QImage and QTextDocument are involved, so it works on any thread
+// where the platform renders fonts off the GUI thread.
+class OverlayRenderer : public QObject {
+    Q_OBJECT
+
+public:
+    static QImage Render(const QString &html, const QFont &font, qreal scale);
+
+public slots:
+    void RenderQueued(const QString &html, const QFont &font, qreal scale);
+
+signals:
+    void Rendered(const QString &html, qreal scale, const QImage &image);
+};
+
+// Pre-rendered subtitle overlays for the video scene, keyed by their HTML
+// and drawn at the view's scale, so showing a cue is a pixmap swap rather
+// than an HTML parse, a layout and a shadow pass. An edited cue has other
+// HTML and simply misses, what it used to look like ages out of the cache.
+// A change of scale drops everything.
+//
+// Cues about to show can be warmed on the cache's own thread, and ones
+// that weren't are rendered on the spot when asked for.
+class OverlayCache : public QObject {
+    Q_OBJECT
+
+public:
+    // Bytes of pixmaps kept at most
+    static const int MemoryBudget = 64 * 1024 * 1024;
+
+    OverlayCache(const QFont &font, QObject *parent = nullptr);
+    ~OverlayCache();
+
+    qreal getScale() const { return Scale; }
+    void setScale(qreal scale, qreal devicePixelRatio = 1.0);
+    void Clear();
+
+    // Null for empty html
+    QPixmap Get(const QString &html);
+    // Renders html in the background unless it's cached or on its way
+    void Warm(const QString &html);
+
+private slots:
+    void Rendered(const QString &html, qreal scale, const QImage &image);
+
+private:
+    QFont Font;
+    qreal Scale = 1.0;
+    qreal DevicePixelRatio = 1.0;
+
+    QCache<QString, QPixmap> Pixmaps;
+    QSet<QString> Pending;
+
+    QThread *RenderThread;
+    OverlayRenderer *Renderer;
+
+    qreal getRenderScale() const { return Scale * DevicePixelRatio; }
+    QPixmap Insert(const QString &html, const QImage &image);
+};
@@ -0,0 +1,321 @@
+#include "projectfile.h"
+
+#include <climits>
+#include <cstring>
+
+#include <QDataStream>
+#include <QElapsedTimer>
+#include <QSaveFile>
+
+namespace {
+
+const char Magic[8] = { 'S', 'U', 'B', 'S', 'H', 'O', 'P', '\0' };
+const quint32 FormatVersion = 1;
+// Reads back as 0x04030201 on a machine of the other byte order
+const quint32 ByteOrderMark = 0x01020304;
+
+enum Section {
+    IdsSection,
+    ShowTimesSection,
+    HideTimesSection,
+    StylesSection,
+    TextOffsetsSection,
+    TextLengthsSection,
+    TextSection,
+    // Media path, encoding and style table
+    DocumentSection,
+    HistorySection,
+    SectionCount
+};
+
+struct SectionEntry {
+    quint64 Offset;
+    quint64 Size;
+};
+
+struct Header {
+    char Magic[8];
+    quint32 Version;
+    quint32 ByteOrder;
+    quint32 CueCount;
+    // In UTF-16 units
+    quint32 TextLength;
+    SectionEntry Sections[SectionCount];
+};
+
+// Sections start 8 byte aligned so the mapped arrays can be read in place
+inline quint64 Aligned(quint64 offset) {
+    return (offset + 7) & ~quint64(7);
+}
+
+QByteArray WriteDocument(const SubtitleStore &store, const QString &mediaPath) {
+    const SubtitleStyleTable &Styles = store.getStyles();
+
+    QByteArray Data;
+    QDataStream out(&Data, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_12);
+
+    out << mediaPath;
+    out << store.getEncoding().getName() << store.getEncoding().hasBom();
+
+    out << Styles.getHeader() << Styles.getEventFormat() << Styles.getFooter();
+
+    out << qint32(Styles.styleCount());
+    for (int i = 0; i < Styles.styleCount(); i++) {
+        const SubtitleStyleTable::Style &style = Styles.getStyle(i);
+        out << style.Name << style.Bold << style.Italic << style.Underline << style.StrikeOut;
+    }
+
+    out << qint32(Styles.size());
+    for (int i = 0; i < Styles.size(); i++) {
+        const SubtitleStyleTable::EventStyle &event = Styles.at(i);
+        out << event.Type << event.Leading << event.Trailing;
+    }
+
+    return Data;
+}
+
+bool ReadDocument(const QByteArray &data, QString &mediaPath, TextEncoding &encoding, SubtitleStyleTable &styles) {
+    QDataStream in(data);
+    in.setVersion(QDataStream::Qt_5_12);
+
+    QByteArray encodingName;
+    bool bom;
+    in >> mediaPath >> encodingName >> bom;
+
+    QString header, eventFormat, footer;
+    in >> header >> eventFormat >> footer;
+
+    styles.clear();
+    styles.setHeader(header);
+    styles.setEventFormat(eventFormat);
+    styles.setFooter(footer);
+
+    qint32 styleCount;
+    in >> styleCount;
+    for (int i = 0; i < styleCount && in.status() == QDataStream::Ok; i++) {
+        SubtitleStyleTable::Style style;
+        in >> style.Name >> style.Bold >> style.Italic >> style.Underline >> style.StrikeOut;
+        styles.addStyle(style);
+    }
+
+    // Distinct entries, so interning them in order gives back the same indices
+    qint32 eventCount;
+    in >> eventCount;
+    for (int i = 0; i < eventCount && in.status() == QDataStream::Ok; i++) {
+        SubtitleStyleTable::EventStyle event;
+        in >> event.Type >> event.Leading >> event.Trailing;
+        styles.intern(event);
+    }
+
+    if (in.status() != QDataStream::Ok)
+        return false;
+
+    encoding = encodingName.isEmpty() ? TextEncoding() : TextEncoding(encodingName, bom);
+    return true;
+}
+
+}
+
+const QString ProjectFile::Suffix = "subshop";
+
+bool ProjectFile::IsProject(const QByteArray &head) {
+    return head.size() >= int(sizeof(Magic)) && std::memcmp(head.constData(), Magic, sizeof(Magic)) == 0;
+}
+
+bool ProjectFile::Read(const QString &filepath, SubtitleStore &store, Extras *extras) {
+    store.clear();
+
+    QSharedPointer<QFile> File(new QFile(filepath));
+    if (!File->open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    qint64 Size = File->size();
+    if (Size < qint64(sizeof(Header))) {
+        return false;
+    }
+
+    // The file stays open as long as the store borrows from the mapping.
+    // Devices that can't be mapped get read and the text copied.
+    QByteArray Data;
+    const char *data = reinterpret_cast<const char *>(File->map(0, Size));
+    if (!data) {
+        Data = File->readAll();
+        data = Data.constData();
+        File.reset();
+    }
+
+    Header header;
+    std::memcpy(&header, data, sizeof(Header));
+
+    if (std::memcmp(header.Magic, Magic, sizeof(Magic)) != 0 || header.Version != FormatVersion || header.ByteOrder != ByteOrderMark) {
+        return false;
+    }
+
+    quint64 Count = header.CueCount;
+    if (Count > INT_MAX || header.TextLength > INT_MAX || header.Sections[DocumentSection].Size > INT_MAX || header.Sections[HistorySection].Size > INT_MAX) {
+        return false;
+    }
+
+    const quint64 ExpectedSizes[SectionCount] = {
+        Count * sizeof(quint64), Count * sizeof(qint64), Count * sizeof(qint64), Count * sizeof(qint32),
+        Count * sizeof(qint32), Count * sizeof(qint32), quint64(header.TextLength) * sizeof(QChar), 0, 0
+    };
+
+    for (int i = 0; i < SectionCount; i++) {
+        const SectionEntry &section = header.Sections[i];
+        if (section.Offset % 8 != 0 || section.Offset > quint64(Size) || section.Size > quint64(Size) - section.Offset)
+            return false;
+
+        if (i < DocumentSection && section.Size != ExpectedSizes[i])
+            return false;
+    }
+
+    auto At = [&](Section section) {
+        return data + header.Sections[section].Offset;
+    };
+
+    const qint32 *TextOffsets = reinterpret_cast<const qint32 *>(At(TextOffsetsSection));
+    const qint32 *TextLengths = reinterpret_cast<const qint32 *>(At(TextLengthsSection));
+
+    // A broken offset would have the store read outside the text
+    for (quint64 i = 0; i < Count; i++) {
+        if (TextOffsets[i] < 0 || TextLengths[i] < 0 || qint64(TextOffsets[i]) + TextLengths[i] > qint64(header.TextLength))
+            return false;
+    }
+
+    QString MediaPath;
+    TextEncoding Encoding;
+    SubtitleStyleTable Styles;
+    if (!ReadDocument(QByteArray::fromRawData(At(DocumentSection), int(header.Sections[DocumentSection].Size)), MediaPath, Encoding, Styles)) {
+        return false;
+    }
+
+    store.assign(int(Count),
+                 reinterpret_cast<const quint64 *>(At(IdsSection)),
+                 reinterpret_cast<const qint64 *>(At(ShowTimesSection)),
+                 reinterpret_cast<const qint64 *>(At(HideTimesSection)),
+                 reinterpret_cast<const qint32 *>(At(StylesSection)),
+                 TextOffsets, TextLengths,
+                 reinterpret_cast<const QChar *>(At(TextSection)), int(header.TextLength),
+                 File);
+
+    store.setStyles(Styles);
+    store.setEncoding(Encoding);
+
+    if (extras) {
+        extras->MediaPath = MediaPath;
+        extras->History = QByteArray(At(HistorySection), int(header.Sections[HistorySection].Size));
+    }
+
+    return true;
+}
+
+bool ProjectFile::Write(const SubtitleStore &store, const QString &filepath, const Extras &extras, SubParser::ExportStats *stats) {
+    QElapsedTimer Timer;
+    Timer.start();
+
+    int Count = store.size();
+
+    // Text goes out packed, without what edits left behind in the store
+    QVector<qint32> TextOffsets(Count);
+    QVector<qint32> TextLengths(Count);
+    qint64 TextLength = 0;
+    for (int i = 0; i < Count; i++) {
+        TextOffsets[i] = qint32(TextLength);
+        TextLengths[i] = store.getSubtitleLength(i);
+        TextLength += TextLengths.at(i);
+    }
+
+    if (TextLength > INT_MAX) {
+        return false;
+    }
+
+    QByteArray Document = WriteDocument(store, extras.MediaPath);
+
+    Header header;
+    std::memset(&header, 0, sizeof(Header));
+    std::memcpy(header.Magic, Magic, sizeof(Magic));
+    header.Version = FormatVersion;
+    header.ByteOrder = ByteOrderMark;
+    header.CueCount = quint32(Count);
+    header.TextLength = quint32(TextLength);
+
+    const quint64 Sizes[SectionCount] = {
+        quint64(Count) * sizeof(quint64), quint64(Count) * sizeof(qint64), quint64(Count) * sizeof(qint64), quint64(Count) * sizeof(qint32),
+        quint64(Count) * sizeof(qint32), quint64(Count) * sizeof(qint32), quint64(TextLength) * sizeof(QChar),
+        quint64(Document.size()), quint64(extras.History.size())
+    };
+
+    quint64 Offset = Aligned(sizeof(Header));
+    for (int i = 0; i < SectionCount; i++) {
+        header.Sections[i].Offset = Offset;
+        header.Sections[i].Size = Sizes[i];
+        Offset = Aligned(Offset + Sizes[i]);
+    }
+
+    QSaveFile File(filepath);
+    if (!File.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    qint64 Written = 0;
+    bool Failed = false;
+
+    auto Write = [&](const void *data, qint64 size) {
+        if (size > 0 && File.write(static_cast<const char *>(data), size) != size) {
+            Failed = true;
+        }
+        Written += size;
+    };
+
+    auto Pad = [&]() {
+        static const char Zeros[8] = {};
+        Write(Zeros, qint64(Aligned(Written)) - Written);
+    };
+
+    Write(&header, sizeof(Header));
+    Pad();
+    Write(store.getIds().constData(), Sizes[IdsSection]);
+    Pad();
+    Write(store.getShowTimes().constData(), Sizes[ShowTimesSection]);
+    Pad();
+    Write(store.getHideTimes().constData(), Sizes[HideTimesSection]);
+    Pad();
+    Write(store.getStyleIndices().constData(), Sizes[StylesSection]);
+    Pad();
+    Write(TextOffsets.constData(), Sizes[TextOffsetsSection]);
+    Pad();
+    Write(TextLengths.constData(), Sizes[TextLengthsSection]);
+    Pad();
+
+    // Gathered into large blocks, one write per cue would cost more than the copy
+    QByteArray Buffer;
+    Buffer.reserve(1 << 20);
+    for (int i = 0; i < Count; i++) {
+        Buffer.append(reinterpret_cast<const char *>(store.getSubtitleData(i)), store.getSubtitleLength(i) * int(sizeof(QChar)));
+        if (Buffer.size() >= (1 << 20)) {
+            Write(Buffer.constData(), Buffer.size());
+            Buffer.clear();
+        }
+    }
+    Write(Buffer.constData(), Buffer.size());
+    Pad();
+
+    Write(Document.constData(), Document.size());
+    Pad();
+    Write(extras.History.constData(), extras.History.size());
+
+    if (Failed || !File.commit()) {
+        return false;
+    }
+
+    if (stats) {
+        stats->Cues = Count;
+        stats->Bytes = Written;
+        stats->Nanoseconds = Timer.nsecsElapsed();
+    }
+
+    return true;
+}
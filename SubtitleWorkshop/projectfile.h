@@ -0,0 +1,40 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+
+#include "subparser.h"
+#include "subtitlestore.h"
+
+// Subshop project files (.subshop). They hold a document the way the
+// store keeps it in memory: a header with the offset of every section,
+// the cue columns as plain arrays, the text of all cues as one UTF-16
+// blob, then the media path, styles, encoding and undo history.
+//
+// Reading maps the file and hands the columns to the store. Nothing gets
+// parsed: the time, id and style columns are block copies, every text
+// offset is checked once, and the text itself is borrowed straight from the
+// mapping. Opening is still linear in the number of cues, but only by a
+// few passes over flat arrays. Files are written in the machine's byte
+// order and refused by one with the other order.
+class ProjectFile {
+public:
+    static const QString Suffix;
+
+    // Whatever a project keeps besides the cues
+    struct Extras {
+        QString MediaPath;
+        // Opaque to the file, see UndoStack::Save
+        QByteArray History;
+    };
+
+    // Whether the file starts like a project file
+    static bool IsProject(const QByteArray &head);
+
+    // Returns false if the file couldn't be read or isn't a valid project,
+    // store is left empty then
+    static bool Read(const QString &filepath, SubtitleStore &store, Extras *extras = nullptr);
+
+    // Writes through a temporary file like SubParser::Export
+    static bool Write(const SubtitleStore &store, const QString &filepath, const Extras &extras = Extras(), SubParser::ExportStats *stats = nullptr);
+};
@@ -0,0 +1,92 @@
+#include "referencetrack.h"
+
+#include <QFileInfo>
+
+#include "projectfile.h"
+
+ReferenceTrack::ReferenceTrack(const QString &filepath, QObject *parent) : QObject(parent), FilePath(filepath), Timeline(&Subtitles) {}
+
+ReferenceTrack::~ReferenceTrack() {
+    Cancel();
+}
+
+bool ReferenceTrack::Load(QThread *thread) {
+    const SubtitleFormat *Format = FormatRegistry::Instance().Detect(FilePath);
+    if (!Format)
+        return false;
+
+    Cancel();
+    LoadId++;
+    Subtitles.clear();
+    Timeline.Invalidate();
+    Loaded = false;
+
+    // Projects are mapped rather than parsed, no loader needed
+    if (Format == FormatRegistry::Instance().ForSuffix(ProjectFile::Suffix)) {
+        bool success = ProjectFile::Read(FilePath, Subtitles);
+        Timeline.Invalidate();
+
+        // Loaded only once it's reported, like a file read by the loader
+        QMetaObject::invokeMethod(this, "ProjectRead", Qt::QueuedConnection, Q_ARG(int, LoadId), Q_ARG(bool, success));
+        return true;
+    }
+
+    Loader = new SubtitleLoader(FilePath, Format, LoadId);
+    Loader->moveToThread(thread);
+
+    connect(Loader, SIGNAL(BatchLoaded(int,QList<SubtitleItem>)), this, SLOT(LoaderBatchLoaded(int,QList<SubtitleItem>)));
+    connect(Loader, SIGNAL(Finished(int,bool)), this, SLOT(LoaderFinished(int,bool)));
+
+    QMetaObject::invokeMethod(Loader, "Run", Qt::QueuedConnection);
+    return true;
+}
+
+void ReferenceTrack::Cancel() {
+    if (Loader == nullptr)
+        return;
+
+    // The loader deletes itself once its thread gets back to the event loop
+    Loader->Cancel();
+    Loader->deleteLater();
+    Loader = nullptr;
+}
+
+QString ReferenceTrack::getName() const {
+    return QFileInfo(FilePath).fileName();
+}
+
+void ReferenceTrack::LoaderBatchLoaded(int loadId, const QList<SubtitleItem> &batch) {
+    // Batches of a cancelled load can still be queued
+    if (Loader == nullptr || loadId != LoadId)
+        return;
+
+    Subtitles.append(batch);
+}
+
+void ReferenceTrack::ProjectRead(int loadId, bool success) {
+    // Read for a load that has been started over since
+    if (loadId != LoadId)
+        return;
+
+    Loaded = success;
+    emit LoadFinished(success);
+}
+
+void ReferenceTrack::LoaderFinished(int loadId, bool success) {
+    if (Loader == nullptr || loadId != LoadId)
+        return;
+
+    Subtitles.setStyles(Loader->getStyles());
+
+    Loader->deleteLater();
+    Loader = nullptr;
+
+    if (!Subtitles.isSorted()) {
+        Subtitles.sort();
+    }
+
+    Timeline.Invalidate();
+    Loaded = success;
+
+    emit LoadFinished(success);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <QObject>
+#include <QThread>
+
+#include "subtitleloader.h"
+#include "subtitlestore.h"
+#include "subtitletimeline.h"
+
+// A subtitle file opened next to the edited one to work against, e.g. the
+// original language while translating. It's only read, by a SubtitleLoader
+// like the edited file, and has its own store and cue index.
+class ReferenceTrack : public QObject {
+    Q_OBJECT
+
+public:
+    ReferenceTrack(const QString &filepath, QObject *parent = nullptr);
+    ~ReferenceTrack();
+
+    // Starts reading the file on thread. False if its format isn't known,
+    // LoadFinished is emitted otherwise, and isLoaded is only true from then.
+    bool Load(QThread *thread);
+    void Cancel();
+
+    QString getFilePath() const { return FilePath; }
+    QString getName() const;
+    bool isLoaded() const { return Loaded; }
+
+    const SubtitleStore &getSubtitles() const { return Subtitles; }
+    SubtitleTimeline *getTimeline() { return &Timeline; }
+
+signals:
+    void LoadFinished(bool success);
+
+private slots:
+    void LoaderBatchLoaded(int loadId, const QList<SubtitleItem> &batch);
+    void LoaderFinished(int loadId, bool success);
+    void ProjectRead(int loadId, bool success);
+
+private:
+    QString FilePath;
+    SubtitleStore Subtitles;
+    SubtitleTimeline Timeline;
+
+    SubtitleLoader *Loader = nullptr;
+    bool Loaded = false;
+    int LoadId = 0;
+};
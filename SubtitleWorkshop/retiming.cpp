@@ -0,0 +1,83 @@
+#include "retiming.h"
+
+#include <cmath>
+
+namespace {
+
+// To the nearest ms, halves up. std::floor is a library call on plain
+// x86-64, truncating and correcting below zero is a couple of instructions.
+inline qint64 Round(double time) {
+    double Half = time + 0.5;
+    qint64 Truncated = qint64(Half);
+    return Truncated - (double(Truncated) > Half);
+}
+
+}
+
+Retiming::Retiming(double ratio, double offset) : Ratio(ratio), Offset(offset) {}
+
+Retiming Retiming::Shift(qint64 offset) {
+    return Retiming(1.0, double(offset));
+}
+
+Retiming Retiming::Stretch(double ratio, qint64 anchor) {
+    return Retiming(ratio, double(anchor) - double(anchor) * ratio);
+}
+
+Retiming Retiming::Sync(qint64 from1, qint64 to1, qint64 from2, qint64 to2) {
+    if (from1 == from2 || to1 == to2)
+        return Retiming(0.0, 0.0);
+
+    double Ratio = double(to2 - to1) / double(from2 - from1);
+    return Retiming(Ratio, double(to1) - double(from1) * Ratio);
+}
+
+bool Retiming::isValid() const {
+    return Ratio > 0.0 && std::isfinite(Ratio) && std::isfinite(Offset);
+}
+
+bool Retiming::isShift() const {
+    return Ratio == 1.0 && Offset == std::floor(Offset) && std::abs(Offset) < 9.0e15;
+}
+
+Retiming Retiming::Then(const Retiming &next) const {
+    return Retiming(Ratio * next.Ratio, Offset * next.Ratio + next.Offset);
+}
+
+qint64 Retiming::Map(qint64 time) const {
+    return Round(double(time) * Ratio + Offset);
+}
+
+int Retiming::Apply(const qint64 *showTimes, const qint64 *hideTimes, qint64 *newShowTimes, qint64 *newHideTimes, int count,
+                    qint64 minShow, qint64 maxShow) const {
+    int Moved = 0;
+
+    // The common case, whole ms and no rounding at all
+    if (isShift()) {
+        qint64 Shift = getShift();
+
+        for (int i = 0; i < count; i++) {
+            qint64 Show = showTimes[i] + Shift;
+            qint64 Bounded = qMin(qMax(Show, minShow), maxShow);
+
+            newShowTimes[i] = Bounded;
+            newHideTimes[i] = hideTimes[i] + Shift + (Bounded - Show);
+            Moved += Bounded != Show;
+        }
+
+        return Moved;
+    }
+
+    // No branches, the bounds are a min and a max
+    for (int i = 0; i < count; i++) {
+        qint64 Show = Round(double(showTimes[i]) * Ratio + Offset);
+        qint64 Hide = Round(double(hideTimes[i]) * Ratio + Offset);
+        qint64 Bounded = qMin(qMax(Show, minShow), maxShow);
+
+        newShowTimes[i] = Bounded;
+        newHideTimes[i] = Hide + (Bounded - Show);
+        Moved += Bounded != Show;
+    }
+
+    return Moved;
+}
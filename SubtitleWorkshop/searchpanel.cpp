@@ -0,0 +1,149 @@
+#include "searchpanel.h"
+
+#include <QElapsedTimer>
+#include <QGridLayout>
+
+namespace {
+
+// Characters of context shown on either side of a hit
+const int ContextLength = 30;
+
+QString Preview(const QString &text, int position, int length) {
+    int From = qMax(0, position - ContextLength);
+    int To = qMin(text.size(), position + length + ContextLength);
+
+    QString Result = text.mid(From, To - From);
+    Result.replace('\n', " / ");
+
+    if (From > 0) Result.prepend("...");
+    if (To < text.size()) Result.append("...");
+
+    return Result;
+}
+
+}
+
+SearchPanel::SearchPanel(SubtitleSearch *search, const SubtitleStore *subtitles, QWidget *parent) : QDockWidget("Find and Replace", parent), Search(search), Subtitles(subtitles) {
+    setObjectName("SearchPanel");
+
+    QWidget *Contents = new QWidget(this);
+    QGridLayout *Layout = new QGridLayout(Contents);
+
+    FindEdit = new QLineEdit(Contents);
+    FindEdit->setPlaceholderText("Find");
+    FindEdit->setClearButtonEnabled(true);
+
+    ReplaceEdit = new QLineEdit(Contents);
+    ReplaceEdit->setPlaceholderText("Replace with");
+
+    TypeBox = new QComboBox(Contents);
+    TypeBox->addItem("Text", SubtitleSearch::Substring);
+    TypeBox->addItem("Whole words", SubtitleSearch::WholeWord);
+    TypeBox->addItem("Regular expression", SubtitleSearch::RegularExpression);
+
+    CaseBox = new QCheckBox("Match case", Contents);
+
+    ReplaceAllButton = new QPushButton("Replace All", Contents);
+
+    StatusLabel = new QLabel(Contents);
+
+    HitList = new QListWidget(Contents);
+    HitList->setUniformItemSizes(true);
+
+    Layout->addWidget(FindEdit, 0, 0, 1, 2);
+    Layout->addWidget(ReplaceEdit, 1, 0);
+    Layout->addWidget(ReplaceAllButton, 1, 1);
+    Layout->addWidget(TypeBox, 2, 0);
+    Layout->addWidget(CaseBox, 2, 1);
+    Layout->addWidget(StatusLabel, 3, 0, 1, 2);
+    Layout->addWidget(HitList, 4, 0, 1, 2);
+
+    setWidget(Contents);
+
+    RefreshTimer = new QTimer(this);
+    RefreshTimer->setSingleShot(true);
+    RefreshTimer->setInterval(200);
+
+    connect(RefreshTimer, SIGNAL(timeout()), this, SLOT(Refresh()));
+
+    // Lookups take well under a frame, the query is searched as it is typed
+    connect(FindEdit, SIGNAL(textChanged(QString)), this, SLOT(Refresh()));
+    connect(TypeBox, SIGNAL(currentIndexChanged(int)), this, SLOT(Refresh()));
+    connect(CaseBox, SIGNAL(toggled(bool)), this, SLOT(Refresh()));
+
+    connect(HitList, SIGNAL(itemActivated(QListWidgetItem*)), this, SLOT(HitItemActivated(QListWidgetItem*)));
+    connect(HitList, SIGNAL(itemClicked(QListWidgetItem*)), this, SLOT(HitItemActivated(QListWidgetItem*)));
+    connect(ReplaceAllButton, SIGNAL(clicked()), this, SIGNAL(ReplaceAllRequested()));
+}
+
+SubtitleSearch::Query SearchPanel::getQuery() const {
+    SubtitleSearch::Query Query;
+    Query.Text = FindEdit->text();
+    Query.Type = SubtitleSearch::MatchType(TypeBox->currentData().toInt());
+    Query.Case = CaseBox->isChecked() ? Qt::CaseSensitive : Qt::CaseInsensitive;
+    return Query;
+}
+
+void SearchPanel::Activate() {
+    show();
+    raise();
+    Refresh();
+
+    FindEdit->setFocus();
+    FindEdit->selectAll();
+}
+
+void SearchPanel::ScheduleRefresh() {
+    // Hidden panels search again once shown
+    if (isVisible()) {
+        RefreshTimer->start();
+    }
+}
+
+void SearchPanel::Refresh() {
+    RefreshTimer->stop();
+    HitList->clear();
+
+    SubtitleSearch::Query Query = getQuery();
+
+    QString Error;
+    if (!SubtitleSearch::isValid(Query, &Error)) {
+        StatusLabel->setText(Query.Text.isEmpty() ? QString() : Error);
+        ReplaceAllButton->setEnabled(false);
+        return;
+    }
+
+    QElapsedTimer Timer;
+    Timer.start();
+
+    // Only as many items as anyone would scroll through, and one more to
+    // tell whether there are others. A query like "." on a big file would
+    // otherwise collect millions of hits on every keystroke.
+    QVector<SubtitleSearch::Hit> Hits = Search->Find(Query, PreviewLimit + 1);
+
+    qint64 Nanoseconds = Timer.nsecsElapsed();
+
+    int Shown = qMin(Hits.size(), PreviewLimit);
+    for (int i = 0; i < Shown; i++) {
+        const SubtitleSearch::Hit &hit = Hits.at(i);
+
+        QString Text = Subtitles->getSubtitle(hit.Row);
+        // Multi-arg, a "%1" in the cue's text stays as it is
+        QListWidgetItem *Item = new QListWidgetItem(QString("%1  %2  %3").arg(QString::number(hit.Row + 1),
+                                                                              SubtitleItem::FormatTime(Subtitles->getShowTime(hit.Row)),
+                                                                              Preview(Text, hit.Position, hit.Length)), HitList);
+        Item->setData(Qt::UserRole, hit.Row);
+        Item->setToolTip(Text);
+    }
+
+    StatusLabel->setText(QString("%1 matches in %2 ms%3")
+                         .arg(Shown < Hits.size() ? QString("More than %1").arg(Shown) : QString::number(Hits.size()))
+                         .arg(Nanoseconds / 1e6, 0, 'f', 2)
+                         .arg(Shown < Hits.size() ? QString(", first %1 shown").arg(Shown) : QString()));
+
+    ReplaceAllButton->setEnabled(!Hits.isEmpty());
+}
+
+void SearchPanel::HitItemActivated(QListWidgetItem *item) {
+    emit HitActivated(item->data(Qt::UserRole).toInt());
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <QCheckBox>
+#include <QComboBox>
+#include <QDockWidget>
+#include <QLabel>
+#include <QLineEdit>
+#include <QListWidget>
+#include <QPushButton>
+#include <QTimer>
+
+#include "subtitlesearch.h"
+
+// Find/replace panel. Searches as the query is typed and lists the hits,
+// activating one jumps to its cue. Replacing is left to the window, which
+// records it in the history.
+class SearchPanel : public QDockWidget {
+    Q_OBJECT
+
+public:
+    // Hits looked for and listed at most, past that the count above the
+    // list only says there are more
+    static const int PreviewLimit = 1000;
+
+    SearchPanel(SubtitleSearch *search, const SubtitleStore *subtitles, QWidget *parent = nullptr);
+
+    SubtitleSearch::Query getQuery() const;
+    QString getReplacement() const { return ReplaceEdit->text(); }
+
+public slots:
+    // Shows the panel with the query selected
+    void Activate();
+    // Searches again shortly, e.g. after the cues changed
+    void ScheduleRefresh();
+    void Refresh();
+
+signals:
+    void HitActivated(int row);
+    void ReplaceAllRequested();
+
+private slots:
+    void HitItemActivated(QListWidgetItem *item);
+
+private:
+    SubtitleSearch *Search;
+    const SubtitleStore *Subtitles;
+
+    QLineEdit *FindEdit;
+    QLineEdit *ReplaceEdit;
+    QComboBox *TypeBox;
+    QCheckBox *CaseBox;
+    QPushButton *ReplaceAllButton;
+    QLabel *StatusLabel;
+    QListWidget *HitList;
+
+    // Bursts of changes, e.g. a file loading in batches, search only once
+    QTimer *RefreshTimer;
+};
@@ -0,0 +1,237 @@
+#include "shotanalyzer.h"
+
+#include <QThread>
+#include <QUrl>
+
+namespace {
+
+// The index isn't saved more often than this, in ms
+const qint64 SaveInterval = 2000;
+
+}
+
+ShotAnalyzer::ShotAnalyzer(const QString &mediaPath, QObject *parent) : QObject(parent), MediaPath(mediaPath) {
+    qRegisterMetaType<QVideoFrame>("QVideoFrame");
+    SaveTimer.start();
+}
+
+ShotAnalyzer::~ShotAnalyzer() {
+    QList<QThread *> Threads;
+    for (Job *job : qAsConst(Jobs)) {
+        Threads.append(job->Thread);
+    }
+
+    while (!Jobs.isEmpty()) {
+        EndJob(Jobs.first());
+    }
+
+    // Cancelled workers are at most a frame from done
+    for (QThread *thread : qAsConst(Threads)) {
+        thread->wait();
+    }
+
+    Save(true);
+}
+
+void ShotAnalyzer::Start(qint64 duration) {
+    Duration = duration;
+
+    // Resumed from whatever an earlier run got through
+    if (!Index.Read(MediaPath)) {
+        Index.Clear();
+    }
+
+    if (!Index.getCuts().isEmpty()) {
+        emit CutsChanged();
+    }
+
+    QVector<ShotIndex::Span> Missing = Index.Missing(Duration);
+
+    qint64 Left = 0;
+    for (const ShotIndex::Span &span : qAsConst(Missing)) {
+        Left += span.second - span.first;
+    }
+
+    // About even chunks, enough to keep every job busy
+    qint64 ChunkLength = qMax(MinChunkLength, Left / JobLimit());
+
+    for (const ShotIndex::Span &span : qAsConst(Missing)) {
+        qint64 Length = span.second - span.first;
+        qint64 Count = qMax<qint64>(1, (Length + ChunkLength - 1) / ChunkLength);
+
+        for (qint64 i = 0; i < Count; i++) {
+            Chunks.append(ShotIndex::Span(span.first + Length * i / Count, span.first + Length * (i + 1) / Count));
+        }
+    }
+
+    emit ProgressChanged(Index.getProgress(Duration));
+    StartJobs();
+}
+
+void ShotAnalyzer::FrameAnalysed(int jobId, qint64 time, bool isCut) {
+    Job *job = JobWithId(jobId);
+    if (job == nullptr)
+        return;
+
+    if (isCut && time >= job->From && time < job->To) {
+        job->Cuts.append(time);
+    }
+
+    if (time >= job->To) {
+        Commit(job, job->To);
+        EndJob(job);
+        StartJobs();
+    }
+    else if (time - job->From >= CommitInterval) {
+        Commit(job, time);
+    }
+}
+
+void ShotAnalyzer::PlayerStatusChanged(QMediaPlayer::MediaStatus status) {
+    Job *job = JobFor(sender());
+    if (job == nullptr)
+        return;
+
+    if (status == QMediaPlayer::EndOfMedia) {
+        // The media can be a little shorter than it said
+        Commit(job, job->To);
+        EndJob(job);
+        StartJobs();
+    }
+    else if (status == QMediaPlayer::InvalidMedia) {
+        PlayerError(QMediaPlayer::FormatError);
+    }
+}
+
+void ShotAnalyzer::PlayerError(QMediaPlayer::Error) {
+    if (isDone)
+        return;
+
+    while (!Jobs.isEmpty()) {
+        EndJob(Jobs.first());
+    }
+
+    Chunks.clear();
+    Save(true);
+
+    isDone = true;
+    emit Finished(false);
+}
+
+int ShotAnalyzer::JobLimit() {
+    // A player decodes on threads of its own and its worker takes another,
+    // one job per core keeps them all busy without crowding the GUI out
+    return qMax(1, QThread::idealThreadCount());
+}
+
+ShotAnalyzer::Job *ShotAnalyzer::JobFor(QObject *player) const {
+    // Players live on this thread, their signals come straight from them
+    for (Job *job : Jobs) {
+        if (job->Player == player)
+            return job;
+    }
+
+    return nullptr;
+}
+
+ShotAnalyzer::Job *ShotAnalyzer::JobWithId(int id) const {
+    for (Job *job : Jobs) {
+        if (job->Id == id)
+            return job;
+    }
+
+    return nullptr;
+}
+
+void ShotAnalyzer::StartJobs() {
+    if (isDone)
+        return;
+
+    while (Jobs.size() < JobLimit() && !Chunks.isEmpty()) {
+        ShotIndex::Span Chunk = Chunks.takeFirst();
+        qint64 Seek = qMax<qint64>(0, Chunk.first - LeadIn);
+
+        Job *job = new Job();
+        job->Id = NextJobId++;
+        job->From = Chunk.first;
+        job->To = Chunk.second;
+
+        job->Player = new QMediaPlayer(this, QMediaPlayer::VideoSurface);
+        job->Grabber = new FrameGrabber(job->Player);
+
+        // Both go once the thread has stopped, see EndJob
+        job->Thread = new QThread();
+        job->Worker = new ShotWorker(job->Id, Seek);
+        job->Worker->moveToThread(job->Thread);
+        connect(job->Thread, SIGNAL(finished()), job->Worker, SLOT(deleteLater()));
+        connect(job->Thread, SIGNAL(finished()), job->Thread, SLOT(deleteLater()));
+        job->Thread->start();
+
+        connect(job->Grabber, SIGNAL(FrameGrabbed(qint64,QVideoFrame)), job->Worker, SLOT(Process(qint64,QVideoFrame)));
+        connect(job->Worker, SIGNAL(FrameAnalysed(int,qint64,bool)), this, SLOT(FrameAnalysed(int,qint64,bool)));
+        connect(job->Player, SIGNAL(mediaStatusChanged(QMediaPlayer::MediaStatus)), this, SLOT(PlayerStatusChanged(QMediaPlayer::MediaStatus)));
+        connect(job->Player, SIGNAL(error(QMediaPlayer::Error)), this, SLOT(PlayerError(QMediaPlayer::Error)));
+
+        job->Player->setVideoOutput(job->Grabber);
+        job->Player->setMuted(true);
+        job->Player->setMedia(QUrl::fromLocalFile(MediaPath));
+        job->Player->setPosition(Seek);
+        job->Player->play();
+
+        Jobs.append(job);
+    }
+
+    if (Jobs.isEmpty()) {
+        Save(true);
+
+        isDone = true;
+        emit ProgressChanged(100);
+        emit Finished(true);
+    }
+}
+
+void ShotAnalyzer::Commit(Job *job, qint64 to) {
+    if (to <= job->From)
+        return;
+
+    bool hasCuts = !job->Cuts.isEmpty();
+
+    Index.Add(job->From, to, job->Cuts);
+    job->Cuts.clear();
+    job->From = to;
+
+    isDirty = true;
+    Save(false);
+
+    emit ProgressChanged(Index.getProgress(Duration));
+    if (hasCuts) {
+        emit CutsChanged();
+    }
+}
+
+void ShotAnalyzer::EndJob(Job *job) {
+    Jobs.removeOne(job);
+
+    // Frames already queued to the worker are dropped, and results it
+    // already sent carry an id no job has any more
+    job->Player->stop();
+    job->Player->deleteLater();
+
+    job->Worker->Cancel();
+    job->Thread->quit();
+
+    delete job;
+}
+
+void ShotAnalyzer::Save(bool force) {
+    if (!isDirty)
+        return;
+
+    if (!force && SaveTimer.elapsed() < SaveInterval)
+        return;
+
+    Index.Write(MediaPath);
+
+    isDirty = false;
+    SaveTimer.restart();
+}
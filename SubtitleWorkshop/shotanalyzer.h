@@ -0,0 +1,82 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QMediaPlayer>
+#include <QObject>
+#include <QThread>
+
+#include "framegrabber.h"
+#include "shotindex.h"
+#include "shotworker.h"
+
+// Finds the shot changes of a media file in the background. The parts not
+// in its ShotIndex yet are split into chunks, which muted players decode at
+// once, one per core. Each player's frames go to a ShotWorker on a thread
+// of its own, the GUI thread only collects the cuts. Players run at normal
+// speed, faster ones drop frames and so could place cuts late.
+// What has been looked at is added to the index as it goes and saved every
+// few seconds, so an analysis that gets interrupted picks up where it was.
+class ShotAnalyzer : public QObject {
+    Q_OBJECT
+
+public:
+    // Chunks aren't split any shorter, in ms
+    static const qint64 MinChunkLength = 60000;
+    // A job adds what it has to the index every this much of the media
+    static const qint64 CommitInterval = 10000;
+    // Jobs start this much early, so a cut right at their start isn't missed
+    static const qint64 LeadIn = 1000;
+
+    ShotAnalyzer(const QString &mediaPath, QObject *parent = nullptr);
+    // Whatever was analysed is kept in the index
+    ~ShotAnalyzer();
+
+    // Reads the media's index and analyses the rest of [0, duration)
+    void Start(qint64 duration);
+
+    const ShotIndex &getIndex() const { return Index; }
+
+signals:
+    void ProgressChanged(int percent);
+    void CutsChanged();
+    void Finished(bool success);
+
+private slots:
+    void FrameAnalysed(int jobId, qint64 time, bool isCut);
+    void PlayerStatusChanged(QMediaPlayer::MediaStatus status);
+    void PlayerError(QMediaPlayer::Error error);
+
+private:
+    struct Job {
+        // What its worker's results are told apart by
+        int Id;
+        QMediaPlayer *Player;
+        FrameGrabber *Grabber;
+        QThread *Thread;
+        ShotWorker *Worker;
+        // Start of what hasn't been added to the index yet
+        qint64 From;
+        qint64 To;
+        QVector<qint64> Cuts;
+    };
+
+    QString MediaPath;
+    qint64 Duration = 0;
+    ShotIndex Index;
+
+    QVector<ShotIndex::Span> Chunks;
+    QList<Job *> Jobs;
+    int NextJobId = 0;
+    bool isDone = false;
+
+    QElapsedTimer SaveTimer;
+    bool isDirty = false;
+
+    static int JobLimit();
+    Job *JobFor(QObject *player) const;
+    Job *JobWithId(int id) const;
+    void StartJobs();
+    void Commit(Job *job, qint64 to);
+    void EndJob(Job *job);
+    void Save(bool force);
+};
@@ -0,0 +1,111 @@
+#include "shotdetector.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SHOTDETECTOR_SSE2
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define SHOTDETECTOR_NEON
+#endif
+
+namespace {
+
+// Mean difference per pixel, out of 255, a cut has to reach at least
+const double MinDifference = 24.0;
+// And how many times the recent average
+const double DifferenceRatio = 3.0;
+// Part of the histogram that has to have moved, out of 1
+const double MinHistogramChange = 0.3;
+
+// Weight of the newest frame in the running average
+const double AverageWeight = 0.1;
+
+}
+
+bool ShotDetector::Add(qint64 time, const QByteArray &thumbnail) {
+    if (thumbnail.size() != ThumbnailSize)
+        return false;
+
+    quint32 Current[Bins];
+    Histogram(thumbnail, Current);
+
+    bool isCut = false;
+
+    if (!Previous.isEmpty()) {
+        double Mean = double(Difference(reinterpret_cast<const uchar *>(Previous.constData()), reinterpret_cast<const uchar *>(thumbnail.constData()), ThumbnailSize)) / ThumbnailSize;
+
+        quint32 Moved = 0;
+        for (int i = 0; i < Bins; i++) {
+            Moved += quint32(std::abs(qint64(Current[i]) - qint64(PreviousHistogram[i])));
+        }
+
+        // Every pixel that moved bins is counted twice, once where it left
+        double HistogramChange = double(Moved) / (2 * ThumbnailSize);
+
+        isCut = Mean >= MinDifference && Mean >= DifferenceRatio * AverageDifference && HistogramChange >= MinHistogramChange && time - LastCut >= MinShotLength;
+
+        // A cut would lift the average and hide the next one
+        if (!isCut) {
+            AverageDifference += AverageWeight * (Mean - AverageDifference);
+        }
+    }
+
+    if (isCut) {
+        LastCut = time;
+    }
+
+    Previous = thumbnail;
+    std::memcpy(PreviousHistogram, Current, sizeof(Current));
+
+    return isCut;
+}
+
+void ShotDetector::Reset() {
+    Previous.clear();
+    LastCut = -MinShotLength;
+    AverageDifference = 0.0;
+}
+
+quint32 ShotDetector::Difference(const uchar *a, const uchar *b, int size) {
+    quint32 Sum = 0;
+    int i = 0;
+
+#if defined(SHOTDETECTOR_SSE2)
+    // psadbw sums 8 absolute differences into each 64-bit half
+    __m128i Total = _mm_setzero_si128();
+    for (; i + 16 <= size; i += 16) {
+        __m128i A = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+        __m128i B = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+        Total = _mm_add_epi64(Total, _mm_sad_epu8(A, B));
+    }
+
+    Sum = quint32(_mm_cvtsi128_si32(Total)) + quint32(_mm_cvtsi128_si32(_mm_srli_si128(Total, 8)));
+#elif defined(SHOTDETECTOR_NEON)
+    // Widened pairwise as they're added up, 16 bits would overflow
+    uint32x4_t Total = vdupq_n_u32(0);
+    for (; i + 16 <= size; i += 16) {
+        uint8x16_t Differences = vabdq_u8(vld1q_u8(a + i), vld1q_u8(b + i));
+        Total = vpadalq_u16(Total, vpaddlq_u8(Differences));
+    }
+
+    Sum = vgetq_lane_u32(Total, 0) + vgetq_lane_u32(Total, 1) + vgetq_lane_u32(Total, 2) + vgetq_lane_u32(Total, 3);
+#endif
+
+    for (; i < size; i++) {
+        Sum += quint32(std::abs(int(a[i]) - int(b[i])));
+    }
+
+    return Sum;
+}
+
+void ShotDetector::Histogram(const QByteArray &thumbnail, quint32 *bins) {
+    std::memset(bins, 0, Bins * sizeof(quint32));
+
+    const uchar *Pixels = reinterpret_cast<const uchar *>(thumbnail.constData());
+    for (int i = 0; i < thumbnail.size(); i++) {
+        bins[Pixels[i] * Bins / 256]++;
+    }
+}
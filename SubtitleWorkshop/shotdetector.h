@@ -0,0 +1,40 @@
+#pragma once
+
+#include <QByteArray>
+#include <QtGlobal>
+
+// Tells shot changes apart in a run of consecutive frames, each given as a
+// small grey thumbnail. A frame starts a new shot when it differs from the
+// one before both pixel by pixel (sum of absolute differences) and in its
+// brightness histogram, by a lot more than frames have lately. Pans and
+// moving objects change the pixels but hardly the histogram, fades change
+// the histogram a little at a time.
+class ShotDetector {
+public:
+    static const int ThumbnailWidth = 64;
+    static const int ThumbnailHeight = 36;
+    static const int ThumbnailSize = ThumbnailWidth * ThumbnailHeight;
+
+    // Shots shorter than this are taken as flashes, in ms
+    static const qint64 MinShotLength = 200;
+
+    // Frames have to come in order. Returns whether the one showing at time
+    // starts a new shot.
+    bool Add(qint64 time, const QByteArray &thumbnail);
+    void Reset();
+
+    // Sum of absolute differences of size bytes, vectorised where the
+    // compiler targets SSE2 or NEON
+    static quint32 Difference(const uchar *a, const uchar *b, int size);
+
+private:
+    static const int Bins = 32;
+
+    QByteArray Previous;
+    quint32 PreviousHistogram[Bins];
+    qint64 LastCut = -MinShotLength;
+    // Running average of the mean pixel difference between frames
+    double AverageDifference = 0.0;
+
+    static void Histogram(const QByteArray &thumbnail, quint32 *bins);
+};
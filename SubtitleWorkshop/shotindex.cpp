@@ -0,0 +1,228 @@
+#include "shotindex.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <iterator>
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+namespace {
+
+const char Magic[8] = { 'S', 'S', 'C', 'U', 'T', 'S', '\0', '\0' };
+const quint32 FormatVersion = 1;
+// Reads back as 0x04030201 on a machine of the other byte order
+const quint32 ByteOrderMark = 0x01020304;
+
+struct Header {
+    char Magic[8];
+    quint32 Version;
+    quint32 ByteOrder;
+    // Of the media the cuts were found in, an index of anything else is stale
+    qint64 MediaSize;
+    qint64 MediaModified;
+    qint64 CutCount;
+    qint64 SpanCount;
+};
+
+}
+
+const QString ShotIndex::Suffix = ".cuts";
+
+void ShotIndex::Clear() {
+    Cuts.clear();
+    Analysed.clear();
+}
+
+qint64 ShotIndex::Nearest(qint64 time, qint64 maxDistance) const {
+    auto After = std::lower_bound(Cuts.constBegin(), Cuts.constEnd(), time);
+
+    qint64 Best = -1;
+    qint64 BestDistance = maxDistance + 1;
+
+    if (After != Cuts.constEnd() && *After - time < BestDistance) {
+        Best = *After;
+        BestDistance = *After - time;
+    }
+
+    if (After != Cuts.constBegin() && time - *(After - 1) < BestDistance) {
+        Best = *(After - 1);
+    }
+
+    return Best;
+}
+
+void ShotIndex::Add(qint64 from, qint64 to, const QVector<qint64> &cuts) {
+    if (to <= from)
+        return;
+
+    // Cuts of a span analysed twice, e.g. where two jobs overlapped, are
+    // only kept once
+    QVector<qint64> Merged;
+    Merged.reserve(Cuts.size() + cuts.size());
+    std::merge(Cuts.constBegin(), Cuts.constEnd(), cuts.constBegin(), cuts.constEnd(), std::back_inserter(Merged));
+    Merged.erase(std::unique(Merged.begin(), Merged.end()), Merged.end());
+    Cuts = Merged;
+
+    // Spans touching the new one are merged into it
+    auto First = std::lower_bound(Analysed.begin(), Analysed.end(), from, [](const Span &span, qint64 time) {
+        return span.second < time;
+    });
+
+    auto Last = First;
+    while (Last != Analysed.end() && Last->first <= to) {
+        from = std::min(from, Last->first);
+        to = std::max(to, Last->second);
+        Last++;
+    }
+
+    int Index = int(First - Analysed.begin());
+    Analysed.erase(First, Last);
+    Analysed.insert(Index, Span(from, to));
+}
+
+QVector<ShotIndex::Span> ShotIndex::Missing(qint64 duration) const {
+    QVector<Span> Result;
+
+    qint64 Time = 0;
+    for (const Span &span : Analysed) {
+        if (span.first >= duration)
+            break;
+
+        if (span.first > Time) {
+            Result.append(Span(Time, span.first));
+        }
+
+        Time = std::max(Time, span.second);
+    }
+
+    if (Time < duration) {
+        Result.append(Span(Time, duration));
+    }
+
+    return Result;
+}
+
+int ShotIndex::getProgress(qint64 duration) const {
+    if (duration <= 0)
+        return 100;
+
+    qint64 Left = 0;
+    for (const Span &span : Missing(duration)) {
+        Left += span.second - span.first;
+    }
+
+    return int((duration - Left) * 100 / duration);
+}
+
+bool ShotIndex::Read(const QString &mediaPath) {
+    QFileInfo Media(mediaPath);
+    if (!Media.exists())
+        return false;
+
+    const QString Paths[] = { CachePathFor(mediaPath), FallbackCachePathFor(mediaPath) };
+
+    for (const QString &path : Paths) {
+        QFile File(path);
+        if (!File.open(QIODevice::ReadOnly))
+            continue;
+
+        Header header;
+        if (File.read(reinterpret_cast<char *>(&header), sizeof(Header)) != qint64(sizeof(Header)))
+            continue;
+
+        if (std::memcmp(header.Magic, Magic, sizeof(Magic)) != 0 || header.Version != FormatVersion || header.ByteOrder != ByteOrderMark)
+            continue;
+
+        if (header.MediaSize != Media.size() || header.MediaModified != Media.lastModified().toMSecsSinceEpoch())
+            continue;
+
+        if (header.CutCount < 0 || header.CutCount > INT_MAX || header.SpanCount < 0 || header.SpanCount > INT_MAX)
+            continue;
+
+        qint64 CutsSize = header.CutCount * qint64(sizeof(qint64));
+        qint64 SpansSize = header.SpanCount * qint64(2 * sizeof(qint64));
+        if (File.size() != qint64(sizeof(Header)) + CutsSize + SpansSize)
+            continue;
+
+        QVector<qint64> ReadCuts(int(header.CutCount));
+        QVector<qint64> Bounds(int(header.SpanCount) * 2);
+        if (File.read(reinterpret_cast<char *>(ReadCuts.data()), CutsSize) != CutsSize ||
+            File.read(reinterpret_cast<char *>(Bounds.data()), SpansSize) != SpansSize)
+            continue;
+
+        Clear();
+        Cuts = ReadCuts;
+        for (int i = 0; i < Bounds.size(); i += 2) {
+            Analysed.append(Span(Bounds.at(i), Bounds.at(i + 1)));
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+bool ShotIndex::Write(const QString &mediaPath) const {
+    QFileInfo Media(mediaPath);
+    if (!Media.exists())
+        return false;
+
+    Header header;
+    std::memset(&header, 0, sizeof(Header));
+    std::memcpy(header.Magic, Magic, sizeof(Magic));
+    header.Version = FormatVersion;
+    header.ByteOrder = ByteOrderMark;
+    header.MediaSize = Media.size();
+    header.MediaModified = Media.lastModified().toMSecsSinceEpoch();
+    header.CutCount = Cuts.size();
+    header.SpanCount = Analysed.size();
+
+    QVector<qint64> Bounds;
+    Bounds.reserve(Analysed.size() * 2);
+    for (const Span &span : Analysed) {
+        Bounds.append(span.first);
+        Bounds.append(span.second);
+    }
+
+    auto WriteTo = [&](const QString &path) {
+        QSaveFile File(path);
+        if (!File.open(QIODevice::WriteOnly))
+            return false;
+
+        qint64 CutsSize = qint64(Cuts.size()) * qint64(sizeof(qint64));
+        qint64 SpansSize = qint64(Bounds.size()) * qint64(sizeof(qint64));
+        if (File.write(reinterpret_cast<const char *>(&header), sizeof(Header)) != qint64(sizeof(Header)) ||
+            File.write(reinterpret_cast<const char *>(Cuts.constData()), CutsSize) != CutsSize ||
+            File.write(reinterpret_cast<const char *>(Bounds.constData()), SpansSize) != SpansSize) {
+            File.cancelWriting();
+            return false;
+        }
+
+        return File.commit();
+    };
+
+    // Next to the media, unless it's on a read-only disc or share
+    if (WriteTo(CachePathFor(mediaPath)))
+        return true;
+
+    QString Fallback = FallbackCachePathFor(mediaPath);
+    QDir().mkpath(QFileInfo(Fallback).absolutePath());
+
+    return WriteTo(Fallback);
+}
+
+QString ShotIndex::CachePathFor(const QString &mediaPath) {
+    return QFileInfo(mediaPath).absoluteFilePath() + Suffix;
+}
+
+QString ShotIndex::FallbackCachePathFor(const QString &mediaPath) {
+    QByteArray Hash = QCryptographicHash::hash(QFileInfo(mediaPath).absoluteFilePath().toUtf8(), QCryptographicHash::Sha1);
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/cuts/" + QString::fromLatin1(Hash.toHex()) + Suffix;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <QPair>
+#include <QString>
+#include <QVector>
+
+// Shot changes found in a media file's video, along with the spans of it
+// that have been looked at so far. Analysis can stop anywhere and pick up
+// the spans left, so the index is saved as it grows. It lives next to the
+// media, or in the cache folder if that isn't writable, like the waveform.
+class ShotIndex {
+public:
+    typedef QPair<qint64, qint64> Span;
+
+    static const QString Suffix;
+
+    void Clear();
+
+    // In ms, sorted
+    const QVector<qint64> &getCuts() const { return Cuts; }
+    // Cut nearest to time no further than maxDistance away, or -1
+    qint64 Nearest(qint64 time, qint64 maxDistance) const;
+
+    // Records [from, to) as analysed, with the cuts found in it
+    void Add(qint64 from, qint64 to, const QVector<qint64> &cuts);
+    // Spans of [0, duration) not analysed yet
+    QVector<Span> Missing(qint64 duration) const;
+    bool isComplete(qint64 duration) const { return Missing(duration).isEmpty(); }
+    // Part of [0, duration) analysed, 0 to 100
+    int getProgress(qint64 duration) const;
+
+    // Returns false if there's no index for the media as it is now
+    bool Read(const QString &mediaPath);
+    bool Write(const QString &mediaPath) const;
+
+private:
+    QVector<qint64> Cuts;
+    // Sorted and apart from each other
+    QVector<Span> Analysed;
+
+    static QString CachePathFor(const QString &mediaPath);
+    static QString FallbackCachePathFor(const QString &mediaPath);
+};
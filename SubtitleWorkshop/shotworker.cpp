@@ -0,0 +1,20 @@
+#include "shotworker.h"
+
+#include "framegrabber.h"
+
+ShotWorker::ShotWorker(int jobId, qint64 start) : JobId(jobId), Start(start), Cancelled(false) {}
+
+void ShotWorker::Cancel() {
+    Cancelled = true;
+}
+
+void ShotWorker::Process(qint64 time, const QVideoFrame &frame) {
+    if (Cancelled || time < Start)
+        return;
+
+    QByteArray Thumbnail = FrameGrabber::Thumbnail(frame);
+    if (Thumbnail.isEmpty())
+        return;
+
+    emit FrameAnalysed(JobId, time, Detector.Add(time, Thumbnail));
+}
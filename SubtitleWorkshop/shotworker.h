@@ -0,0 +1,37 @@
+#pragma once
+
+#include <atomic>
+
+#include <QObject>
+#include <QVideoFrame>
+
+#include "shotdetector.h"
+
+// Looks at the frames of one ShotAnalyzer job on a thread of its own, so
+// neither the thumbnails nor comparing them hold up the GUI. Frames are
+// queued to it in the order they were decoded, which the detector needs.
+class ShotWorker : public QObject {
+    Q_OBJECT
+
+public:
+    // Frames before start are from before the player's seek landed. The
+    // job id goes out with every result, results can still be queued once
+    // the worker is gone and another one may be at its address.
+    ShotWorker(int jobId, qint64 start);
+
+    // Frames still queued are dropped, can be called from any thread
+    void Cancel();
+
+public slots:
+    void Process(qint64 time, const QVideoFrame &frame);
+
+signals:
+    // Every frame looked at, and whether it starts a new shot
+    void FrameAnalysed(int jobId, qint64 time, bool isCut);
+
+private:
+    ShotDetector Detector;
+    int JobId;
+    qint64 Start;
+    std::atomic<bool> Cancelled;
+};
@@ -1,154 +1,875 @@
 #include "subparser.h"
 
-SubParser::SubParser() {}
+#include <climits>
+#include <cstring>
+#include <memory>
 
-// SubRip (.srt)
-QList<SubtitleItem> SubParser::ParseSrt(QString filepath) {
-    QList<SubtitleItem> Result;
+#include <QElapsedTimer>
+#include <QTextCodec>
 
-    QFile File(filepath);
-    if (!File.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        return Result;
+namespace {
+
+// End of the line starting at p: the position of its '\n', or end
+inline const char *FindLineEnd(const char *p, const char *end) {
+    const void *nl = std::memchr(p, '\n', end - p);
+    return nl ? static_cast<const char *>(nl) : end;
+}
+
+// Drops the '\r' of a CRLF line ending
+inline const char *TrimCR(const char *begin, const char *end) {
+    return (end > begin && end[-1] == '\r') ? end - 1 : end;
+}
+
+inline bool IsDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+inline bool HasArrow(const char *begin, const char *end) {
+    const char *p = begin;
+    while (p < end) {
+        const void *dash = std::memchr(p, '-', end - p);
+        if (!dash)
+            return false;
+
+        p = static_cast<const char *>(dash);
+        if (end - p >= 3 && p[1] == '-' && p[2] == '>')
+            return true;
+
+        p++;
     }
 
-    QTextStream in(&File);
-    while (!in.atEnd()) {
-        in.readLine();
+    return false;
+}
 
-        QString SubShowTime = in.read(12);
-        in.seek(in.pos() + 5);
-        QString SubHideTime = in.read(12);
+// Text of a script section, with CRLF line endings made plain
+inline QString DecodeSection(const char *begin, const char *end) {
+    QByteArray Text(begin, int(end - begin));
+    Text.replace("\r\n", "\n");
+    return QString::fromUtf8(Text);
+}
 
-        in.seek(in.pos() + 2);
+inline bool StartsWith(const char *begin, const char *end, const char *word) {
+    size_t len = std::strlen(word);
+    return size_t(end - begin) >= len && std::memcmp(begin, word, len) == 0;
+}
 
-        QString SubText;
-        QChar c;
-        while (!in.atEnd()) {
-            in >> c;
-            if (c == '\n') {
-                in >> c;
+// Writes value in decimal at p, returns the end
+inline char *WriteNumber(char *p, quint64 value) {
+    char Digits[20];
+    int Count = 0;
+    do {
+        Digits[Count++] = char('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+
+    while (Count > 0) {
+        *p++ = Digits[--Count];
+    }
 
-                if (c == '\n') break;
+    return p;
+}
+
+// "h:mm:ss.cc", scripts count in centiseconds and can't go below zero
+inline char *WriteScriptTime(char *p, qint64 ms) {
+    quint64 value = ms > 0 ? quint64(ms) / 10 : 0;
+
+    quint64 centiseconds = value % 100;
+    quint64 seconds = value / 100 % 60;
+    quint64 minutes = value / 6000 % 60;
+
+    p = WriteNumber(p, value / 360000);
+    *p++ = ':';
+    *p++ = char('0' + minutes / 10);
+    *p++ = char('0' + minutes % 10);
+    *p++ = ':';
+    *p++ = char('0' + seconds / 10);
+    *p++ = char('0' + seconds % 10);
+    *p++ = '.';
+    *p++ = char('0' + centiseconds / 10);
+    *p++ = char('0' + centiseconds % 10);
+    return p;
+}
 
-                in.seek(in.pos() - 3);
-                in >> c;
+// Written when the cues don't come from a script
+const char *DefaultAssHeader =
+        "[Script Info]\n"
+        "ScriptType: v4.00+\n"
+        "PlayResX: 384\n"
+        "PlayResY: 288\n"
+        "\n"
+        "[V4+ Styles]\n"
+        "Format: Name, Fontname, Fontsize, PrimaryColour, SecondaryColour, OutlineColour, BackColour, Bold, Italic, Underline, StrikeOut, ScaleX, ScaleY, Spacing, Angle, BorderStyle, Outline, Shadow, Alignment, MarginL, MarginR, MarginV, Encoding\n"
+        "Style: Default,Arial,16,&H00FFFFFF,&H00FFFFFF,&H00000000,&H00000000,0,0,0,0,100,100,0,0,1,1,0,2,10,10,10,1\n"
+        "\n";
+
+const char *DefaultSsaHeader =
+        "[Script Info]\n"
+        "ScriptType: v4.00\n"
+        "PlayResX: 384\n"
+        "PlayResY: 288\n"
+        "\n"
+        "[V4 Styles]\n"
+        "Format: Name, Fontname, Fontsize, PrimaryColour, SecondaryColour, TertiaryColour, BackColour, Bold, Italic, BorderStyle, Outline, Shadow, Alignment, MarginL, MarginR, MarginV, AlphaLevel, Encoding\n"
+        "Style: Default,Arial,16,16777215,16777215,0,0,0,0,1,1,0,2,10,10,10,0,1\n"
+        "\n";
+
+const char *DefaultAssEventFormat = "Format: Layer, Start, End, Style, Name, MarginL, MarginR, MarginV, Effect, Text";
+const char *DefaultSsaEventFormat = "Format: Marked, Start, End, Style, Name, MarginL, MarginR, MarginV, Effect, Text";
+
+// Collects the output in one large byte buffer and hands it to the device
+// a megabyte at a time. Output is built as UTF-8, any other encoding gets
+// transcoded a buffer at a time on the way out.
+class CueWriter {
+public:
+    CueWriter(QIODevice *device, const TextEncoding &encoding) : Device(device) {
+        Buffer.resize(BufferSize);
+
+        if (!encoding.isUtf8()) {
+            QTextCodec *Codec = QTextCodec::codecForName(encoding.getName());
+            if (Codec) {
+                // Both keep state, sequences split across buffers carry over
+                Decoder.reset(QTextCodec::codecForName("UTF-8")->makeDecoder());
+                Encoder.reset(Codec->makeEncoder(QTextCodec::IgnoreHeader));
             }
+        }
+
+#ifdef Q_OS_WIN
+        // Wide files aren't opened in text mode, their line breaks are
+        // turned into CRLF here, before encoding
+        CrLf = encoding.isWide() && Encoder;
+#endif
 
-            SubText.append(c);
+        QByteArray Bom = encoding.getBomBytes();
+        if (!Bom.isEmpty()) {
+            Failed = Device->write(Bom) != Bom.size();
+            Written += Bom.size();
         }
+    }
 
-        QTime SubtitleShowTimestamp = QTime().fromString(SubShowTime);
-        QTime SubtitleHideTimestamp = QTime().fromString(SubHideTime);
+    // Room for at least bytes more chars. Write them at the returned
+    // pointer and pass the end to Commit().
+    char *Reserve(int bytes) {
+        if (Used + bytes > Buffer.size()) {
+            Flush();
+            if (bytes > Buffer.size()) {
+                Buffer.resize(bytes);
+            }
+        }
 
-        SubtitleItem item(SubtitleShowTimestamp, SubtitleHideTimestamp, SubText);
-        Result.push_back(item);
+        return Buffer.data() + Used;
     }
 
-    File.close();
+    void Commit(const char *end) {
+        Used = int(end - Buffer.constData());
+    }
+
+    void Append(const char *data, int length) {
+        char *p = Reserve(length);
+        std::memcpy(p, data, length);
+        Commit(p + length);
+    }
+
+    void AppendUtf8(const QChar *text, int length) {
+        // A UTF-16 unit never takes more than 3 bytes
+        char *p = Reserve(length * 3);
+
+        for (int i = 0; i < length; i++) {
+            ushort c = text[i].unicode();
+
+            if (c < 0x80) {
+                *p++ = char(c);
+            }
+            else if (c < 0x800) {
+                *p++ = char(0xC0 | (c >> 6));
+                *p++ = char(0x80 | (c & 0x3F));
+            }
+            else if (QChar::isHighSurrogate(c) && i + 1 < length && text[i + 1].isLowSurrogate()) {
+                uint ucs = QChar::surrogateToUcs4(c, text[++i].unicode());
+                *p++ = char(0xF0 | (ucs >> 18));
+                *p++ = char(0x80 | ((ucs >> 12) & 0x3F));
+                *p++ = char(0x80 | ((ucs >> 6) & 0x3F));
+                *p++ = char(0x80 | (ucs & 0x3F));
+            }
+            else {
+                // Unpaired surrogates become U+FFFD
+                if (QChar::isSurrogate(c)) {
+                    c = QChar::ReplacementCharacter;
+                }
+
+                *p++ = char(0xE0 | (c >> 12));
+                *p++ = char(0x80 | ((c >> 6) & 0x3F));
+                *p++ = char(0x80 | (c & 0x3F));
+            }
+        }
+
+        Commit(p);
+    }
+
+    void AppendUtf8(const QString &text) {
+        AppendUtf8(text.constData(), text.size());
+    }
+
+    bool Flush() {
+        if (Used > 0) {
+            if (Encoder) {
+                QString Text = Decoder->toUnicode(Buffer.constData(), Used);
+                if (CrLf) {
+                    Text.replace('\n', "\r\n");
+                }
+
+                QByteArray Encoded = Encoder->fromUnicode(Text);
+                if (Device->write(Encoded) != Encoded.size()) {
+                    Failed = true;
+                }
+
+                Written += Encoded.size();
+            }
+            else {
+                if (Device->write(Buffer.constData(), Used) != Used) {
+                    Failed = true;
+                }
+
+                Written += Used;
+            }
+
+            Used = 0;
+        }
+
+        return !Failed;
+    }
+
+    qint64 getBytesWritten() const { return Written; }
+
+private:
+    static const int BufferSize = 1 << 20;
+
+    QIODevice *Device;
+    std::unique_ptr<QTextDecoder> Decoder;
+    std::unique_ptr<QTextEncoder> Encoder;
+    QByteArray Buffer;
+    int Used = 0;
+    qint64 Written = 0;
+    bool CrLf = false;
+    bool Failed = false;
+};
+
+}
+
+SubParser::SubParser() {}
 
+// SubRip (.srt)
+QList<SubtitleItem> SubParser::ParseSrt(QString filepath) {
+    QList<SubtitleItem> Result;
+    ParseFile(filepath, CueFormat::SRT, Result);
     return Result;
 }
 
-bool SubParser::ExportSrt(QList<SubtitleItem> items, QString filepath) {
-    QFile File(filepath);
-    if (!File.open(QIODevice::WriteOnly | QIODevice::Text)) {
+bool SubParser::ExportSrt(const QList<SubtitleItem> &items, const QString &filepath) {
+    return Export(items, filepath, CueFormat::SRT);
+}
+
+// WebVTT (.vtt)
+QList<SubtitleItem> SubParser::ParseVtt(QString filepath) {
+    QList<SubtitleItem> Result;
+    ParseFile(filepath, CueFormat::VTT, Result);
+    return Result;
+}
+
+bool SubParser::ExportVtt(const QList<SubtitleItem> &items, const QString &filepath) {
+    return Export(items, filepath, CueFormat::VTT);
+}
+
+// Writing engine
+double SubParser::ExportStats::getMegabytesPerSecond() const {
+    if (Nanoseconds <= 0)
+        return 0;
+
+    return Bytes / (1024.0 * 1024.0) / (Nanoseconds / 1e9);
+}
+
+bool SubParser::Export(const SubtitleStore &store, const QString &filepath, CueFormat format, ExportStats *stats) {
+    return WriteCues(filepath, format, store.size(), stats, &store.getStyles(), store.getEncoding(), [&store](int i, CueView &cue) {
+        cue.ShowTime = store.getShowTime(i);
+        cue.HideTime = store.getHideTime(i);
+        cue.Text = store.getSubtitleData(i);
+        cue.TextLength = store.getSubtitleLength(i);
+        cue.Style = store.getStyle(i);
+    });
+}
+
+bool SubParser::Export(const QList<SubtitleItem> &items, const QString &filepath, CueFormat format, ExportStats *stats, const SubtitleStyleTable *styles, const TextEncoding *encoding) {
+    return WriteCues(filepath, format, items.size(), stats, styles, encoding ? *encoding : TextEncoding(), [&items](int i, CueView &cue) {
+        const SubtitleItem &item = items.at(i);
+        cue.ShowTime = item.getShowTime();
+        cue.HideTime = item.getHideTime();
+        cue.Text = item.getSubtitle().constData();
+        cue.TextLength = item.getSubtitle().size();
+        cue.Style = item.getStyle();
+    });
+}
+
+bool SubParser::WriteCues(const QString &filepath, CueFormat format, int count, ExportStats *stats, const SubtitleStyleTable *styles, const TextEncoding &encoding, const std::function<void(int, CueView &)> &cueAt) {
+    QElapsedTimer Timer;
+    Timer.start();
+
+    // Text mode would put a lone '\r' byte in front of every "\n\0", the
+    // writer puts whole encoded CRLFs in itself
+    QSaveFile File(filepath);
+    if (!File.open(encoding.isWide() ? QIODevice::WriteOnly : QIODevice::WriteOnly | QIODevice::Text)) {
         return false;
     }
 
-    QTextStream out(&File);
-    int SubCount = 0;
+    CueWriter Writer(&File, encoding);
+
+    bool isScript = format == CueFormat::ASS || format == CueFormat::SSA;
+    bool isSsa = format == CueFormat::SSA;
 
-    for (int i = 0; i < items.size(); i++) {
-        out << ++SubCount << "\n";
-        out << items.at(i).getShowTimestamp().toString("hh:mm:ss,zzz");
-        out << " --> ";
-        out << items.at(i).getHideTimestamp().toString("hh:mm:ss,zzz");
-        out << "\n";
-        out << items.at(i).getSubtitle();
+    // Cues read from a script carry override tags, the rest SubRip tags.
+    // Either get converted when written to the other kind.
+    bool fromScript = styles && styles->hasScript();
+
+    if (format == CueFormat::VTT) {
+        Writer.Append("WEBVTT\n\n", 8);
+    }
+    else if (isScript) {
+        Writer.AppendUtf8(fromScript ? styles->getHeader() : QString(isSsa ? DefaultSsaHeader : DefaultAssHeader));
+        Writer.Append("[Events]\n", 9);
+        Writer.AppendUtf8(fromScript && !styles->getEventFormat().isEmpty() ? styles->getEventFormat() : QString(isSsa ? DefaultSsaEventFormat : DefaultAssEventFormat));
+        Writer.Append("\n", 1);
+    }
 
-        if (i != items.size() - 1) {
-            out << "\n\n";
+    SubtitleStyleTable::EventStyle DefaultEvent;
+    DefaultEvent.Type = "Dialogue";
+    DefaultEvent.Leading = isSsa ? "Marked=0," : "0,";
+    DefaultEvent.Trailing = isSsa ? "Default,,0000,0000,0000,," : "Default,,0,0,0,,";
+
+    const char Separator = format == CueFormat::SRT ? ',' : '.';
+    CueView Cue;
+    int Written = 0;
+
+    for (int i = 0; i < count; i++) {
+        cueAt(i, Cue);
+
+        if (isScript) {
+            const SubtitleStyleTable::EventStyle &Event = fromScript ? styles->at(Cue.Style) : DefaultEvent;
+
+            Writer.AppendUtf8(Event.Type);
+            Writer.Append(": ", 2);
+            Writer.AppendUtf8(Event.Leading);
+
+            char *p = Writer.Reserve(2 * SubtitleItem::MaxTimeLength + 2);
+            p = WriteScriptTime(p, Cue.ShowTime);
+            *p++ = ',';
+            p = WriteScriptTime(p, Cue.HideTime);
+            *p++ = ',';
+            Writer.Commit(p);
+
+            Writer.AppendUtf8(Event.Trailing);
+
+            if (fromScript) {
+                Writer.AppendUtf8(Cue.Text, Cue.TextLength);
+            }
+            else {
+                Writer.AppendUtf8(SubtitleStyleTable::FromSubRip(QString(Cue.Text, Cue.TextLength)));
+            }
+
+            Writer.Append("\n", 1);
+            continue;
+        }
+
+        // Script comments have no place in the other formats
+        if (fromScript && styles->isComment(Cue.Style)) {
+            continue;
+        }
+
+        if (Written > 0) {
+            Writer.Append("\n\n", 2);
         }
+
+        // Index, two timestamps with the arrow and the line breaks
+        char *p = Writer.Reserve(16 + 2 * SubtitleItem::MaxTimeLength + 5 + 2);
+
+        if (format == CueFormat::SRT) {
+            p = WriteNumber(p, quint64(Written) + 1);
+            *p++ = '\n';
+        }
+
+        p += SubtitleItem::FormatTime(Cue.ShowTime, Separator, p);
+        std::memcpy(p, " --> ", 5);
+        p += 5;
+        p += SubtitleItem::FormatTime(Cue.HideTime, Separator, p);
+        *p++ = '\n';
+        Writer.Commit(p);
+
+        if (fromScript) {
+            Writer.AppendUtf8(SubtitleStyleTable::ToSubRip(QString(Cue.Text, Cue.TextLength)));
+        }
+        else {
+            Writer.AppendUtf8(Cue.Text, Cue.TextLength);
+        }
+
+        Written++;
     }
 
-    File.close();
+    if (isScript && fromScript && !styles->getFooter().isEmpty()) {
+        Writer.Append("\n", 1);
+        Writer.AppendUtf8(styles->getFooter());
+    }
+
+    if (!Writer.Flush() || !File.commit()) {
+        return false;
+    }
+
+    if (stats) {
+        stats->Cues = count;
+        stats->Bytes = Writer.getBytesWritten();
+        stats->Nanoseconds = Timer.nsecsElapsed();
+    }
 
     return true;
 }
 
-// WebVTT (.vtt)
-QList<SubtitleItem> SubParser::ParseVtt(QString filepath) {
-    QList<SubtitleItem> Result;
+// Parsing engine
+bool SubParser::ParseFile(const QString &filepath, CueFormat format, QList<SubtitleItem> &items, SubtitleStyleTable *styles, TextEncoding *encoding) {
+    items.clear();
+
+    return ParseBatches(filepath, format, INT_MAX, [&items](QList<SubtitleItem> &batch, qint64, qint64) {
+        if (items.isEmpty()) {
+            items.swap(batch);
+        }
+        else {
+            items.append(batch);
+        }
+
+        return true;
+    }, styles, encoding);
+}
+
+bool SubParser::ParseBatches(const QString &filepath, CueFormat format, int batchSize, const BatchHandler &handler, SubtitleStyleTable *styles, TextEncoding *encoding) {
+    SubtitleStyleTable Unused;
+    SubtitleStyleTable &Styles = styles ? *styles : Unused;
+    Styles.clear();
+
+    if (encoding) {
+        *encoding = TextEncoding();
+    }
+
+    auto ParseUtf8 = [&](const char *data, qint64 size) {
+        if (format == CueFormat::ASS || format == CueFormat::SSA)
+            return ParseScript(data, size, batchSize, handler, Styles);
+
+        return ParseCues(data, size, format, batchSize, handler);
+    };
+
+    // The parsers only know UTF-8. Anything else is transcoded in one go
+    // first, UTF-8 files are parsed where they lie.
+    auto Parse = [&](const char *data, qint64 size) {
+        TextEncoding Encoding = TextEncoding::Detect(data, size);
+        if (encoding) {
+            *encoding = Encoding;
+        }
+
+        if (Encoding.isUtf8())
+            return ParseUtf8(data, size);
+
+        QByteArray Utf8 = Encoding.ToUtf8(data, size);
+        return ParseUtf8(Utf8.constData(), Utf8.size());
+    };
 
     QFile File(filepath);
-    if (!File.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        return Result;
+    if (!File.open(QIODevice::ReadOnly)) {
+        return false;
     }
 
-    QTextStream in(&File);
-    if (in.read(6) == "WEBVTT") {
-        in.seek(in.pos() + 4);
+    qint64 Size = File.size();
+    if (Size <= 0) {
+        QList<SubtitleItem> Empty;
+        return handler(Empty, 0, 0);
+    }
+
+    // Scan the file in place, only fall back to reading it
+    // on devices that can't be mapped.
+    bool Result;
+    uchar *Mapped = File.map(0, Size);
+    if (Mapped) {
+        Result = Parse(reinterpret_cast<const char *>(Mapped), Size);
+        File.unmap(Mapped);
     }
     else {
-        in.seek(0);
+        QByteArray Data = File.readAll();
+        Result = Parse(Data.constData(), Data.size());
     }
 
-    while (!in.atEnd()) {
-        QString SubShowTime = in.read(12);
-        in.seek(in.pos() + 5);
-        QString SubHideTime = in.read(12);
+    File.close();
+
+    return Result;
+}
+
+bool SubParser::ParseCues(const char *data, qint64 size, CueFormat format, int batchSize, const BatchHandler &handler) {
+    // A typical cue takes 50-80 bytes
+    int Capacity = int(qMin<qint64>(qMin<qint64>(size / 64, 1 << 24), batchSize));
 
-        in.seek(in.pos() + 2);
+    QList<SubtitleItem> Batch;
+    Batch.reserve(Capacity);
+
+    const char *p = data;
+    const char *end = data + size;
+
+    // UTF-8 BOM
+    if (size >= 3 && std::memcmp(p, "\xEF\xBB\xBF", 3) == 0) {
+        p += 3;
+    }
+
+    // Skips the rest of the current block, up to and including the blank line
+    auto SkipBlock = [&]() {
+        while (p < end) {
+            const char *le = FindLineEnd(p, end);
+            bool blank = TrimCR(p, le) == p;
+            p = le < end ? le + 1 : end;
+            if (blank) break;
+        }
+    };
+
+    if (format == CueFormat::VTT && StartsWith(p, end, "WEBVTT")) {
+        SkipBlock();
+    }
+
+    while (p < end) {
+        const char *le = FindLineEnd(p, end);
+        const char *lineEnd = TrimCR(p, le);
+
+        // Blank lines between cues
+        if (lineEnd == p) {
+            p = le < end ? le + 1 : end;
+            continue;
+        }
+
+        // The timing line is either the first line of the block or follows
+        // the cue number (SubRip) / cue identifier (WebVTT).
+        if (!HasArrow(p, lineEnd)) {
+            if (format == CueFormat::VTT && (StartsWith(p, lineEnd, "NOTE") || StartsWith(p, lineEnd, "STYLE") || StartsWith(p, lineEnd, "REGION"))) {
+                SkipBlock();
+                continue;
+            }
+
+            p = le < end ? le + 1 : end;
+            le = FindLineEnd(p, end);
+            lineEnd = TrimCR(p, le);
+
+            if (!HasArrow(p, lineEnd)) {
+                SkipBlock();
+                continue;
+            }
+        }
+
+        qint64 ShowMs, HideMs;
+        const char *t = p;
+        while (t < lineEnd && (*t == ' ' || *t == '\t')) t++;
+        bool validTiming = ParseTimestamp(t, lineEnd, ShowMs);
+        while (t < lineEnd && (*t == ' ' || *t == '\t' || *t == '-' || *t == '>')) t++;
+        validTiming = validTiming && ParseTimestamp(t, lineEnd, HideMs);
+
+        p = le < end ? le + 1 : end;
+        if (!validTiming) {
+            SkipBlock();
+            continue;
+        }
+
+        // Cue text runs until the next blank line
+        const char *textBegin = p;
+        const char *textEnd = p;
+        bool hasCR = false;
+        while (p < end) {
+            le = FindLineEnd(p, end);
+            lineEnd = TrimCR(p, le);
+            if (lineEnd == p) {
+                p = le < end ? le + 1 : end;
+                break;
+            }
+
+            hasCR = hasCR || lineEnd != le;
+            textEnd = lineEnd;
+            p = le < end ? le + 1 : end;
+        }
 
         QString SubText;
-        QChar c;
-        while (!in.atEnd()) {
-            in >> c;
-            if (c == '\n') {
-                in >> c;
+        if (hasCR) {
+            QByteArray Text(textBegin, int(textEnd - textBegin));
+            Text.replace("\r\n", "\n");
+            SubText = QString::fromUtf8(Text);
+        }
+        else {
+            SubText = QString::fromUtf8(textBegin, int(textEnd - textBegin));
+        }
 
-                if (c == '\n') break;
+        Batch.push_back(SubtitleItem(ShowMs, HideMs, SubText));
 
-                in.seek(in.pos() - 3);
-                in >> c;
+        if (Batch.size() >= batchSize) {
+            if (!handler(Batch, p - data, size)) {
+                return false;
             }
 
-            SubText.append(c);
+            Batch.clear();
+            Batch.reserve(Capacity);
         }
+    }
+
+    return handler(Batch, size, size);
+}
+
+bool SubParser::ParseScript(const char *data, qint64 size, int batchSize, const BatchHandler &handler, SubtitleStyleTable &styles) {
+    // Dialogue lines take 80-120 bytes
+    int Capacity = int(qMin<qint64>(qMin<qint64>(size / 96, 1 << 24), batchSize));
 
-        QTime SubtitleShowTimestamp = QTime().fromString(SubShowTime);
-        QTime SubtitleHideTimestamp = QTime().fromString(SubHideTime);
+    QList<SubtitleItem> Batch;
+    Batch.reserve(Capacity);
 
-        SubtitleItem item(SubtitleShowTimestamp, SubtitleHideTimestamp, SubText);
-        Result.push_back(item);
+    const char *p = data;
+    const char *end = data + size;
+
+    // UTF-8 BOM
+    if (size >= 3 && std::memcmp(p, "\xEF\xBB\xBF", 3) == 0) {
+        p += 3;
     }
 
-    File.close();
+    const char *scriptBegin = p;
 
-    return Result;
+    enum { OtherSection, StyleSection, EventSection } Section = OtherSection;
+
+    // Columns of the styles section
+    int NameField = 0, BoldField = -1, ItalicField = -1, UnderlineField = -1, StrikeOutField = -1;
+
+    // Columns of the events section. Start and End sit next to each other
+    // in every format in use, Text is always last.
+    int StartField = 1;
+    int FieldCount = 10;
+
+    // Event attributes seen so far by their raw bytes, so each distinct
+    // combination is decoded and looked up in the table only once
+    QHash<QByteArray, int> EventStyles;
+    QByteArray Key;
+    Key.reserve(256);
+
+    auto SplitFields = [](const char *begin, const char *end) {
+        QList<QByteArray> Fields = QByteArray::fromRawData(begin, int(end - begin)).split(',');
+        for (QByteArray &field : Fields) {
+            field = field.trimmed();
+        }
+        return Fields;
+    };
+
+    while (p < end) {
+        const char *lineBegin = p;
+        const char *le = FindLineEnd(p, end);
+        const char *lineEnd = TrimCR(p, le);
+        p = le < end ? le + 1 : end;
+
+        if (lineBegin < lineEnd && *lineBegin == '[') {
+            // Sections after the events (e.g. embedded fonts) are kept as they are
+            if (Section == EventSection) {
+                styles.setFooter(DecodeSection(lineBegin, end));
+                break;
+            }
+
+            int length = int(lineEnd - lineBegin);
+            if (length >= 8 && qstrnicmp(lineBegin, "[Events]", 8) == 0) {
+                styles.setHeader(DecodeSection(scriptBegin, lineBegin));
+                Section = EventSection;
+            }
+            else if ((length >= 12 && qstrnicmp(lineBegin, "[V4+ Styles]", 12) == 0) || (length >= 11 && qstrnicmp(lineBegin, "[V4 Styles]", 11) == 0)) {
+                Section = StyleSection;
+            }
+            else {
+                Section = OtherSection;
+            }
+
+            continue;
+        }
+
+        if (Section == StyleSection) {
+            if (StartsWith(lineBegin, lineEnd, "Format:")) {
+                QList<QByteArray> Names = SplitFields(lineBegin + 7, lineEnd);
+                NameField = Names.indexOf("Name");
+                BoldField = Names.indexOf("Bold");
+                ItalicField = Names.indexOf("Italic");
+                UnderlineField = Names.indexOf("Underline");
+                StrikeOutField = Names.indexOf("StrikeOut");
+            }
+            else if (StartsWith(lineBegin, lineEnd, "Style:")) {
+                QList<QByteArray> Values = SplitFields(lineBegin + 6, lineEnd);
+                auto Flag = [&Values](int field) {
+                    return field >= 0 && field < Values.size() && Values.at(field).toInt() != 0;
+                };
+
+                if (NameField < 0 || NameField >= Values.size())
+                    continue;
+
+                SubtitleStyleTable::Style Style;
+                Style.Name = QString::fromUtf8(Values.at(NameField));
+                Style.Bold = Flag(BoldField);
+                Style.Italic = Flag(ItalicField);
+                Style.Underline = Flag(UnderlineField);
+                Style.StrikeOut = Flag(StrikeOutField);
+                styles.addStyle(Style);
+            }
+
+            continue;
+        }
+
+        if (Section != EventSection)
+            continue;
+
+        if (StartsWith(lineBegin, lineEnd, "Format:")) {
+            styles.setEventFormat(QString::fromUtf8(lineBegin, int(lineEnd - lineBegin)));
+
+            QList<QByteArray> Names = SplitFields(lineBegin + 7, lineEnd);
+            int start = Names.indexOf("Start");
+            if (start >= 0 && Names.indexOf("End") == start + 1 && Names.last() == "Text") {
+                StartField = start;
+                FieldCount = Names.size();
+            }
+
+            continue;
+        }
+
+        if (!StartsWith(lineBegin, lineEnd, "Dialogue:") && !StartsWith(lineBegin, lineEnd, "Comment:"))
+            continue;
+
+        const char *typeEnd = static_cast<const char *>(std::memchr(lineBegin, ':', lineEnd - lineBegin));
+        const char *fieldsBegin = typeEnd + 1;
+        while (fieldsBegin < lineEnd && *fieldsBegin == ' ') fieldsBegin++;
+
+        // Find where Start, the fields after End and Text begin. Text is
+        // the rest of the line, commas and all.
+        const char *startBegin = nullptr;
+        const char *trailingBegin = nullptr;
+        const char *fieldBegin = fieldsBegin;
+        int field = 0;
+        for (; field < FieldCount - 1; field++) {
+            if (field == StartField) startBegin = fieldBegin;
+            if (field == StartField + 2) trailingBegin = fieldBegin;
+
+            const void *comma = std::memchr(fieldBegin, ',', lineEnd - fieldBegin);
+            if (!comma)
+                break;
+
+            fieldBegin = static_cast<const char *>(comma) + 1;
+        }
+
+        if (field < FieldCount - 1 || !startBegin)
+            continue;
+
+        const char *textBegin = fieldBegin;
+        if (!trailingBegin) trailingBegin = textBegin;
+
+        qint64 ShowMs, HideMs;
+        const char *t = startBegin;
+        while (t < lineEnd && *t == ' ') t++;
+        bool validTiming = ParseTimestamp(t, lineEnd, ShowMs);
+        while (t < lineEnd && (*t == ' ' || *t == ',')) t++;
+        validTiming = validTiming && ParseTimestamp(t, lineEnd, HideMs);
+
+        if (!validTiming)
+            continue;
+
+        Key.truncate(0);
+        Key.append(lineBegin, int(typeEnd - lineBegin)).append('\n');
+        Key.append(fieldsBegin, int(startBegin - fieldsBegin)).append('\n');
+        Key.append(trailingBegin, int(textBegin - trailingBegin));
+
+        int Style;
+        auto Known = EventStyles.constFind(Key);
+        if (Known != EventStyles.constEnd()) {
+            Style = Known.value();
+        }
+        else {
+            SubtitleStyleTable::EventStyle Event;
+            Event.Type = QString::fromUtf8(lineBegin, int(typeEnd - lineBegin));
+            Event.Leading = QString::fromUtf8(fieldsBegin, int(startBegin - fieldsBegin));
+            Event.Trailing = QString::fromUtf8(trailingBegin, int(textBegin - trailingBegin));
+
+            Style = styles.intern(Event);
+            EventStyles.insert(Key, Style);
+        }
+
+        SubtitleItem Item(ShowMs, HideMs, QString::fromUtf8(textBegin, int(lineEnd - textBegin)));
+        Item.setStyle(Style);
+        Batch.push_back(Item);
+
+        if (Batch.size() >= batchSize) {
+            if (!handler(Batch, p - data, size)) {
+                return false;
+            }
+
+            Batch.clear();
+            Batch.reserve(Capacity);
+        }
+    }
+
+    // A script without events still has its header
+    if (Section != EventSection && !styles.hasScript()) {
+        styles.setHeader(DecodeSection(scriptBegin, end));
+    }
+
+    return handler(Batch, size, size);
 }
 
-bool SubParser::ExportVtt(QList<SubtitleItem> items, QString filepath) {
-    QFile File(filepath);
-    if (!File.open(QIODevice::WriteOnly | QIODevice::Text)) {
-        return false;
+bool SubParser::ParseTimestamp(const char *&p, const char *end, qint64 &ms) {
+    // Fixed-width "hh:mm:ss,zzz", which is what almost every file uses
+    if (end - p >= 12 && p[2] == ':' && p[5] == ':' && (p[8] == ',' || p[8] == '.') &&
+            IsDigit(p[0]) && IsDigit(p[1]) && IsDigit(p[3]) && IsDigit(p[4]) && IsDigit(p[6]) &&
+            IsDigit(p[7]) && IsDigit(p[9]) && IsDigit(p[10]) && IsDigit(p[11])) {
+        qint64 hours = (p[0] - '0') * 10 + (p[1] - '0');
+        int minutes = (p[3] - '0') * 10 + (p[4] - '0');
+        int seconds = (p[6] - '0') * 10 + (p[7] - '0');
+        int milliseconds = (p[9] - '0') * 100 + (p[10] - '0') * 10 + (p[11] - '0');
+
+        ms = ((hours * 60 + minutes) * 60 + seconds) * 1000 + milliseconds;
+        p += 12;
+        return true;
     }
 
-    QTextStream out(&File);
+    // Everything else: optional hours (WebVTT), unpadded fields, short fractions
+    const char *c = p;
+    int Fields[3] = { 0, 0, 0 };
+    int FieldCount = 0;
+
+    while (true) {
+        if (c >= end || !IsDigit(*c))
+            return false;
+
+        int value = 0;
+        for (int digits = 0; c < end && IsDigit(*c); digits++, c++) {
+            if (digits == 6)
+                return false;
+            value = value * 10 + (*c - '0');
+        }
+
+        Fields[FieldCount++] = value;
+        if (FieldCount < 3 && c < end && *c == ':') {
+            c++;
+            continue;
+        }
 
-    for (int i = 0; i < items.size(); i++) {
-        out << items.at(i).getShowTimestamp().toString("hh:mm:ss.zzz");
-        out << " --> ";
-        out << items.at(i).getHideTimestamp().toString("hh:mm:ss.zzz");
-        out << "\n";
-        out << items.at(i).getSubtitle();
+        break;
+    }
 
-        if (i != items.size() - 1) {
-            out << "\n\n";
+    if (FieldCount < 2)
+        return false;
+
+    int milliseconds = 0;
+    if (c < end && (*c == ',' || *c == '.')) {
+        c++;
+        for (int scale = 100; c < end && IsDigit(*c); scale /= 10, c++) {
+            milliseconds += (*c - '0') * scale;
         }
     }
 
-    File.close();
+    qint64 hours = FieldCount == 3 ? Fields[0] : 0;
+    int minutes = Fields[FieldCount - 2];
+    int seconds = Fields[FieldCount - 1];
 
+    ms = ((hours * 60 + minutes) * 60 + seconds) * 1000 + milliseconds;
+    p = c;
     return true;
 }
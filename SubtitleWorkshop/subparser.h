@@ -1,22 +1,87 @@
 #pragma once
 
+#include <functional>
+
 #include <QDebug>
 
 #include <QList>
 #include <QFile>
+#include <QSaveFile>
 #include <QTextStream>
 
 #include "subtitleitem.h"
+#include "subtitlestore.h"
+#include "subtitlestyletable.h"
+#include "textencoding.h"
 
 class SubParser {
 public:
     SubParser();
 
+    enum class CueFormat {
+        SRT,
+        VTT,
+        // Advanced SubStation Alpha and its predecessor, read the same way
+        ASS,
+        SSA
+    };
+
+    // Receives each batch of parsed cues along with how far into the file the
+    // parser is. The handler may take the batch with swap(). Returning false
+    // stops parsing.
+    typedef std::function<bool(QList<SubtitleItem> &batch, qint64 bytesRead, qint64 bytesTotal)> BatchHandler;
+
+    // Streams the cues of a file to handler, batchSize cues at a time.
+    // Returns false if the file couldn't be read or the handler stopped it.
+    // The script and styles of ASS/SSA files go to styles if given, which
+    // the cues' style indices refer to. The file's encoding is detected
+    // before parsing and goes to encoding if given.
+    static bool ParseBatches(const QString &filepath, CueFormat format, int batchSize, const BatchHandler &handler, SubtitleStyleTable *styles = nullptr, TextEncoding *encoding = nullptr);
+
+    // Reads the whole file at once, returns false if it couldn't be read
+    static bool ParseFile(const QString &filepath, CueFormat format, QList<SubtitleItem> &items, SubtitleStyleTable *styles = nullptr, TextEncoding *encoding = nullptr);
+
+    struct ExportStats {
+        int Cues = 0;
+        qint64 Bytes = 0;
+        qint64 Nanoseconds = 0;
+
+        double getMegabytesPerSecond() const;
+    };
+
+    // Writes the cues to a temporary file next to filepath and renames it
+    // over filepath once everything is written, so a failed save leaves the
+    // old file as it was. Fills stats if given. The store's style table, or
+    // styles for a list, is what ASS/SSA output is written with and what
+    // override tags are converted from for the other formats. Likewise the
+    // store's encoding, or encoding for a list, is what the file is written
+    // in, UTF-8 if none is given.
+    static bool Export(const SubtitleStore &store, const QString &filepath, CueFormat format, ExportStats *stats = nullptr);
+    static bool Export(const QList<SubtitleItem> &items, const QString &filepath, CueFormat format, ExportStats *stats = nullptr, const SubtitleStyleTable *styles = nullptr, const TextEncoding *encoding = nullptr);
+
     // SubRip (.srt)
     static QList<SubtitleItem> ParseSrt(QString filepath);
-    static bool ExportSrt(QList<SubtitleItem> items, QString filepath);
+    static bool ExportSrt(const QList<SubtitleItem> &items, const QString &filepath);
 
     // WebVTT (.vtt)
     static QList<SubtitleItem> ParseVtt(QString filepath);
-    static bool ExportVtt(QList<SubtitleItem> items, QString filepath);
+    static bool ExportVtt(const QList<SubtitleItem> &items, const QString &filepath);
+
+private:
+    // One cue as the writer sees it, the text is borrowed from the caller
+    struct CueView {
+        qint64 ShowTime = 0;
+        qint64 HideTime = 0;
+        const QChar *Text = nullptr;
+        int TextLength = 0;
+        int Style = 0;
+    };
+
+    static bool WriteCues(const QString &filepath, CueFormat format, int count, ExportStats *stats, const SubtitleStyleTable *styles, const TextEncoding &encoding, const std::function<void(int, CueView &)> &cueAt);
+
+    static bool ParseCues(const char *data, qint64 size, CueFormat format, int batchSize, const BatchHandler &handler);
+    static bool ParseScript(const char *data, qint64 size, int batchSize, const BatchHandler &handler, SubtitleStyleTable &styles);
+
+    // Decodes "hh:mm:ss,zzz" (or "mm:ss.zzz") into milliseconds and advances p past it
+    static bool ParseTimestamp(const char *&p, const char *end, qint64 &ms);
 };
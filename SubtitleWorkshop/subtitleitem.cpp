@@ -1,34 +1,83 @@
 #include "subtitleitem.h"
 
+#include <cstring>
+
 SubtitleItem::SubtitleItem() {}
 
-SubtitleItem::SubtitleItem(QTime showTimestamp, QTime hideTimestamp, QString subtitle) {
-    ShowTimestamp = showTimestamp;
-    HideTimestamp = hideTimestamp;
+SubtitleItem::SubtitleItem(qint64 showTime, qint64 hideTime, QString subtitle) {
+    ShowTime = showTime;
+    HideTime = hideTime;
     Subtitle = subtitle;
 }
 
 bool operator==(const SubtitleItem& lhs, const SubtitleItem& rhs) {
-    return lhs.getSubtitle() == rhs.getSubtitle() &&
-            lhs.getShowTimestamp() == rhs.getShowTimestamp() &&
-            lhs.getHideTimestamp() == rhs.getHideTimestamp();
+    return lhs.getShowTime() == rhs.getShowTime() &&
+            lhs.getHideTime() == rhs.getHideTime() &&
+            lhs.getStyle() == rhs.getStyle() &&
+            lhs.getSubtitle() == rhs.getSubtitle();
+}
+
+void SubtitleItem::setId(quint64 id) {
+    Id = id;
 }
 
-void SubtitleItem::setShowTimestamp(QTime time) {
-    ShowTimestamp = time;
+void SubtitleItem::setShowTime(qint64 ms) {
+    ShowTime = ms;
 }
 
-void SubtitleItem::setHideTimestamp(QTime time) {
-    HideTimestamp = time;
+void SubtitleItem::setHideTime(qint64 ms) {
+    HideTime = ms;
+}
+
+void SubtitleItem::setStyle(int style) {
+    Style = style;
 }
 
 void SubtitleItem::setSubtitle(QString value) {
     Subtitle = value;
 }
 
-bool SubtitleItem::SortByShowTime(const SubtitleItem &s1, const SubtitleItem &s2) {
-    int Sub1ShowTime = QTime(0, 0, 0).msecsTo((s1.getShowTimestamp()));
-    int Sub2ShowTime = QTime(0, 0, 0).msecsTo((s2.getShowTimestamp()));
+QString SubtitleItem::FormatTime(qint64 ms, char separator) {
+    char Buffer[MaxTimeLength];
+    return QString::fromLatin1(Buffer, FormatTime(ms, separator, Buffer));
+}
 
-    return Sub1ShowTime < Sub2ShowTime;
+int SubtitleItem::FormatTime(qint64 ms, char separator, char *out) {
+    char Buffer[MaxTimeLength];
+    char *p = Buffer + sizeof(Buffer);
+
+    bool negative = ms < 0;
+    quint64 value = negative ? quint64(-ms) : quint64(ms);
+
+    quint64 milliseconds = value % 1000;
+    quint64 seconds = value / 1000 % 60;
+    quint64 minutes = value / 60000 % 60;
+    quint64 hours = value / 3600000;
+
+    // Written back to front
+    *--p = char('0' + milliseconds % 10);
+    *--p = char('0' + milliseconds / 10 % 10);
+    *--p = char('0' + milliseconds / 100);
+    *--p = separator;
+    *--p = char('0' + seconds % 10);
+    *--p = char('0' + seconds / 10);
+    *--p = ':';
+    *--p = char('0' + minutes % 10);
+    *--p = char('0' + minutes / 10);
+    *--p = ':';
+    do {
+        *--p = char('0' + hours % 10);
+        hours /= 10;
+    } while (hours > 0 || Buffer + sizeof(Buffer) - p < 12);
+    if (negative) {
+        *--p = '-';
+    }
+
+    int Length = int(Buffer + sizeof(Buffer) - p);
+    std::memcpy(out, p, Length);
+    return Length;
+}
+
+bool SubtitleItem::SortByShowTime(const SubtitleItem &s1, const SubtitleItem &s2) {
+    return s1.getShowTime() < s2.getShowTime();
 }
@@ -1,26 +1,48 @@
 #pragma once
 
 #include <QString>
-#include <QTime>
+#include <QMetaType>
 
+// A single cue. Times are milliseconds from the start of the media, they can
+// go past 24 hours and below zero (e.g. while shifting), so QTime is only
+// used where they meet the UI. Id is 0 until the cue is put in a store,
+// which gives it an id that stays with it across edits, undo and redo.
+// Style is the cue's entry in its document's SubtitleStyleTable, 0 for
+// formats without styles.
 class SubtitleItem {
 public:
     SubtitleItem();
-    SubtitleItem(QTime showTimestamp, QTime hideTimestamp, QString subtitle);
+    SubtitleItem(qint64 showTime, qint64 hideTime, QString subtitle);
 private:
-    QTime ShowTimestamp;
-    QTime HideTimestamp;
+    quint64 Id = 0;
+    qint64 ShowTime = 0;
+    qint64 HideTime = 0;
+    int Style = 0;
     QString Subtitle;
 public:
-    void setShowTimestamp(QTime time);
-    void setHideTimestamp(QTime time);
+    void setId(quint64 id);
+    void setShowTime(qint64 ms);
+    void setHideTime(qint64 ms);
+    void setStyle(int style);
     void setSubtitle(QString value);
 
-    QTime getShowTimestamp() const { return ShowTimestamp; }
-    QTime getHideTimestamp() const { return HideTimestamp; }
-    QString getSubtitle() const { return Subtitle; }
+    quint64 getId() const { return Id; }
+    qint64 getShowTime() const { return ShowTime; }
+    qint64 getHideTime() const { return HideTime; }
+    qint64 getDuration() const { return HideTime - ShowTime; }
+    int getStyle() const { return Style; }
+    const QString &getSubtitle() const { return Subtitle; }
+
+    // "hh:mm:ss,zzz", hours keep counting past 24 and negative times get a '-'
+    static QString FormatTime(qint64 ms, char separator = ',');
+    // Same, written to out which needs room for MaxTimeLength chars.
+    // Returns how many were written.
+    static int FormatTime(qint64 ms, char separator, char *out);
+    static const int MaxTimeLength = 32;
 
     static bool SortByShowTime(const SubtitleItem &s1, const SubtitleItem &s2);
 
     friend bool operator==(const SubtitleItem& lhs, const SubtitleItem& rhs);
 };
+
+Q_DECLARE_METATYPE(SubtitleItem)
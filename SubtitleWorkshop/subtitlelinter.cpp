@@ -0,0 +1,362 @@
+#include "subtitlelinter.h"
+
+#include <limits>
+
+#include <QPair>
+#include <QThreadPool>
+#include <QtConcurrent>
+
+namespace {
+
+// Below this many rows the checks run on the calling thread
+const int ParallelThreshold = 8192;
+
+// Running maximum before the first cue
+const qint64 NoTime = std::numeric_limits<qint64>::min();
+
+// The tags SubTextToggleTag puts around a selection
+const char FormatTags[] = { 'b', 'i', 'u', 's' };
+const int FormatTagCount = 4;
+
+// Index into FormatTags of the tag in text[first, last), -1 if it is any
+// other tag. closing is set for </x>.
+int FormatTag(const QChar *text, int first, int last, bool &closing) {
+    closing = first < last && text[first] == '/';
+    if (closing) first++;
+
+    if (last - first != 1)
+        return -1;
+
+    char Name = char(text[first].toLower().unicode());
+    for (int i = 0; i < FormatTagCount; i++) {
+        if (FormatTags[i] == Name) return i;
+    }
+
+    return -1;
+}
+
+}
+
+SubtitleLinter::SubtitleLinter(const SubtitleStore *subtitles) : Subtitles(subtitles) {}
+
+void SubtitleLinter::setLimits(const Limits &limits) {
+    Rules = limits;
+    Invalidate();
+}
+
+void SubtitleLinter::Invalidate() {
+    isDirty = true;
+}
+
+void SubtitleLinter::RowsInserted(int first, int last) {
+    if (isDirty)
+        return;
+
+    RowProblems.insert(first, last - first + 1, NoProblem);
+    MaxEnds.insert(first, last - first + 1, NoTime);
+
+    int Changed = UpdateEnds(first, last);
+    Recheck(first - 1, qMax(last, Changed) + 1);
+}
+
+void SubtitleLinter::RowsRemoved(int first, int last) {
+    if (isDirty)
+        return;
+
+    RowProblems.remove(first, last - first + 1);
+    MaxEnds.remove(first, last - first + 1);
+
+    int Changed = UpdateEnds(first, first - 1);
+    Recheck(first - 1, qMax(first, Changed + 1));
+}
+
+void SubtitleLinter::RowMoved(int from, int to) {
+    if (isDirty)
+        return;
+
+    RowProblems.insert(to, RowProblems.takeAt(from));
+
+    // The cues on either side of the gap it left and of where it went, and
+    // every one the latest hide time before it changed for
+    int Changed = UpdateEnds(qMin(from, to), qMax(from, to));
+    Recheck(from - 1, from + 1);
+    Recheck(to - 1, to + 1);
+    Recheck(qMin(from, to), Changed + 1);
+}
+
+void SubtitleLinter::RowsChanged(int first, int last) {
+    if (isDirty)
+        return;
+
+    int Changed = UpdateEnds(first, last);
+    Recheck(first - 1, qMax(last, Changed) + 1);
+}
+
+SubtitleLinter::Problems SubtitleLinter::getProblems(int row) {
+    Update();
+
+    if (0 > row || row >= RowProblems.size())
+        return NoProblem;
+
+    return RowProblems.at(row);
+}
+
+int SubtitleLinter::getProblemCount() {
+    Update();
+
+    return int(RowProblems.size() - RowProblems.count(NoProblem));
+}
+
+QStringList SubtitleLinter::Describe(Problems problems) {
+    QStringList Result;
+
+    if (problems & NegativeStart)
+        Result.append("starts before 00:00:00,000");
+    if (problems & BadDuration)
+        Result.append("zero or negative duration");
+    if (problems & OutOfOrder)
+        Result.append("out of order");
+    if (problems & Overlap)
+        Result.append("overlaps another cue");
+    if (problems & ShortGap)
+        Result.append("too close to another cue");
+    if (problems & ReadingSpeed)
+        Result.append("too many characters per second");
+    if (problems & LineLength)
+        Result.append("line too long");
+    if (problems & UnbalancedTags)
+        Result.append("unbalanced <b>/<i>/<u>/<s> tags");
+    if (problems & EmptyText)
+        Result.append("empty text");
+
+    return Result;
+}
+
+QVector<SubtitleLinter::Problems> SubtitleLinter::Lint(const SubtitleStore &store) {
+    return Lint(store, Limits());
+}
+
+QVector<SubtitleLinter::Problems> SubtitleLinter::Lint(const SubtitleStore &store, const Limits &limits) {
+    QVector<Problems> Result(store.size(), NoProblem);
+    QVector<qint64> Ends = RunningEnds(store);
+    CheckRange(store, limits, Ends.constData(), 0, store.size() - 1, Result.data());
+    return Result;
+}
+
+void SubtitleLinter::Update() {
+    // The store changed without being reported, start over rather than
+    // hand out results of the wrong rows
+    if (RowProblems.size() != Subtitles->size()) {
+        isDirty = true;
+    }
+
+    if (!isDirty)
+        return;
+
+    RowProblems.fill(NoProblem, Subtitles->size());
+    MaxEnds = RunningEnds(*Subtitles);
+    CheckRange(*Subtitles, Rules, MaxEnds.constData(), 0, Subtitles->size() - 1, RowProblems.data());
+
+    isDirty = false;
+}
+
+int SubtitleLinter::UpdateEnds(int first, int last) {
+    if (MaxEnds.size() != Subtitles->size()) {
+        isDirty = true;
+        return last;
+    }
+
+    const SubtitleStyleTable &Styles = Subtitles->getStyles();
+
+    first = qMax(first, 0);
+    qint64 maxEnd = first > 0 ? MaxEnds.at(first - 1) : NoTime;
+
+    int i = first;
+    for (; i < MaxEnds.size(); i++) {
+        if (!Styles.isComment(Subtitles->getStyle(i))) {
+            maxEnd = qMax(maxEnd, Subtitles->getHideTime(i));
+        }
+
+        // Past the changed rows every entry only depends on the one before,
+        // so once one comes out as it was the rest do too
+        if (i > last && MaxEnds.at(i) == maxEnd)
+            break;
+
+        MaxEnds[i] = maxEnd;
+    }
+
+    return i - 1;
+}
+
+QVector<qint64> SubtitleLinter::RunningEnds(const SubtitleStore &store) {
+    const SubtitleStyleTable &Styles = store.getStyles();
+
+    QVector<qint64> Result(store.size());
+    qint64 maxEnd = NoTime;
+
+    for (int i = 0; i < store.size(); i++) {
+        if (!Styles.isComment(store.getStyle(i))) {
+            maxEnd = qMax(maxEnd, store.getHideTime(i));
+        }
+
+        Result[i] = maxEnd;
+    }
+
+    return Result;
+}
+
+void SubtitleLinter::Recheck(int first, int last) {
+    if (isDirty)
+        return;
+
+    first = qMax(first, 0);
+    last = qMin(last, Subtitles->size() - 1);
+    if (first > last || RowProblems.size() != Subtitles->size() || MaxEnds.size() != Subtitles->size())
+        return;
+
+    CheckRange(*Subtitles, Rules, MaxEnds.constData(), first, last, RowProblems.data() + first);
+}
+
+void SubtitleLinter::CheckRange(const SubtitleStore &store, const Limits &limits, const qint64 *maxEnds, int first, int last, Problems *problems) {
+    int Count = last - first + 1;
+    if (Count <= 0)
+        return;
+
+    if (Count < ParallelThreshold) {
+        for (int row = first; row <= last; row++) {
+            problems[row - first] = Check(store, limits, maxEnds, row);
+        }
+
+        return;
+    }
+
+    // A few chunks per core, each writes its own part of problems
+    int ChunkSize = Count / (qMax(1, QThreadPool::globalInstance()->maxThreadCount()) * 4) + 1;
+
+    QVector<QPair<int, int>> Chunks;
+    for (int from = first; from <= last; from += ChunkSize) {
+        Chunks.append(qMakePair(from, qMin(from + ChunkSize - 1, last)));
+    }
+
+    QtConcurrent::blockingMap(Chunks, [&store, &limits, maxEnds, first, problems](const QPair<int, int> &chunk) {
+        for (int row = chunk.first; row <= chunk.second; row++) {
+            problems[row - first] = Check(store, limits, maxEnds, row);
+        }
+    });
+}
+
+SubtitleLinter::Problems SubtitleLinter::Check(const SubtitleStore &store, const Limits &limits, const qint64 *maxEnds, int row) {
+    const SubtitleStyleTable &Styles = store.getStyles();
+
+    // Comments never show, they can't break any rule
+    auto isComment = [&Styles, &store](int i) {
+        return Styles.isComment(store.getStyle(i));
+    };
+
+    if (isComment(row))
+        return NoProblem;
+
+    Problems Result = NoProblem;
+
+    qint64 ShowTime = store.getShowTime(row);
+    qint64 HideTime = store.getHideTime(row);
+
+    if (ShowTime < 0)
+        Result |= NegativeStart;
+
+    if (HideTime <= ShowTime)
+        Result |= BadDuration;
+
+    if (row > 0 && !isComment(row - 1) && store.getShowTime(row - 1) > ShowTime) {
+        Result |= OutOfOrder;
+    }
+    else if (row > 0 && maxEnds[row - 1] != NoTime) {
+        // Against every cue before, a long one may be many rows back
+        qint64 EarlierHideTime = maxEnds[row - 1];
+
+        if (EarlierHideTime > ShowTime)
+            Result |= Overlap;
+        else if (ShowTime - EarlierHideTime < limits.MinGap)
+            Result |= ShortGap;
+    }
+
+    if (row + 1 < store.size() && !isComment(row + 1)) {
+        qint64 NextShowTime = store.getShowTime(row + 1);
+
+        if (NextShowTime < ShowTime)
+            Result |= OutOfOrder;
+        else if (HideTime > NextShowTime)
+            Result |= Overlap;
+        else if (NextShowTime - HideTime < limits.MinGap)
+            Result |= ShortGap;
+    }
+
+    // One pass over the text: what is visible of it, without markup, and
+    // how the format tags nest
+    const QChar *Text = store.getSubtitleData(row);
+    int Length = store.getSubtitleLength(row);
+
+    int Visible = 0, LineChars = 0, LongestLine = 0;
+    bool hasText = false;
+    int Depths[FormatTagCount] = {};
+    bool Unbalanced = false;
+
+    for (int i = 0; i < Length; i++) {
+        QChar c = Text[i];
+
+        if (c == '<' || c == '{') {
+            QChar End = c == '<' ? '>' : '}';
+            int j = i + 1;
+            while (j < Length && Text[j] != End && Text[j] != '\n') j++;
+
+            if (j < Length && Text[j] == End) {
+                bool closing;
+                int Tag = c == '<' ? FormatTag(Text, i + 1, j, closing) : -1;
+                if (Tag >= 0) {
+                    Depths[Tag] += closing ? -1 : 1;
+                    Unbalanced |= Depths[Tag] < 0;
+                }
+
+                i = j;
+                continue;
+            }
+        }
+
+        // Script line breaks are written as \N or \n
+        bool isBreak = c == '\n' || (c == '\\' && i + 1 < Length && (Text[i + 1] == 'N' || Text[i + 1] == 'n'));
+        if (isBreak) {
+            if (c == '\\') i++;
+
+            LongestLine = qMax(LongestLine, LineChars);
+            LineChars = 0;
+            continue;
+        }
+
+        if (c == '\r')
+            continue;
+
+        Visible++;
+        LineChars++;
+        hasText |= !c.isSpace();
+    }
+
+    LongestLine = qMax(LongestLine, LineChars);
+
+    for (int i = 0; i < FormatTagCount; i++) {
+        Unbalanced |= Depths[i] != 0;
+    }
+
+    if (!hasText)
+        Result |= EmptyText;
+
+    if (LongestLine > limits.MaxLineLength)
+        Result |= LineLength;
+
+    if (Unbalanced)
+        Result |= UnbalancedTags;
+
+    if (HideTime > ShowTime && Visible * 1000.0 / (HideTime - ShowTime) > limits.MaxCharactersPerSecond)
+        Result |= ReadingSpeed;
+
+    return Result;
+}
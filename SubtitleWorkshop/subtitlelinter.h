@@ -0,0 +1,85 @@
+#pragma once
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include "subtitlestore.h"
+
+// Checks the cues of a subtitle store against timing and reading speed
+// rules. Every check only looks at a cue, its neighbours and the latest
+// hide time of the cues before it, which is kept as a running maximum
+// like SubtitleTimeline's. A change to some rows is re-checked there and
+// as far on as that maximum changed, and a full run is split into chunks
+// over the thread pool.
+//
+// The results follow the store row by row. Whoever changes the store
+// reports it through RowsInserted/RowsRemoved/RowMoved/RowsChanged, or
+// Invalidate for anything bigger, like the table model's signals.
+class SubtitleLinter {
+public:
+    enum Problem : quint32 {
+        NoProblem = 0,
+        Overlap = 1 << 0,
+        ShortGap = 1 << 1,
+        BadDuration = 1 << 2,
+        NegativeStart = 1 << 3,
+        OutOfOrder = 1 << 4,
+        ReadingSpeed = 1 << 5,
+        LineLength = 1 << 6,
+        UnbalancedTags = 1 << 7,
+        EmptyText = 1 << 8
+    };
+    typedef quint32 Problems;
+
+    struct Limits {
+        double MaxCharactersPerSecond = 20.0;
+        int MaxLineLength = 42;
+        // Between one cue hiding and the next showing, two frames at 24 fps
+        qint64 MinGap = 84;
+    };
+
+    // Checked against the default limits until setLimits
+    SubtitleLinter(const SubtitleStore *subtitles);
+
+    const Limits &getLimits() const { return Rules; }
+    void setLimits(const Limits &limits);
+
+    // Everything is checked again on next lookup
+    void Invalidate();
+    void RowsInserted(int first, int last);
+    void RowsRemoved(int first, int last);
+    void RowMoved(int from, int to);
+    void RowsChanged(int first, int last);
+
+    Problems getProblems(int row);
+    // Number of cues with any problem
+    int getProblemCount();
+
+    // One line per problem, e.g. for a tooltip
+    static QStringList Describe(Problems problems);
+
+    // Checks every cue of store at once
+    static QVector<Problems> Lint(const SubtitleStore &store);
+    static QVector<Problems> Lint(const SubtitleStore &store, const Limits &limits);
+
+private:
+    const SubtitleStore *Subtitles;
+    Limits Rules;
+
+    bool isDirty = true;
+    QVector<Problems> RowProblems;
+    // Latest hide time of the cues up to each row, comments left out
+    QVector<qint64> MaxEnds;
+
+    void Update();
+    // Recomputes MaxEnds from first on, at least up to last, and returns
+    // the last row whose entry may have changed
+    int UpdateEnds(int first, int last);
+    // Re-checks rows [first, last], clamped to the store
+    void Recheck(int first, int last);
+
+    static QVector<qint64> RunningEnds(const SubtitleStore &store);
+    static void CheckRange(const SubtitleStore &store, const Limits &limits, const qint64 *maxEnds, int first, int last, Problems *problems);
+    static Problems Check(const SubtitleStore &store, const Limits &limits, const qint64 *maxEnds, int row);
+};
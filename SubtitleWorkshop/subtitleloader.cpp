@@ -0,0 +1,34 @@
+#include "subtitleloader.h"
+
+SubtitleLoader::SubtitleLoader(const QString &filepath, const SubtitleFormat *format, int loadId) : FilePath(filepath), Format(format), LoadId(loadId), Cancelled(false) {}
+
+void SubtitleLoader::Cancel() {
+    Cancelled = true;
+}
+
+void SubtitleLoader::Run() {
+    bool success = Format->Read(FilePath, BatchSize, [this](QList<SubtitleItem> &batch, qint64 bytesRead, qint64 bytesTotal) {
+        if (Cancelled) {
+            return false;
+        }
+
+        if (Styles.hasScript() && Styles.size() != StylesSent) {
+            StylesSent = Styles.size();
+            emit StylesLoaded(LoadId, Styles);
+        }
+
+        if (!batch.isEmpty()) {
+            emit BatchLoaded(LoadId, batch);
+        }
+
+        int percent = bytesTotal > 0 ? int(bytesRead * 100 / bytesTotal) : 100;
+        if (percent != Progress) {
+            Progress = percent;
+            emit ProgressChanged(LoadId, percent);
+        }
+
+        return !Cancelled;
+    }, &Styles, &Encoding);
+
+    emit Finished(LoadId, success && !Cancelled);
+}
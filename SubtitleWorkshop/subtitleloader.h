@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+
+#include <QObject>
+
+#include "formatregistry.h"
+
+// Parses a subtitle file on whatever thread it lives in and streams the
+// cues back in batches, so the table fills in while the rest is parsed.
+// Every signal carries the loadId it was made with: a loader that was
+// cancelled can still have some queued after it is gone, and a new one
+// may take its address, so the sender alone doesn't tell them apart.
+class SubtitleLoader : public QObject {
+    Q_OBJECT
+
+public:
+    SubtitleLoader(const QString &filepath, const SubtitleFormat *format, int loadId);
+
+    // Safe to call from any thread
+    void Cancel();
+
+    // Styles of an ASS/SSA file, complete once Finished is emitted
+    const SubtitleStyleTable &getStyles() const { return Styles; }
+    // Encoding of the file, likewise
+    const TextEncoding &getEncoding() const { return Encoding; }
+
+    static const int BatchSize = 2000;
+
+public slots:
+    void Run();
+
+signals:
+    // Sent before a batch whenever a script's styles have grown, so its
+    // cues can be shown as the script while the rest loads
+    void StylesLoaded(int loadId, const SubtitleStyleTable &styles);
+    void BatchLoaded(int loadId, const QList<SubtitleItem> &batch);
+    void ProgressChanged(int loadId, int percent);
+    void Finished(int loadId, bool success);
+
+private:
+    QString FilePath;
+    const SubtitleFormat *Format;
+    int LoadId;
+    SubtitleStyleTable Styles;
+    TextEncoding Encoding;
+
+    std::atomic<bool> Cancelled;
+    int Progress = -1;
+    int StylesSent = 0;
+};
@@ -0,0 +1,362 @@
+#include "subtitlesearch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <numeric>
+
+#include <QPair>
+#include <QThreadPool>
+#include <QtConcurrent>
+
+namespace {
+
+// Below this many rows to look at splitting them up costs more than it saves
+const int ParallelThreshold = 4096;
+// Enough chunks per core that a few slow ones don't hold up the rest
+const int ChunksPerThread = 4;
+
+// The text of row in place, only valid until the store changes
+inline QString TextAt(const SubtitleStore *subtitles, int row) {
+    return QString::fromRawData(subtitles->getSubtitleData(row), subtitles->getSubtitleLength(row));
+}
+
+// Runs work(row, results) for every row on all cores and joins the results
+// in the order of rows. With a limit each chunk stops once it has that
+// many, and chunks after one that got there are skipped.
+template<typename T, typename Work>
+QVector<T> MapChunks(const QVector<int> &rows, const Work &work, int limit = -1) {
+    int Threads = qMax(1, QThreadPool::globalInstance()->maxThreadCount());
+    int ChunkSize = qMax(256, rows.size() / (Threads * ChunksPerThread) + 1);
+
+    QVector<QPair<int, int>> Chunks;
+    for (int first = 0; first < rows.size(); first += ChunkSize) {
+        Chunks.append(qMakePair(first, qMin(first + ChunkSize, rows.size())));
+    }
+
+    // First row of the earliest chunk that reached the limit
+    std::atomic<int> Enough(rows.size());
+
+    QList<QVector<T>> Results = QtConcurrent::blockingMapped<QList<QVector<T>>>(Chunks, [&rows, &work, limit, &Enough](const QPair<int, int> &chunk) {
+        QVector<T> Result;
+        for (int i = chunk.first; i < chunk.second && chunk.first < Enough; i++) {
+            work(rows.at(i), Result);
+
+            if (limit >= 0 && Result.size() >= limit) {
+                int Current = Enough;
+                while (chunk.first < Current && !Enough.compare_exchange_weak(Current, chunk.first)) {}
+                break;
+            }
+        }
+
+        return Result;
+    });
+
+    QVector<T> Joined;
+    for (const QVector<T> &result : Results) {
+        Joined += result;
+        if (limit >= 0 && Joined.size() >= limit)
+            break;
+    }
+
+    if (limit >= 0 && Joined.size() > limit) {
+        Joined.resize(limit);
+    }
+
+    return Joined;
+}
+
+void FindIn(const QString &text, int row, const SubtitleSearch::Query &query, const QRegularExpression &pattern, QVector<SubtitleSearch::Hit> &hits) {
+    if (query.Type == SubtitleSearch::Substring) {
+        int From = 0;
+        while ((From = text.indexOf(query.Text, From, query.Case)) >= 0) {
+            hits.append({ row, From, query.Text.size() });
+            From += query.Text.size();
+        }
+
+        return;
+    }
+
+    QRegularExpressionMatchIterator Matches = pattern.globalMatch(text);
+    while (Matches.hasNext()) {
+        QRegularExpressionMatch Match = Matches.next();
+        hits.append({ row, Match.capturedStart(), Match.capturedLength() });
+    }
+}
+
+QString ReplaceIn(QString text, const SubtitleSearch::Query &query, const QRegularExpression &pattern, const QString &after) {
+    switch (query.Type) {
+        case SubtitleSearch::Substring:
+            return text.replace(query.Text, after, query.Case);
+        case SubtitleSearch::RegularExpression:
+            return text.replace(pattern, after);
+        case SubtitleSearch::WholeWord:
+            break;
+    }
+
+    // Whole words are matched with a pattern but replaced literally, a
+    // backslash in after is just a backslash
+    QString Result;
+    int Last = 0;
+
+    QRegularExpressionMatchIterator Matches = pattern.globalMatch(text);
+    while (Matches.hasNext()) {
+        QRegularExpressionMatch Match = Matches.next();
+        Result += text.midRef(Last, Match.capturedStart() - Last);
+        Result += after;
+        Last = Match.capturedEnd();
+    }
+
+    Result += text.midRef(Last);
+    return Result;
+}
+
+}
+
+SubtitleSearch::SubtitleSearch(const SubtitleStore *subtitles) : Subtitles(subtitles) {}
+
+void SubtitleSearch::Invalidate(quint64 id) {
+    // A pending rebuild picks the change up anyway
+    if (!isDirty) {
+        DirtyIds.insert(id);
+    }
+}
+
+void SubtitleSearch::InvalidateAll() {
+    isDirty = true;
+    DirtyIds.clear();
+}
+
+bool SubtitleSearch::isValid(const Query &query, QString *error) {
+    if (query.Text.isEmpty()) {
+        if (error) *error = "Nothing to search for";
+        return false;
+    }
+
+    if (query.Type != Substring) {
+        QRegularExpression Re = Pattern(query);
+        if (!Re.isValid()) {
+            if (error) *error = Re.errorString();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+QVector<SubtitleSearch::Hit> SubtitleSearch::Find(const Query &query, int limit) {
+    QVector<Hit> Hits;
+    if (!isValid(query) || limit == 0)
+        return Hits;
+
+    Update();
+
+    QVector<int> Rows = Candidates(query);
+
+    // Compiled once here rather than by the first match on every thread
+    QRegularExpression Re = Pattern(query);
+    Re.optimize();
+
+    auto Work = [this, &query, &Re](int row, QVector<Hit> &hits) {
+        FindIn(TextAt(Subtitles, row), row, query, Re, hits);
+    };
+
+    if (Rows.size() < ParallelThreshold) {
+        for (int row : Rows) {
+            Work(row, Hits);
+            if (limit >= 0 && Hits.size() >= limit)
+                break;
+        }
+    }
+    else {
+        Hits = MapChunks<Hit>(Rows, Work, limit);
+    }
+
+    if (limit >= 0 && Hits.size() > limit) {
+        Hits.resize(limit);
+    }
+
+    return Hits;
+}
+
+QVector<SubtitleSearch::Replacement> SubtitleSearch::Replace(const Query &query, const QString &after) {
+    QVector<Replacement> Replacements;
+    if (!isValid(query))
+        return Replacements;
+
+    Update();
+
+    QVector<int> Rows = Candidates(query);
+
+    QRegularExpression Re = Pattern(query);
+    Re.optimize();
+
+    auto Work = [this, &query, &Re, &after](int row, QVector<Replacement> &replacements) {
+        QString Text = TextAt(Subtitles, row);
+        QString Replaced = ReplaceIn(Text, query, Re, after);
+
+        // Replacing a match with itself isn't a change
+        if (Replaced != Text) {
+            replacements.append({ row, Replaced });
+        }
+    };
+
+    if (Rows.size() < ParallelThreshold) {
+        for (int row : Rows) {
+            Work(row, Replacements);
+        }
+    }
+    else {
+        Replacements = MapChunks<Replacement>(Rows, Work);
+    }
+
+    return Replacements;
+}
+
+void SubtitleSearch::Update() {
+    // Past these it's cheaper to start over than to patch the index
+    if (DirtyIds.size() > Subtitles->size() / 4 || DeadSlots > SlotIds.size() / 2) {
+        isDirty = true;
+    }
+
+    if (isDirty) {
+        Rebuild();
+        return;
+    }
+
+    for (quint64 id : qAsConst(DirtyIds)) {
+        int Slot = IdSlots.value(id, -1);
+        if (Slot >= 0) {
+            SlotIds[Slot] = 0;
+            DeadSlots++;
+            IdSlots.remove(id);
+        }
+
+        // Removed cues are gone for good
+        int row = Subtitles->indexOfId(id);
+        if (row >= 0) {
+            IndexCue(id, Subtitles->getSubtitleData(row), Subtitles->getSubtitleLength(row));
+        }
+    }
+
+    DirtyIds.clear();
+}
+
+void SubtitleSearch::Rebuild() {
+    SlotIds.clear();
+    IdSlots.clear();
+    Postings.clear();
+    DeadSlots = 0;
+    DirtyIds.clear();
+
+    SlotIds.reserve(Subtitles->size());
+    IdSlots.reserve(Subtitles->size());
+
+    for (int i = 0; i < Subtitles->size(); i++) {
+        IndexCue(Subtitles->getId(i), Subtitles->getSubtitleData(i), Subtitles->getSubtitleLength(i));
+    }
+
+    isDirty = false;
+}
+
+void SubtitleSearch::IndexCue(quint64 id, const QChar *text, int length) {
+    int Slot = SlotIds.size();
+    SlotIds.append(id);
+    IdSlots.insert(id, Slot);
+
+    Grams.clear();
+    Trigrams(text, length, Grams);
+    std::sort(Grams.begin(), Grams.end());
+    Grams.erase(std::unique(Grams.begin(), Grams.end()), Grams.end());
+
+    for (quint64 gram : qAsConst(Grams)) {
+        Postings[gram].append(Slot);
+    }
+}
+
+QVector<int> SubtitleSearch::Candidates(const Query &query) {
+    QVector<int> Rows;
+
+    // Nothing to narrow the search down with, every cue is a candidate
+    if (query.Type == RegularExpression || query.Text.size() < 3) {
+        Rows.resize(Subtitles->size());
+        std::iota(Rows.begin(), Rows.end(), 0);
+        return Rows;
+    }
+
+    Grams.clear();
+    Trigrams(query.Text.constData(), query.Text.size(), Grams);
+    std::sort(Grams.begin(), Grams.end());
+    Grams.erase(std::unique(Grams.begin(), Grams.end()), Grams.end());
+
+    QVector<const QVector<int> *> Lists;
+    for (quint64 gram : qAsConst(Grams)) {
+        auto Posting = Postings.constFind(gram);
+        if (Posting == Postings.constEnd())
+            return Rows;
+
+        Lists.append(&Posting.value());
+    }
+
+    // Shortest first, the intersection only ever shrinks
+    std::sort(Lists.begin(), Lists.end(), [](const QVector<int> *a, const QVector<int> *b) {
+        return a->size() < b->size();
+    });
+
+    QVector<int> Slots = *Lists.first();
+    QVector<int> Common;
+    for (int i = 1; i < Lists.size() && !Slots.isEmpty(); i++) {
+        Common.clear();
+        std::set_intersection(Slots.constBegin(), Slots.constEnd(), Lists.at(i)->constBegin(), Lists.at(i)->constEnd(), std::back_inserter(Common));
+        Slots.swap(Common);
+    }
+
+    Rows.reserve(Slots.size());
+    for (int slot : qAsConst(Slots)) {
+        quint64 id = SlotIds.at(slot);
+        if (id == 0)
+            continue;
+
+        int row = Subtitles->indexOfId(id);
+        if (row >= 0) {
+            Rows.append(row);
+        }
+    }
+
+    std::sort(Rows.begin(), Rows.end());
+    return Rows;
+}
+
+QRegularExpression SubtitleSearch::Pattern(const Query &query) {
+    QRegularExpression::PatternOptions Options = QRegularExpression::UseUnicodePropertiesOption;
+    if (query.Case == Qt::CaseInsensitive) {
+        Options |= QRegularExpression::CaseInsensitiveOption;
+    }
+
+    switch (query.Type) {
+        case WholeWord:
+            // \b would also match inside a query that starts or ends with a non-word char
+            return QRegularExpression("(?<!\\w)" + QRegularExpression::escape(query.Text) + "(?!\\w)", Options);
+        case RegularExpression:
+            return QRegularExpression(query.Text, Options);
+        case Substring:
+            break;
+    }
+
+    return QRegularExpression();
+}
+
+void SubtitleSearch::Trigrams(const QChar *text, int length, QVector<quint64> &grams) {
+    if (length < 3)
+        return;
+
+    // Folded the same way case insensitive searches compare, so the index
+    // serves those and, as a superset, case sensitive ones
+    quint64 a = text[0].toCaseFolded().unicode();
+    quint64 b = text[1].toCaseFolded().unicode();
+    for (int i = 2; i < length; i++) {
+        quint64 c = text[i].toCaseFolded().unicode();
+        grams.append((a << 32) | (b << 16) | c);
+        a = b;
+        b = c;
+    }
+}
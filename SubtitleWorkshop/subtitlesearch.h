@@ -0,0 +1,88 @@
+#pragma once
+
+#include <QHash>
+#include <QRegularExpression>
+#include <QSet>
+#include <QString>
+#include <QVector>
+
+#include "subtitlestore.h"
+
+// Finds text in the cues of a subtitle store. Every trigram of every cue's
+// case folded text is indexed, so a plain or whole word search only looks
+// at the cues that hold all of the query's trigrams. Regular expressions
+// and queries shorter than a trigram scan every cue, split over all cores.
+//
+// Cues are indexed by id, so moving them around needs no update. Ones that
+// are added, removed or edited are marked with Invalidate and reindexed on
+// the next search.
+class SubtitleSearch {
+public:
+    enum MatchType {
+        Substring,
+        WholeWord,
+        RegularExpression
+    };
+
+    struct Query {
+        QString Text;
+        MatchType Type = Substring;
+        Qt::CaseSensitivity Case = Qt::CaseInsensitive;
+    };
+
+    // A match, Position and Length in the cue's text
+    struct Hit {
+        int Row;
+        int Position;
+        int Length;
+    };
+
+    // The text of a cue with its matches replaced
+    struct Replacement {
+        int Row;
+        QString Text;
+    };
+
+    SubtitleSearch(const SubtitleStore *subtitles);
+
+    // The cue with this id was added, removed or had its text changed
+    void Invalidate(quint64 id);
+    // Call after the store was replaced as a whole, the index is rebuilt on
+    // next search
+    void InvalidateAll();
+
+    // Whether query can be searched for, error says why not
+    static bool isValid(const Query &query, QString *error = nullptr);
+
+    // Matches in row order. Stops after limit of them unless limit is -1.
+    QVector<Hit> Find(const Query &query, int limit = -1);
+
+    // Every cue with a match, with the matches replaced by after. For
+    // regular expressions after can refer to captures as \1, \2...
+    QVector<Replacement> Replace(const Query &query, const QString &after);
+
+private:
+    const SubtitleStore *Subtitles;
+    bool isDirty = true;
+    QSet<quint64> DirtyIds;
+
+    // Each indexed cue takes the next slot, so posting lists are sorted by
+    // slot and intersect in one pass. A reindexed cue gets a new slot and
+    // leaves its old one dead, with id 0, until the next rebuild.
+    QVector<quint64> SlotIds;
+    QHash<quint64, int> IdSlots;
+    QHash<quint64, QVector<int>> Postings;
+    int DeadSlots = 0;
+
+    QVector<quint64> Grams;
+
+    void Update();
+    void Rebuild();
+    void IndexCue(quint64 id, const QChar *text, int length);
+
+    // Rows that can hold a match, in order
+    QVector<int> Candidates(const Query &query);
+
+    static QRegularExpression Pattern(const Query &query);
+    static void Trigrams(const QChar *text, int length, QVector<quint64> &grams);
+};
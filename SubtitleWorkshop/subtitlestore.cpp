@@ -0,0 +1,312 @@
+#include "subtitlestore.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace {
+
+template <typename T>
+QVector<T> Permuted(const QVector<T> &values, const QVector<int> &order) {
+    QVector<T> Result(order.size());
+    for (int i = 0; i < order.size(); i++) {
+        Result[i] = values.at(order.at(i));
+    }
+
+    return Result;
+}
+
+}
+
+SubtitleStore::SubtitleStore() {}
+
+QString SubtitleStore::getSubtitle(int row) const {
+    return Texts.mid(TextOffsets.at(row), TextLengths.at(row));
+}
+
+SubtitleItem SubtitleStore::at(int row) const {
+    SubtitleItem Item(ShowTimes.at(row), HideTimes.at(row), getSubtitle(row));
+    Item.setId(Ids.at(row));
+    Item.setStyle(StyleIndices.at(row));
+    return Item;
+}
+
+void SubtitleStore::setStyles(const SubtitleStyleTable &styles) {
+    StyleTable = styles;
+}
+
+void SubtitleStore::setEncoding(const TextEncoding &encoding) {
+    Encoding = encoding;
+}
+
+void SubtitleStore::reserve(int count) {
+    Ids.reserve(count);
+    ShowTimes.reserve(count);
+    HideTimes.reserve(count);
+    StyleIndices.reserve(count);
+    TextOffsets.reserve(count);
+    TextLengths.reserve(count);
+}
+
+void SubtitleStore::append(const SubtitleItem &item) {
+    Ids.append(AssignId(item));
+    ShowTimes.append(item.getShowTime());
+    HideTimes.append(item.getHideTime());
+    StyleIndices.append(item.getStyle());
+    TextOffsets.append(AppendText(item.getSubtitle()));
+    TextLengths.append(item.getSubtitle().size());
+}
+
+void SubtitleStore::append(const QList<SubtitleItem> &items) {
+    reserve(size() + items.size());
+
+    for (const SubtitleItem &item : items) {
+        append(item);
+    }
+}
+
+void SubtitleStore::insert(int row, const SubtitleItem &item) {
+    Ids.insert(row, AssignId(item));
+    ShowTimes.insert(row, item.getShowTime());
+    HideTimes.insert(row, item.getHideTime());
+    StyleIndices.insert(row, item.getStyle());
+    TextOffsets.insert(row, AppendText(item.getSubtitle()));
+    TextLengths.insert(row, item.getSubtitle().size());
+}
+
+// The cue at row keeps its id
+void SubtitleStore::replace(int row, const SubtitleItem &item) {
+    if (IdsIndexed) {
+        IdShowTimes[Ids.at(row)] = item.getShowTime();
+    }
+
+    ShowTimes[row] = item.getShowTime();
+    HideTimes[row] = item.getHideTime();
+    StyleIndices[row] = item.getStyle();
+
+    if (getSubtitle(row) != item.getSubtitle()) {
+        ReleaseText(row);
+        TextOffsets[row] = AppendText(item.getSubtitle());
+        TextLengths[row] = item.getSubtitle().size();
+        CompactTexts();
+    }
+}
+
+void SubtitleStore::move(int from, int to) {
+    Ids.move(from, to);
+    ShowTimes.move(from, to);
+    HideTimes.move(from, to);
+    StyleIndices.move(from, to);
+    TextOffsets.move(from, to);
+    TextLengths.move(from, to);
+}
+
+void SubtitleStore::removeAt(int row) {
+    ReleaseText(row);
+    if (IdsIndexed) {
+        IdShowTimes.remove(Ids.at(row));
+    }
+
+    Ids.remove(row);
+    ShowTimes.remove(row);
+    HideTimes.remove(row);
+    StyleIndices.remove(row);
+    TextOffsets.remove(row);
+    TextLengths.remove(row);
+
+    CompactTexts();
+}
+
+void SubtitleStore::setTimes(int first, const QVector<qint64> &showTimes, const QVector<qint64> &hideTimes) {
+    std::copy(showTimes.constBegin(), showTimes.constEnd(), ShowTimes.begin() + first);
+    std::copy(hideTimes.constBegin(), hideTimes.constEnd(), HideTimes.begin() + first);
+
+    for (int i = first; IdsIndexed && i < first + showTimes.size(); i++) {
+        IdShowTimes[Ids.at(i)] = ShowTimes.at(i);
+    }
+}
+
+void SubtitleStore::shiftTimes(int first, int count, qint64 offset) {
+    qint64 *show = ShowTimes.data() + first;
+    qint64 *hide = HideTimes.data() + first;
+
+    for (int i = 0; i < count; i++) {
+        show[i] += offset;
+        hide[i] += offset;
+    }
+
+    for (int i = first; IdsIndexed && i < first + count; i++) {
+        IdShowTimes[Ids.at(i)] = ShowTimes.at(i);
+    }
+}
+
+void SubtitleStore::clear() {
+    Ids.clear();
+    IdShowTimes.clear();
+    IdsIndexed = true;
+    NextId = 1;
+    ShowTimes.clear();
+    HideTimes.clear();
+    StyleIndices.clear();
+    StyleTable.clear();
+    Encoding = TextEncoding();
+    TextOffsets.clear();
+    TextLengths.clear();
+
+    Texts.clear();
+    UnusedText = 0;
+    Backing.reset();
+}
+
+void SubtitleStore::assign(int count, const quint64 *ids, const qint64 *showTimes, const qint64 *hideTimes, const qint32 *styles,
+                           const qint32 *textOffsets, const qint32 *textLengths, const QChar *texts, int textLength,
+                           const QSharedPointer<QFile> &backing) {
+    clear();
+
+    // Block copies, only the text is worth borrowing
+    Ids = QVector<quint64>(ids, ids + count);
+    ShowTimes = QVector<qint64>(showTimes, showTimes + count);
+    HideTimes = QVector<qint64>(hideTimes, hideTimes + count);
+    StyleIndices = QVector<int>(styles, styles + count);
+    TextOffsets = QVector<int>(textOffsets, textOffsets + count);
+    TextLengths = QVector<int>(textLengths, textLengths + count);
+
+    Texts = backing ? QString::fromRawData(texts, textLength) : QString(texts, textLength);
+    Backing = backing;
+
+    IdsIndexed = false;
+}
+
+void SubtitleStore::detach() {
+    if (!Backing)
+        return;
+
+    Texts = QString(Texts.constData(), Texts.size());
+    Backing.reset();
+}
+
+int SubtitleStore::insertPosition(qint64 showTime) const {
+    return int(std::upper_bound(ShowTimes.constBegin(), ShowTimes.constEnd(), showTime) - ShowTimes.constBegin());
+}
+
+int SubtitleStore::sortedPosition(int row, qint64 showTime) const {
+    // Most edits keep a cue in order with its neighbours
+    bool afterPrevious = row == 0 || ShowTimes.at(row - 1) <= showTime;
+    bool beforeNext = row == size() - 1 || showTime <= ShowTimes.at(row + 1);
+    if (afterPrevious && beforeNext)
+        return row;
+
+    // Position among the other rows, this one is still counted by the search
+    int position = insertPosition(showTime);
+    return position > row ? position - 1 : position;
+}
+
+int SubtitleStore::indexOfId(quint64 id) const {
+    IndexIds();
+
+    auto ShowTime = IdShowTimes.constFind(id);
+    if (ShowTime == IdShowTimes.constEnd())
+        return -1;
+
+    // The cue is among the ones showing at the same time. Only a store that
+    // isn't sorted yet (e.g. mid-load) can miss here.
+    int i = int(std::lower_bound(ShowTimes.constBegin(), ShowTimes.constEnd(), ShowTime.value()) - ShowTimes.constBegin());
+    for (; i < size() && ShowTimes.at(i) == ShowTime.value(); i++) {
+        if (Ids.at(i) == id)
+            return i;
+    }
+
+    return Ids.indexOf(id);
+}
+
+bool SubtitleStore::isSorted() const {
+    return std::is_sorted(ShowTimes.constBegin(), ShowTimes.constEnd());
+}
+
+QVector<int> SubtitleStore::sort() {
+    if (isSorted())
+        return QVector<int>();
+
+    QVector<int> Order(size());
+    std::iota(Order.begin(), Order.end(), 0);
+    std::stable_sort(Order.begin(), Order.end(), [this](int a, int b) {
+        return ShowTimes.at(a) < ShowTimes.at(b);
+    });
+
+    Ids = Permuted(Ids, Order);
+    ShowTimes = Permuted(ShowTimes, Order);
+    HideTimes = Permuted(HideTimes, Order);
+    StyleIndices = Permuted(StyleIndices, Order);
+    TextOffsets = Permuted(TextOffsets, Order);
+    TextLengths = Permuted(TextLengths, Order);
+
+    return Order;
+}
+
+QList<SubtitleItem> SubtitleStore::toList() const {
+    QList<SubtitleItem> Result;
+    Result.reserve(size());
+
+    for (int i = 0; i < size(); i++) {
+        Result.append(at(i));
+    }
+
+    return Result;
+}
+
+void SubtitleStore::IndexIds() const {
+    if (IdsIndexed)
+        return;
+
+    IdShowTimes.reserve(size());
+    for (int i = 0; i < size(); i++) {
+        IdShowTimes.insert(Ids.at(i), ShowTimes.at(i));
+        NextId = qMax(NextId, Ids.at(i) + 1);
+    }
+
+    IdsIndexed = true;
+}
+
+quint64 SubtitleStore::AssignId(const SubtitleItem &item) {
+    IndexIds();
+
+    quint64 id = item.getId();
+    if (id == 0 || IdShowTimes.contains(id)) {
+        id = NextId++;
+    }
+    else {
+        NextId = qMax(NextId, id + 1);
+    }
+
+    IdShowTimes.insert(id, item.getShowTime());
+    return id;
+}
+
+int SubtitleStore::AppendText(const QString &text) {
+    // Borrowed text gets copied by the append, the file isn't needed after
+    int offset = Texts.size();
+    Texts.append(text);
+    Backing.reset();
+    return offset;
+}
+
+void SubtitleStore::ReleaseText(int row) {
+    UnusedText += TextLengths.at(row);
+}
+
+void SubtitleStore::CompactTexts() {
+    if (UnusedText < 4096 || UnusedText * 2 < Texts.size())
+        return;
+
+    QString Compacted;
+    Compacted.reserve(Texts.size() - UnusedText);
+
+    for (int i = 0; i < size(); i++) {
+        int offset = Compacted.size();
+        Compacted.append(Texts.midRef(TextOffsets.at(i), TextLengths.at(i)));
+        TextOffsets[i] = offset;
+    }
+
+    Texts = Compacted;
+    UnusedText = 0;
+    Backing.reset();
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <QFile>
+#include <QHash>
+#include <QList>
+#include <QSharedPointer>
+#include <QString>
+#include <QVector>
+
+#include "subtitleitem.h"
+#include "subtitlestyletable.h"
+#include "textencoding.h"
+
+// The cues of a document kept as parallel arrays: show times, hide times
+// and the text of every cue packed into one string. Sorting, searching and
+// bulk timing changes only ever walk the contiguous time arrays.
+//
+// Cues of styled formats (ASS/SSA) keep an index into the store's style
+// table, which is replaced as a whole when a file is loaded. So is the
+// encoding the file came in, which it is saved back in.
+//
+// Every cue gets a stable id when it is added. Cues that already carry one
+// (e.g. put back by undo) keep it.
+//
+// A store can also be handed its columns whole, e.g. from a mapped project
+// file, in which case the text is used where it lies until it is changed.
+class SubtitleStore {
+public:
+    SubtitleStore();
+
+    int size() const { return ShowTimes.size(); }
+    bool isEmpty() const { return ShowTimes.isEmpty(); }
+
+    quint64 getId(int row) const { return Ids.at(row); }
+    qint64 getShowTime(int row) const { return ShowTimes.at(row); }
+    qint64 getHideTime(int row) const { return HideTimes.at(row); }
+    int getStyle(int row) const { return StyleIndices.at(row); }
+    QString getSubtitle(int row) const;
+    // The text of row in place, without copying it out of the blob. Only
+    // valid until the store is next changed.
+    const QChar *getSubtitleData(int row) const { return Texts.constData() + TextOffsets.at(row); }
+    int getSubtitleLength(int row) const { return TextLengths.at(row); }
+    SubtitleItem at(int row) const;
+
+    const QVector<quint64> &getIds() const { return Ids; }
+    const QVector<qint64> &getShowTimes() const { return ShowTimes; }
+    const QVector<qint64> &getHideTimes() const { return HideTimes; }
+    const QVector<int> &getStyleIndices() const { return StyleIndices; }
+
+    const SubtitleStyleTable &getStyles() const { return StyleTable; }
+    void setStyles(const SubtitleStyleTable &styles);
+
+    const TextEncoding &getEncoding() const { return Encoding; }
+    void setEncoding(const TextEncoding &encoding);
+
+    void reserve(int count);
+    void append(const SubtitleItem &item);
+    void append(const QList<SubtitleItem> &items);
+    void insert(int row, const SubtitleItem &item);
+    void replace(int row, const SubtitleItem &item);
+    void move(int from, int to);
+    void removeAt(int row);
+    void clear();
+
+    // Replaces the cues with count rows of columns laid out the way the
+    // store keeps them. Row i's text is texts[textOffsets[i]] on for
+    // textLengths[i] chars, which have to be in range. With a backing file
+    // texts is borrowed rather than copied, and the file is kept open until
+    // the store no longer refers to it.
+    void assign(int count, const quint64 *ids, const qint64 *showTimes, const qint64 *hideTimes, const qint32 *styles,
+                const qint32 *textOffsets, const qint32 *textLengths, const QChar *texts, int textLength,
+                const QSharedPointer<QFile> &backing);
+    // Copies borrowed text into the store's own memory and lets go of its
+    // backing file, e.g. before the file gets overwritten
+    void detach();
+
+    // Retime rows [first, first + count) in one pass. The new times have to
+    // keep the rows in order, which any increasing transform does.
+    void setTimes(int first, const QVector<qint64> &showTimes, const QVector<qint64> &hideTimes);
+    void shiftTimes(int first, int count, qint64 offset);
+
+    // Row a cue with this show time goes to, after any that show at the same time
+    int insertPosition(qint64 showTime) const;
+    // Row the cue at row has to move to if its show time changes to showTime
+    int sortedPosition(int row, qint64 showTime) const;
+
+    // Row of the cue with this id, or -1
+    int indexOfId(quint64 id) const;
+
+    bool isSorted() const;
+    // Returns the old row of every new one, empty if nothing moved
+    QVector<int> sort();
+
+    QList<SubtitleItem> toList() const;
+
+private:
+    QVector<quint64> Ids;
+    QVector<qint64> ShowTimes;
+    QVector<qint64> HideTimes;
+    QVector<int> StyleIndices;
+    SubtitleStyleTable StyleTable;
+    TextEncoding Encoding;
+
+    // Text of row i is Texts.mid(TextOffsets[i], TextLengths[i]). Text of
+    // replaced and removed cues stays behind until it is half of the blob.
+    QString Texts;
+    QVector<int> TextOffsets;
+    QVector<int> TextLengths;
+    int UnusedText = 0;
+
+    // Mapped file the text is borrowed from, if any
+    QSharedPointer<QFile> Backing;
+
+    // Show time of every id, which narrows the search for its row down to
+    // the cues showing at that time. Built on first use after assign().
+    mutable QHash<quint64, qint64> IdShowTimes;
+    mutable bool IdsIndexed = true;
+    mutable quint64 NextId = 1;
+
+    void IndexIds() const;
+    quint64 AssignId(const SubtitleItem &item);
+    int AppendText(const QString &text);
+    void ReleaseText(int row);
+    void CompactTexts();
+};
@@ -0,0 +1,350 @@
+#include "subtitlestyletable.h"
+
+namespace {
+
+struct TextFormat {
+    bool Bold = false;
+    bool Italic = false;
+    bool Underline = false;
+    bool StrikeOut = false;
+
+    bool operator!=(const TextFormat &other) const {
+        return Bold != other.Bold || Italic != other.Italic || Underline != other.Underline || StrikeOut != other.StrikeOut;
+    }
+};
+
+TextFormat FormatOf(const SubtitleStyleTable::Style &style) {
+    TextFormat Format;
+    Format.Bold = style.Bold;
+    Format.Italic = style.Italic;
+    Format.Underline = style.Underline;
+    Format.StrikeOut = style.StrikeOut;
+    return Format;
+}
+
+// Reads tags like "i1", "b0" or "b700" into value. An empty argument goes
+// back to what the style says.
+bool ReadToggle(const QStringRef &tag, QChar name, bool base, bool &value) {
+    if (tag.isEmpty() || tag.at(0) != name)
+        return false;
+
+    QStringRef Argument = tag.mid(1);
+    for (QChar c : Argument) {
+        if (!c.isDigit())
+            return false;
+    }
+
+    if (Argument.isEmpty()) {
+        value = base;
+        return true;
+    }
+
+    // Bold also takes a font weight
+    int n = Argument.toInt();
+    value = name == 'b' ? (n == 1 || n >= 600) : n != 0;
+    return true;
+}
+
+// Walks a cue's text: text() gets every plain character, lineBreak() every
+// \N and \n, and tag() every tag of an override block without its
+// backslash. Braces that aren't closed are plain text.
+template <typename Text, typename LineBreak, typename Tag>
+void WalkOverrides(const QString &text, Text onText, LineBreak onLineBreak, Tag onTag) {
+    int i = 0;
+    int n = text.size();
+
+    while (i < n) {
+        QChar c = text.at(i);
+
+        if (c == '{') {
+            int close = text.indexOf('}', i + 1);
+            if (close < 0) {
+                onText(c);
+                i++;
+                continue;
+            }
+
+            // Anything before the first backslash is a comment. Tags like
+            // \t(\i1) carry backslashes inside their parentheses.
+            int j = text.indexOf('\\', i + 1);
+            while (j >= 0 && j < close) {
+                int k = j + 1;
+                int depth = 0;
+                while (k < close && (depth > 0 || text.at(k) != '\\')) {
+                    if (text.at(k) == '(') depth++;
+                    else if (text.at(k) == ')') depth--;
+                    k++;
+                }
+
+                onTag(text.midRef(j + 1, k - j - 1));
+                j = k;
+            }
+
+            i = close + 1;
+        }
+        else if (c == '\\' && i + 1 < n && (text.at(i + 1) == 'N' || text.at(i + 1) == 'n')) {
+            onLineBreak();
+            i += 2;
+        }
+        else if (c == '\\' && i + 1 < n && text.at(i + 1) == 'h') {
+            onText(QChar(0xA0));
+            i += 2;
+        }
+        else {
+            onText(c);
+            i++;
+        }
+    }
+}
+
+// Applies a tag to format, \r goes back to base (or the named style).
+// Drawing mode (\p1) draws shapes, its text isn't shown.
+void ApplyTag(const QStringRef &tag, const SubtitleStyleTable &table, const TextFormat &base, TextFormat &format, bool &drawing) {
+    if (tag.startsWith('r')) {
+        int style = table.indexOfStyle(tag.mid(1).toString());
+        format = style >= 0 ? FormatOf(table.getStyle(style)) : base;
+        return;
+    }
+
+    bool value;
+    if (ReadToggle(tag, 'p', false, value)) {
+        drawing = value;
+    }
+    else if (ReadToggle(tag, 'b', base.Bold, format.Bold)) {}
+    else if (ReadToggle(tag, 'i', base.Italic, format.Italic)) {}
+    else if (ReadToggle(tag, 'u', base.Underline, format.Underline)) {}
+    else if (ReadToggle(tag, 's', base.StrikeOut, format.StrikeOut)) {}
+}
+
+QString SpanFor(const TextFormat &format) {
+    QStringList Decorations;
+    if (format.Underline) Decorations.append("underline");
+    if (format.StrikeOut) Decorations.append("line-through");
+
+    return QString("<span style=\"font-weight:%1; font-style:%2; text-decoration:%3\">")
+            .arg(format.Bold ? "bold" : "normal")
+            .arg(format.Italic ? "italic" : "normal")
+            .arg(Decorations.isEmpty() ? "none" : Decorations.join(' '));
+}
+
+}
+
+SubtitleStyleTable::SubtitleStyleTable() {
+    clear();
+}
+
+void SubtitleStyleTable::setHeader(const QString &header) {
+    Header = header;
+}
+
+void SubtitleStyleTable::setEventFormat(const QString &format) {
+    EventFormat = format;
+
+    // SSA Dialogue lines begin with a Marked field instead of a layer
+    QString Fields = format.mid(format.indexOf(':') + 1).trimmed();
+    if (Fields.startsWith("Marked", Qt::CaseInsensitive)) {
+        EventStyle Default;
+        Default.Type = "Dialogue";
+        Default.Leading = "Marked=0,";
+        Default.Trailing = "Default,,0000,0000,0000,,";
+        setDefaultEvent(Default);
+    }
+}
+
+void SubtitleStyleTable::setFooter(const QString &footer) {
+    Footer = footer;
+}
+
+int SubtitleStyleTable::addStyle(const Style &style) {
+    // A later definition of the same name wins, like in the renderers
+    auto Existing = StyleIndex.constFind(style.Name);
+    if (Existing != StyleIndex.constEnd()) {
+        Styles[Existing.value()] = style;
+        return Existing.value();
+    }
+
+    Styles.append(style);
+    StyleIndex.insert(style.Name, Styles.size() - 1);
+    return Styles.size() - 1;
+}
+
+int SubtitleStyleTable::indexOfStyle(const QString &name) const {
+    return StyleIndex.value(name, -1);
+}
+
+int SubtitleStyleTable::intern(const EventStyle &event) {
+    QString Key = EventKey(event);
+
+    auto Existing = EventIndex.constFind(Key);
+    if (Existing != EventIndex.constEnd())
+        return Existing.value();
+
+    Events.append(event);
+    EventIndex.insert(Key, Events.size() - 1);
+    return Events.size() - 1;
+}
+
+const SubtitleStyleTable::EventStyle &SubtitleStyleTable::at(int index) const {
+    if (0 > index || index >= Events.size())
+        return Events.at(0);
+
+    return Events.at(index);
+}
+
+bool SubtitleStyleTable::isComment(int index) const {
+    return at(index).Type == "Comment";
+}
+
+void SubtitleStyleTable::clear() {
+    Header.clear();
+    EventFormat.clear();
+    Footer.clear();
+
+    Styles.clear();
+    StyleIndex.clear();
+
+    Events.clear();
+    EventIndex.clear();
+
+    EventStyle Default;
+    Default.Type = "Dialogue";
+    Default.Leading = "0,";
+    Default.Trailing = "Default,,0,0,0,,";
+    setDefaultEvent(Default);
+}
+
+QString SubtitleStyleTable::ToHtml(const QString &text, int index) const {
+    // The style is the first field after End in every event format
+    const QString &Trailing = at(index).Trailing;
+    int style = indexOfStyle(Trailing.left(Trailing.indexOf(',')));
+
+    TextFormat Base = style >= 0 ? FormatOf(Styles.at(style)) : TextFormat();
+    TextFormat Current = Base;
+    TextFormat Pending = Base;
+    bool Drawing = false;
+
+    QString Html = SpanFor(Current);
+    Html.reserve(Html.size() + text.size() + 32);
+
+    auto Flush = [&]() {
+        if (Pending != Current) {
+            Current = Pending;
+            Html.append("</span>").append(SpanFor(Current));
+        }
+    };
+
+    WalkOverrides(text, [&](QChar c) {
+        if (Drawing)
+            return;
+
+        Flush();
+        if (c == '<') Html.append("&lt;");
+        else if (c == '>') Html.append("&gt;");
+        else if (c == '&') Html.append("&amp;");
+        else Html.append(c);
+    }, [&]() {
+        Html.append("<br>");
+    }, [&](const QStringRef &tag) {
+        ApplyTag(tag, *this, Base, Pending, Drawing);
+    });
+
+    Html.append("</span>");
+    return Html;
+}
+
+QString SubtitleStyleTable::ToPlainText(const QString &text) {
+    // Most cues have no tags at all
+    if (!text.contains('{') && !text.contains('\\'))
+        return text;
+
+    bool Drawing = false;
+
+    QString Result;
+    Result.reserve(text.size());
+
+    WalkOverrides(text, [&](QChar c) {
+        if (!Drawing) {
+            Result.append(c);
+        }
+    }, [&]() {
+        Result.append('\n');
+    }, [&](const QStringRef &tag) {
+        bool value;
+        if (ReadToggle(tag, 'p', false, value)) {
+            Drawing = value;
+        }
+    });
+
+    return Result;
+}
+
+QString SubtitleStyleTable::ToSubRip(const QString &text) {
+    static const SubtitleStyleTable NoStyles;
+
+    TextFormat Current;
+    TextFormat Pending;
+    bool Drawing = false;
+
+    QString Result;
+    Result.reserve(text.size());
+
+    auto Toggle = [&Result](bool from, bool to, const char *tag) {
+        if (from != to) {
+            Result.append(to ? "<" : "</").append(tag).append('>');
+        }
+    };
+
+    auto Flush = [&]() {
+        Toggle(Current.Bold, Pending.Bold, "b");
+        Toggle(Current.Italic, Pending.Italic, "i");
+        Toggle(Current.Underline, Pending.Underline, "u");
+        Toggle(Current.StrikeOut, Pending.StrikeOut, "s");
+        Current = Pending;
+    };
+
+    WalkOverrides(text, [&](QChar c) {
+        if (Drawing)
+            return;
+
+        Flush();
+        Result.append(c);
+    }, [&]() {
+        Result.append('\n');
+    }, [&](const QStringRef &tag) {
+        ApplyTag(tag, NoStyles, TextFormat(), Pending, Drawing);
+    });
+
+    // Close whatever is still open
+    Pending = TextFormat();
+    Flush();
+
+    return Result;
+}
+
+QString SubtitleStyleTable::FromSubRip(const QString &text) {
+    QString Result = text;
+    Result.replace('\n', "\\N");
+
+    static const char *Tags[] = { "b", "i", "u", "s" };
+    for (const char *tag : Tags) {
+        Result.replace(QString("<") + tag + ">", QString("{\\") + tag + "1}", Qt::CaseInsensitive);
+        Result.replace(QString("</") + tag + ">", QString("{\\") + tag + "0}", Qt::CaseInsensitive);
+    }
+
+    return Result;
+}
+
+QString SubtitleStyleTable::EventKey(const EventStyle &event) {
+    return event.Type + '\n' + event.Leading + '\n' + event.Trailing;
+}
+
+void SubtitleStyleTable::setDefaultEvent(const EventStyle &event) {
+    if (Events.isEmpty()) {
+        intern(event);
+        return;
+    }
+
+    EventIndex.remove(EventKey(Events.at(0)));
+    Events[0] = event;
+    EventIndex.insert(EventKey(event), 0);
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <QHash>
+#include <QMetaType>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+// What an Advanced SubStation Alpha (.ass) or SubStation Alpha (.ssa)
+// script carries besides its cue times and text. The sections before
+// [Events] are kept as written so they go back out unchanged. Every event
+// line's attributes (layer, style, actor, margins, effect) go into a table
+// where each distinct combination is stored once, and cues only keep their
+// index into it.
+//
+// Override tags ({\i1}, \N, ...) stay in the cue text as they are and are
+// only looked at when a cue is rendered or converted.
+class SubtitleStyleTable {
+public:
+    // A style from the script's styles section, only what the overlay shows
+    struct Style {
+        QString Name;
+        bool Bold = false;
+        bool Italic = false;
+        bool Underline = false;
+        bool StrikeOut = false;
+    };
+
+    // An event line besides its times and text. Leading holds the fields
+    // before Start and Trailing the ones between End and Text, each with
+    // its trailing comma, e.g. "Dialogue", "0," and "Default,,0,0,0,,".
+    struct EventStyle {
+        QString Type;
+        QString Leading;
+        QString Trailing;
+    };
+
+    SubtitleStyleTable();
+
+    // Whether this came from a script, rather than being the empty default
+    bool hasScript() const { return !Header.isEmpty(); }
+
+    // Everything before the [Events] line, after its Format line and after
+    // the events (e.g. [Fonts])
+    const QString &getHeader() const { return Header; }
+    const QString &getEventFormat() const { return EventFormat; }
+    const QString &getFooter() const { return Footer; }
+    void setHeader(const QString &header);
+    // An SSA format (starting with Marked) gives the default event its
+    // Marked=0 field
+    void setEventFormat(const QString &format);
+    void setFooter(const QString &footer);
+
+    int addStyle(const Style &style);
+    int indexOfStyle(const QString &name) const;
+    const Style &getStyle(int index) const { return Styles.at(index); }
+    int styleCount() const { return Styles.size(); }
+
+    // Index of the event style, adding it if it is new. Index 0 is the
+    // default every cue starts with.
+    int intern(const EventStyle &event);
+    // Out of range indices (e.g. a cue of another document) give the default
+    const EventStyle &at(int index) const;
+    int size() const { return Events.size(); }
+
+    bool isComment(int index) const;
+
+    void clear();
+
+    // The cue's text as HTML for the overlay, starting from its style
+    QString ToHtml(const QString &text, int index) const;
+
+    // The text as the table shows it, without override blocks and with
+    // \N as line breaks
+    static QString ToPlainText(const QString &text);
+
+    // Override tags to and from the handful of SubRip/WebVTT tags, with
+    // \N and line breaks swapped. Everything else is dropped.
+    static QString ToSubRip(const QString &text);
+    static QString FromSubRip(const QString &text);
+
+private:
+    QString Header;
+    QString EventFormat;
+    QString Footer;
+
+    QVector<Style> Styles;
+    QHash<QString, int> StyleIndex;
+
+    QVector<EventStyle> Events;
+    QHash<QString, int> EventIndex;
+
+    static QString EventKey(const EventStyle &event);
+    void setDefaultEvent(const EventStyle &event);
+};
+
+Q_DECLARE_METATYPE(SubtitleStyleTable)
@@ -0,0 +1,193 @@
+#include "subtitletablemodel.h"
+
+#include <QApplication>
+#include <QColor>
+#include <QStyle>
+
+SubtitleTableModel::SubtitleTableModel(SubtitleStore *subtitles, QObject *parent) : QAbstractTableModel(parent), Subtitles(subtitles) {}
+
+int SubtitleTableModel::rowCount(const QModelIndex &parent) const {
+    return parent.isValid() ? 0 : Subtitles->size();
+}
+
+int SubtitleTableModel::columnCount(const QModelIndex &parent) const {
+    return parent.isValid() ? 0 : ColumnCount;
+}
+
+QVariant SubtitleTableModel::data(const QModelIndex &index, int role) const {
+    if (!index.isValid() || index.row() >= Subtitles->size())
+        return QVariant();
+
+    int row = index.row();
+    SubtitleLinter::Problems Problems = Linter && role != Qt::DisplayRole ? Linter->getProblems(row) : SubtitleLinter::NoProblem;
+
+    if (role == Qt::BackgroundRole)
+        return Problems ? QVariant(QColor(255, 228, 225)) : QVariant();
+
+    if (role != Qt::DisplayRole && role != Qt::ToolTipRole)
+        return QVariant();
+
+    QString Text;
+
+    switch (index.column()) {
+        case ShowColumn:
+            Text = SubtitleItem::FormatTime(Subtitles->getShowTime(row));
+            break;
+        case HideColumn:
+            Text = SubtitleItem::FormatTime(Subtitles->getHideTime(row));
+            break;
+        case SubtitleColumn:
+            // Scripts show their text without the override tags
+            if (role == Qt::DisplayRole && Subtitles->getStyles().hasScript())
+                Text = SubtitleStyleTable::ToPlainText(Subtitles->getSubtitle(row));
+            else
+                Text = Subtitles->getSubtitle(row);
+            break;
+        default:
+            return QVariant();
+    }
+
+    // The cell's own tooltip stays, a row with problems lists them below it
+    if (role == Qt::ToolTipRole && Problems)
+        Text += "\n\n" + SubtitleLinter::Describe(Problems).join("\n");
+
+    return Text;
+}
+
+QVariant SubtitleTableModel::headerData(int section, Qt::Orientation orientation, int role) const {
+    if (orientation == Qt::Vertical && Linter && (role == Qt::DecorationRole || role == Qt::ToolTipRole)) {
+        SubtitleLinter::Problems Problems = Linter->getProblems(section);
+        if (!Problems)
+            return QVariant();
+
+        if (role == Qt::DecorationRole)
+            return QApplication::style()->standardIcon(QStyle::SP_MessageBoxWarning);
+
+        return SubtitleLinter::Describe(Problems).join("\n");
+    }
+
+    if (role != Qt::DisplayRole)
+        return QVariant();
+
+    if (orientation == Qt::Vertical)
+        return section + 1;
+
+    switch (section) {
+        case ShowColumn:
+            return QString("Show");
+        case HideColumn:
+            return QString("Hide");
+        case SubtitleColumn:
+            return QString("Subtitle");
+    }
+
+    return QVariant();
+}
+
+void SubtitleTableModel::Append(const QList<SubtitleItem> &items) {
+    if (items.isEmpty())
+        return;
+
+    int first = Subtitles->size();
+
+    beginInsertRows(QModelIndex(), first, first + items.size() - 1);
+    Subtitles->append(items);
+    endInsertRows();
+}
+
+int SubtitleTableModel::Insert(const SubtitleItem &item) {
+    int row = Subtitles->insertPosition(item.getShowTime());
+
+    beginInsertRows(QModelIndex(), row, row);
+    Subtitles->insert(row, item);
+    endInsertRows();
+
+    return row;
+}
+
+int SubtitleTableModel::Replace(int row, const SubtitleItem &item) {
+    if (0 > row || row >= Subtitles->size())
+        return -1;
+
+    int target = Subtitles->sortedPosition(row, item.getShowTime());
+    if (target != row) {
+        // The destination is counted before the row is taken out
+        beginMoveRows(QModelIndex(), row, row, QModelIndex(), target > row ? target + 1 : target);
+        Subtitles->move(row, target);
+        endMoveRows();
+    }
+
+    Subtitles->replace(target, item);
+    emit dataChanged(index(target, 0), index(target, ColumnCount - 1));
+
+    return target;
+}
+
+void SubtitleTableModel::Remove(int row) {
+    if (0 > row || row >= Subtitles->size())
+        return;
+
+    beginRemoveRows(QModelIndex(), row, row);
+    Subtitles->removeAt(row);
+    endRemoveRows();
+}
+
+void SubtitleTableModel::SetTimes(int first, const QVector<qint64> &showTimes, const QVector<qint64> &hideTimes) {
+    if (showTimes.isEmpty())
+        return;
+
+    Subtitles->setTimes(first, showTimes, hideTimes);
+    emit dataChanged(index(first, ShowColumn), index(first + showTimes.size() - 1, HideColumn));
+}
+
+void SubtitleTableModel::ShiftTimes(int first, int count, qint64 offset) {
+    if (count <= 0)
+        return;
+
+    Subtitles->shiftTimes(first, count, offset);
+    emit dataChanged(index(first, ShowColumn), index(first + count - 1, HideColumn));
+}
+
+void SubtitleTableModel::ProblemsChanged() {
+    if (!Subtitles->isEmpty()) {
+        emit headerDataChanged(Qt::Vertical, 0, Subtitles->size() - 1);
+    }
+}
+
+void SubtitleTableModel::Clear() {
+    beginResetModel();
+    Subtitles->clear();
+    endResetModel();
+}
+
+void SubtitleTableModel::Reset(const SubtitleStore &subtitles) {
+    beginResetModel();
+    *Subtitles = subtitles;
+    endResetModel();
+}
+
+void SubtitleTableModel::Sort() {
+    emit layoutAboutToBeChanged();
+
+    QVector<int> Order = Subtitles->sort();
+
+    // Keep the selection and current index on the same cues
+    if (!Order.isEmpty()) {
+        QVector<int> NewRows(Order.size());
+        for (int i = 0; i < Order.size(); i++) {
+            NewRows[Order.at(i)] = i;
+        }
+
+        const QModelIndexList Persistent = persistentIndexList();
+        QModelIndexList Moved;
+        Moved.reserve(Persistent.size());
+
+        for (const QModelIndex &Index : Persistent) {
+            Moved.append(index(NewRows.at(Index.row()), Index.column()));
+        }
+
+        changePersistentIndexList(Persistent, Moved);
+    }
+
+    emit layoutChanged();
+}
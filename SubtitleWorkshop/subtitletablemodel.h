@@ -0,0 +1,55 @@
+#pragma once
+
+#include <QAbstractTableModel>
+
+#include "subtitlelinter.h"
+#include "subtitlestore.h"
+
+// Table view over the subtitle store. Cells are formatted on request, so only
+// the rows the view actually shows ever get turned into strings. Rows with
+// problems found by the linter are tinted and their header gets a warning.
+class SubtitleTableModel : public QAbstractTableModel {
+    Q_OBJECT
+
+public:
+    enum Column {
+        ShowColumn,
+        HideColumn,
+        SubtitleColumn,
+        ColumnCount
+    };
+
+    SubtitleTableModel(SubtitleStore *subtitles, QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+    // Changes to the store have to go through these so the view is notified.
+    // Insert and Replace keep the store sorted and return the cue's new row.
+    void Append(const QList<SubtitleItem> &items);
+    int Insert(const SubtitleItem &item);
+    int Replace(int row, const SubtitleItem &item);
+    void Remove(int row);
+    void Clear();
+    // Replaces every cue at once, e.g. with the ones of a project file.
+    // The store's columns are shared rather than copied.
+    void Reset(const SubtitleStore &subtitles);
+    void Sort();
+
+    // Bulk retiming, see SubtitleStore::setTimes
+    void SetTimes(int first, const QVector<qint64> &showTimes, const QVector<qint64> &hideTimes);
+    void ShiftTimes(int first, int count, qint64 offset);
+
+    const SubtitleStore *getSubtitles() const { return Subtitles; }
+
+    // The linter has to be told about changes to the store itself
+    void setLinter(SubtitleLinter *linter) { Linter = linter; }
+    // Call when the linter's results changed, to repaint the row headers
+    void ProblemsChanged();
+
+private:
+    SubtitleStore *Subtitles;
+    SubtitleLinter *Linter = nullptr;
+};
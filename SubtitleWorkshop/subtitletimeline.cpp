@@ -0,0 +1,179 @@
+#include "subtitletimeline.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+const qint64 NoTime = std::numeric_limits<qint64>::min();
+
+}
+
+SubtitleTimeline::SubtitleTimeline(const SubtitleStore *subtitles) : Subtitles(subtitles) {
+    Invalidate();
+}
+
+void SubtitleTimeline::Invalidate() {
+    isDirty = true;
+
+    // Empty span, the next lookup always misses the cache
+    ValidFrom = 0;
+    ValidUntil = 0;
+}
+
+void SubtitleTimeline::RowsInserted(int first, int last) {
+    if (isDirty)
+        return;
+
+    // Every row from first on moved up, and the tree may have to grow
+    int Count = Rows + last - first + 1;
+    if (Count != Subtitles->size() || Count > Leaves) {
+        Invalidate();
+        return;
+    }
+
+    Rows = Count;
+    Update(first, Rows - 1);
+}
+
+void SubtitleTimeline::RowsRemoved(int first, int last) {
+    if (isDirty)
+        return;
+
+    int Count = Rows - (last - first + 1);
+    if (Count != Subtitles->size()) {
+        Invalidate();
+        return;
+    }
+
+    // The rows that were last are cleared too
+    int OldRows = Rows;
+    Rows = Count;
+    Update(first, OldRows - 1);
+}
+
+void SubtitleTimeline::RowMoved(int from, int to) {
+    if (isDirty)
+        return;
+
+    Update(std::min(from, to), std::max(from, to));
+}
+
+void SubtitleTimeline::RowsChanged(int first, int last) {
+    if (isDirty)
+        return;
+
+    Update(first, last);
+}
+
+void SubtitleTimeline::Update(int first, int last) {
+    // The cached lookup may be of rows that moved
+    ValidFrom = 0;
+    ValidUntil = 0;
+
+    const QVector<qint64> &Ends = Subtitles->getHideTimes();
+    if (Rows != Ends.size()) {
+        Invalidate();
+        return;
+    }
+
+    for (int i = first; i <= last; i++) {
+        Tree[Leaves + i] = i < Rows ? Ends.at(i) : NoTime;
+    }
+
+    // A level at a time, the nodes above the changed ones are a range too
+    for (int from = (Leaves + first) / 2, to = (Leaves + last) / 2; from > 0; from /= 2, to /= 2) {
+        for (int node = from; node <= to; node++) {
+            Tree[node] = std::max(Tree.at(2 * node), Tree.at(2 * node + 1));
+        }
+    }
+}
+
+void SubtitleTimeline::Rebuild() {
+    const QVector<qint64> &Ends = Subtitles->getHideTimes();
+    Rows = Ends.size();
+
+    Leaves = 1;
+    while (Leaves < Rows) {
+        Leaves *= 2;
+    }
+
+    Tree.fill(NoTime, 2 * Leaves);
+    std::copy(Ends.constBegin(), Ends.constEnd(), Tree.begin() + Leaves);
+
+    for (int node = Leaves - 1; node > 0; node--) {
+        Tree[node] = std::max(Tree.at(2 * node), Tree.at(2 * node + 1));
+    }
+
+    isDirty = false;
+}
+
+void SubtitleTimeline::Collect(int node, int from, int to, int end, qint64 position, qint64 &endedBefore) {
+    if (from >= end)
+        return;
+
+    // Nothing under node is still showing
+    if (Tree.at(node) <= position) {
+        endedBefore = std::max(endedBefore, Tree.at(node));
+        return;
+    }
+
+    if (to - from == 1) {
+        Active.append(from);
+        ValidUntil = std::min(ValidUntil, Tree.at(node));
+        return;
+    }
+
+    int mid = from + (to - from) / 2;
+    Collect(2 * node, from, mid, end, position, endedBefore);
+    Collect(2 * node + 1, mid, to, end, position, endedBefore);
+}
+
+const QVector<int> &SubtitleTimeline::ActiveAt(qint64 position) {
+    if (isDirty) {
+        Rebuild();
+    }
+    else if (ValidFrom <= position && position < ValidUntil) {
+        return Active;
+    }
+
+    Active.clear();
+
+    const QVector<qint64> &Starts = Subtitles->getShowTimes();
+
+    // Cues before k have been shown by now, cue k is the next one to show
+    int k = NextAfter(position);
+
+    ValidFrom = k > 0 ? Starts[k - 1] : NoTime;
+    ValidUntil = k < Starts.size() ? Starts[k] : std::numeric_limits<qint64>::max();
+
+    // The ones before k that ended by now changed the answer when they did
+    qint64 EndedBefore = NoTime;
+    Collect(1, 0, Leaves, k, position, EndedBefore);
+    ValidFrom = std::max(ValidFrom, EndedBefore);
+
+    return Active;
+}
+
+int SubtitleTimeline::FirstEndingAfter(qint64 position) {
+    if (isDirty) {
+        Rebuild();
+    }
+
+    int k = NextAfter(position);
+    if (k == 0 || Tree.at(1) <= position)
+        return k;
+
+    // Down the leftmost branch that still holds a cue hiding after position
+    int node = 1;
+    while (node < Leaves) {
+        node = Tree.at(2 * node) > position ? 2 * node : 2 * node + 1;
+    }
+
+    return std::min(node - Leaves, k);
+}
+
+int SubtitleTimeline::NextAfter(qint64 position) const {
+    const QVector<qint64> &Starts = Subtitles->getShowTimes();
+    return int(std::upper_bound(Starts.constBegin(), Starts.constEnd(), position) - Starts.constBegin());
+}
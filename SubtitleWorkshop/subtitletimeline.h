@@ -0,0 +1,64 @@
+#pragma once
+
+#include <QVector>
+
+#include "subtitlestore.h"
+
+// Answers "which cues are on screen at this position" for a subtitle store
+// sorted by show time. The hide times are kept in a max tree, so a lookup
+// binary searches the show times and then only descends into the parts of
+// the tree holding a cue that is still showing: O(log n) per cue found,
+// however long the cues before it are. The answer is cached together with
+// the span of time it stays valid for, so the lookups done during playback
+// only do that work when the active cues change.
+class SubtitleTimeline {
+public:
+    SubtitleTimeline(const SubtitleStore *subtitles);
+
+    // Call after the store changed as a whole, the index is rebuilt on next
+    // lookup
+    void Invalidate();
+
+    // Call after rows of the store changed. Only the tree entries of the
+    // changed rows and of the rows they pushed along are updated, edits
+    // and moves are the rows in between plus log n.
+    void RowsInserted(int first, int last);
+    void RowsRemoved(int first, int last);
+    void RowMoved(int from, int to);
+    void RowsChanged(int first, int last);
+
+    // Rows of every cue showing at position, in show time order
+    const QVector<int> &ActiveAt(qint64 position);
+
+    // First row shown after position, size() when there's none left
+    int NextAfter(qint64 position) const;
+    // First row still showing at position or shown after it, for drawing
+    // the cues from position on. Doesn't touch the cached lookup.
+    int FirstEndingAfter(qint64 position);
+
+    // Span around the last lookup in which ActiveAt returns the same rows
+    qint64 getValidFrom() const { return ValidFrom; }
+    qint64 getValidUntil() const { return ValidUntil; }
+
+private:
+    const SubtitleStore *Subtitles;
+    bool isDirty = true;
+
+    // Max tree of the store's hide times: node 1 is the root, node n has
+    // 2n and 2n + 1 below it and row i is leaf Leaves + i. Leaves past the
+    // rows hold the smallest time there is.
+    QVector<qint64> Tree;
+    int Leaves = 0;
+    int Rows = 0;
+
+    QVector<int> Active;
+    qint64 ValidFrom;
+    qint64 ValidUntil;
+
+    void Rebuild();
+    // Sets the leaves of rows first to last and the nodes above them
+    void Update(int first, int last);
+    // Appends the rows before end whose cue hides after position, and
+    // raises endedBefore to the latest hide time of the others
+    void Collect(int node, int from, int to, int end, qint64 position, qint64 &endedBefore);
+};
@@ -0,0 +1,260 @@
+#include "textencoding.h"
+
+#include <climits>
+#include <cstring>
+
+#include <QList>
+#include <QString>
+#include <QTextCodec>
+
+namespace {
+
+inline bool StartsWithBytes(const char *data, qint64 size, const char *bytes, int length) {
+    return size >= length && std::memcmp(data, bytes, length) == 0;
+}
+
+// Text without a BOM that has a zero byte in most of its character pairs
+// is UTF-16, the side the zeros are on gives the byte order
+QByteArray DetectUtf16(const char *data, qint64 size) {
+    qint64 Sample = qMin<qint64>(size, 4096) & ~qint64(1);
+    if (Sample < 8)
+        return QByteArray();
+
+    qint64 EvenZeros = 0, OddZeros = 0;
+    for (qint64 i = 0; i < Sample; i += 2) {
+        if (data[i] == 0) EvenZeros++;
+        if (data[i + 1] == 0) OddZeros++;
+    }
+
+    qint64 Pairs = Sample / 2;
+    if (OddZeros * 10 > Pairs * 3 && EvenZeros * 10 < Pairs)
+        return "UTF-16LE";
+    if (EvenZeros * 10 > Pairs * 3 && OddZeros * 10 < Pairs)
+        return "UTF-16BE";
+
+    return QByteArray();
+}
+
+// The most frequent letters of the scripts whose code pages map the same
+// bytes to letters, which is all that tells them apart
+const QString &CommonLetters(QChar::Script script) {
+    static const QString Cyrillic = QString::fromUtf16(u"\u043E\u0435\u0430\u0438\u043D\u0442\u0441\u0440\u0432\u043B\u043A\u043C\u0434\u043F\u0443\u044F\u044B");
+    static const QString Greek = QString::fromUtf16(u"\u03B1\u03BF\u03B5\u03B9\u03C4\u03BD\u03B7\u03C3\u03C1\u03BA\u03C0\u03BC\u03BB\u03C5");
+    static const QString Arabic = QString::fromUtf16(u"\u0627\u0644\u064A\u0645\u0648\u0646\u0647\u0631\u062A\u0628\u0643\u0639\u062F");
+    static const QString Hebrew = QString::fromUtf16(u"\u05D9\u05D5\u05D4\u05DC\u05E8\u05DD\u05DE\u05D0\u05D1\u05EA\u05E9\u05E0");
+    static const QString None;
+
+    switch (script) {
+    case QChar::Script_Cyrillic: return Cyrillic;
+    case QChar::Script_Greek: return Greek;
+    case QChar::Script_Arabic: return Arabic;
+    case QChar::Script_Hebrew: return Hebrew;
+    default: return None;
+    }
+}
+
+inline bool IsAsciiLetter(QChar c) {
+    return c.unicode() < 0x80 && c.isLetter();
+}
+
+// How much decoded text reads like a language rather than mojibake.
+// Non-ASCII letters score, common ones twice. Symbols and controls wedged
+// into words cost, and so do the things another script read with the wrong
+// code page is full of: runs of accented Latin letters, other scripts
+// inside ASCII words and capitals in the middle of lowercase words.
+int ScoreText(const QString &text) {
+    int Score = 0;
+
+    for (int i = 0; i < text.size(); i++) {
+        QChar c = text.at(i);
+        if (c.unicode() < 0x80)
+            continue;
+
+        QChar previous = i > 0 ? text.at(i - 1) : QChar(' ');
+        QChar next = i + 1 < text.size() ? text.at(i + 1) : QChar(' ');
+
+        if (c.unicode() == QChar::ReplacementCharacter || c.category() == QChar::Other_Control) {
+            Score -= 5;
+        }
+        else if (c.isLetter()) {
+            QChar::Script Script = c.script();
+
+            Score += 1;
+            if (CommonLetters(Script).contains(c.toLower()))
+                Score += 1;
+
+            if (previous.unicode() >= 0x80 && previous.isLetter()) {
+                if (previous.script() != Script)
+                    Score -= 3;
+                else if (Script == QChar::Script_Latin)
+                    Score -= 2;
+            }
+
+            if (Script != QChar::Script_Latin && (IsAsciiLetter(previous) || IsAsciiLetter(next)))
+                Score -= 3;
+
+            if (c.isUpper() && previous.isLower())
+                Score -= 2;
+        }
+        else if (previous.isLetter() && next.isLetter()) {
+            Score -= 2;
+        }
+    }
+
+    return Score;
+}
+
+}
+
+TextEncoding::TextEncoding() : Name("UTF-8"), Bom(false) {}
+
+TextEncoding::TextEncoding(const QByteArray &name, bool bom) : Name(name), Bom(bom) {}
+
+bool operator==(const TextEncoding &lhs, const TextEncoding &rhs) {
+    return lhs.Name == rhs.Name && lhs.Bom == rhs.Bom;
+}
+
+TextEncoding TextEncoding::Detect(const char *data, qint64 size) {
+    // UTF-32 first, its little endian BOM starts like UTF-16's
+    if (StartsWithBytes(data, size, "\xFF\xFE\x00\x00", 4))
+        return TextEncoding("UTF-32LE", true);
+    if (StartsWithBytes(data, size, "\x00\x00\xFE\xFF", 4))
+        return TextEncoding("UTF-32BE", true);
+    if (StartsWithBytes(data, size, "\xEF\xBB\xBF", 3))
+        return TextEncoding("UTF-8", true);
+    if (StartsWithBytes(data, size, "\xFF\xFE", 2))
+        return TextEncoding("UTF-16LE", true);
+    if (StartsWithBytes(data, size, "\xFE\xFF", 2))
+        return TextEncoding("UTF-16BE", true);
+
+    QByteArray Utf16 = DetectUtf16(data, size);
+    if (!Utf16.isEmpty())
+        return TextEncoding(Utf16, false);
+
+    if (IsValidUtf8(data, size))
+        return TextEncoding();
+
+    return TextEncoding(GuessCodePage(data, size), false);
+}
+
+QByteArray TextEncoding::getBomBytes() const {
+    if (!Bom)
+        return QByteArray();
+
+    if (Name == "UTF-8") return QByteArray("\xEF\xBB\xBF", 3);
+    if (Name == "UTF-16LE") return QByteArray("\xFF\xFE", 2);
+    if (Name == "UTF-16BE") return QByteArray("\xFE\xFF", 2);
+    if (Name == "UTF-32LE") return QByteArray("\xFF\xFE\x00\x00", 4);
+    if (Name == "UTF-32BE") return QByteArray("\x00\x00\xFE\xFF", 4);
+
+    return QByteArray();
+}
+
+QByteArray TextEncoding::ToUtf8(const char *data, qint64 size) const {
+    QByteArray Bom = getBomBytes();
+    if (!Bom.isEmpty() && StartsWithBytes(data, size, Bom.constData(), Bom.size())) {
+        data += Bom.size();
+        size -= Bom.size();
+    }
+
+    if (isUtf8()) {
+        return QByteArray(data, int(size));
+    }
+
+    QTextCodec *Codec = QTextCodec::codecForName(Name);
+    if (!Codec) {
+        Codec = QTextCodec::codecForName("windows-1252");
+    }
+
+    return Codec->toUnicode(data, int(size)).toUtf8();
+}
+
+bool TextEncoding::IsValidUtf8(const char *data, qint64 size) {
+    const unsigned char *p = reinterpret_cast<const unsigned char *>(data);
+    const unsigned char *end = p + size;
+
+    while (p < end) {
+        // Subtitles are mostly ASCII, skip it eight bytes at a time
+        while (end - p >= 8) {
+            quint64 Word;
+            std::memcpy(&Word, p, 8);
+            if (Word & Q_UINT64_C(0x8080808080808080))
+                break;
+            p += 8;
+        }
+
+        if (p >= end)
+            break;
+
+        unsigned char c = *p;
+        if (c < 0x80) {
+            p++;
+            continue;
+        }
+
+        // Lead byte: sequence length and the smallest value it may encode,
+        // which rules out overlong forms
+        int Length;
+        quint32 CodePoint, Minimum;
+        if ((c & 0xE0) == 0xC0) {
+            Length = 2; CodePoint = c & 0x1F; Minimum = 0x80;
+        }
+        else if ((c & 0xF0) == 0xE0) {
+            Length = 3; CodePoint = c & 0x0F; Minimum = 0x800;
+        }
+        else if ((c & 0xF8) == 0xF0) {
+            Length = 4; CodePoint = c & 0x07; Minimum = 0x10000;
+        }
+        else {
+            return false;
+        }
+
+        if (end - p < Length)
+            return false;
+
+        for (int i = 1; i < Length; i++) {
+            if ((p[i] & 0xC0) != 0x80)
+                return false;
+            CodePoint = (CodePoint << 6) | (p[i] & 0x3F);
+        }
+
+        if (CodePoint < Minimum || CodePoint > 0x10FFFF || (CodePoint >= 0xD800 && CodePoint <= 0xDFFF))
+            return false;
+
+        p += Length;
+    }
+
+    return true;
+}
+
+QByteArray TextEncoding::GuessCodePage(const char *data, qint64 size) {
+    // The first 64 KB say enough
+    int Sample = int(qMin<qint64>(size, 65536));
+
+    QList<QByteArray> Candidates;
+    Candidates << "windows-1252" << "windows-1250" << "windows-1251" << "windows-1253"
+               << "windows-1254" << "windows-1255" << "windows-1256" << "windows-1257";
+
+    // Ties go to the system's own code page
+    QByteArray Local = QTextCodec::codecForLocale()->name();
+    if (Candidates.removeOne(Local)) {
+        Candidates.prepend(Local);
+    }
+
+    QByteArray Best = Candidates.first();
+    int BestScore = INT_MIN;
+
+    for (const QByteArray &name : Candidates) {
+        QTextCodec *Codec = QTextCodec::codecForName(name);
+        if (!Codec)
+            continue;
+
+        int Score = ScoreText(Codec->toUnicode(data, Sample));
+        if (Score > BestScore) {
+            Best = name;
+            BestScore = Score;
+        }
+    }
+
+    return Best;
+}
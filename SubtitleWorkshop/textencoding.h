@@ -0,0 +1,42 @@
+#pragma once
+
+#include <QByteArray>
+
+// The character encoding of a subtitle file. Detected once before parsing
+// and kept with the document, so it is saved back the way it came in.
+//
+// Detection goes BOM, then UTF-16 without one, then UTF-8 validation, and
+// only if all of those fail guesses a legacy code page from what the text
+// looks like decoded with each candidate.
+class TextEncoding {
+public:
+    // UTF-8 without a BOM
+    TextEncoding();
+    TextEncoding(const QByteArray &name, bool bom);
+
+    static TextEncoding Detect(const char *data, qint64 size);
+
+    // QTextCodec name, e.g. "UTF-8", "UTF-16LE" or "windows-1252"
+    const QByteArray &getName() const { return Name; }
+    bool hasBom() const { return Bom; }
+
+    bool isUtf8() const { return Name == "UTF-8"; }
+    // UTF-16 and UTF-32 can't go through text mode line ending conversion
+    bool isWide() const { return Name.startsWith("UTF-16") || Name.startsWith("UTF-32"); }
+
+    // The BOM this encoding starts a file with, empty if it has none
+    QByteArray getBomBytes() const;
+
+    // Transcodes data in one go, its BOM is dropped
+    QByteArray ToUtf8(const char *data, qint64 size) const;
+
+    static bool IsValidUtf8(const char *data, qint64 size);
+
+    friend bool operator==(const TextEncoding &lhs, const TextEncoding &rhs);
+
+private:
+    QByteArray Name;
+    bool Bom;
+
+    static QByteArray GuessCodePage(const char *data, qint64 size);
+};
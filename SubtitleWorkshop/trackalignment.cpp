@@ -0,0 +1,130 @@
+#include "trackalignment.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+// A cue that starts a row of its own
+struct Anchor {
+    qint64 Time;
+    int Track;
+    int Cue;
+};
+
+}
+
+void TrackAlignment::Align(const QVector<const SubtitleStore *> &tracks) {
+    Clear();
+    if (tracks.isEmpty())
+        return;
+
+    const QVector<qint64> &Starts = tracks.first()->getShowTimes();
+    const QVector<qint64> &Ends = tracks.first()->getHideTimes();
+
+    // Running maximum of the first track's hide times, a walk back for
+    // overlapping cues can stop where it drops below the cue's show time
+    QVector<qint64> MaxEnds(Ends.size());
+    qint64 maxEnd = std::numeric_limits<qint64>::min();
+    for (int i = 0; i < Ends.size(); i++) {
+        maxEnd = std::max(maxEnd, Ends.at(i));
+        MaxEnds[i] = maxEnd;
+    }
+
+    QVector<Anchor> Anchors;
+    Anchors.reserve(Starts.size());
+    for (int i = 0; i < Starts.size(); i++) {
+        Anchors.append({ Starts.at(i), 0, i });
+    }
+
+    // First track cue each other track's cue goes with, or -1
+    QVector<QVector<int>> Matches(tracks.size());
+
+    for (int t = 1; t < tracks.size(); t++) {
+        const SubtitleStore *Other = tracks.at(t);
+        Matches[t].resize(Other->size());
+
+        for (int j = 0; j < Other->size(); j++) {
+            qint64 Show = Other->getShowTime(j);
+            qint64 Hide = Other->getHideTime(j);
+
+            // Cues from k on start after this one is gone
+            int k = int(std::lower_bound(Starts.constBegin(), Starts.constEnd(), Hide) - Starts.constBegin());
+
+            int Best = -1;
+            qint64 BestOverlap = 0;
+            int Stop = std::max(0, k - MaxCandidates);
+            for (int i = k - 1; i >= Stop && MaxEnds.at(i) > Show; i--) {
+                // Walking back, so ties go to the earlier cue
+                qint64 Overlap = std::min(Hide, Ends.at(i)) - std::max(Show, Starts.at(i));
+                if (Overlap > 0 && Overlap >= BestOverlap) {
+                    Best = i;
+                    BestOverlap = Overlap;
+                }
+            }
+
+            Matches[t][j] = Best;
+            if (Best < 0) {
+                Anchors.append({ Show, t, j });
+            }
+        }
+    }
+
+    // The first track's cues go before the others' showing at the same time
+    std::stable_sort(Anchors.begin(), Anchors.end(), [](const Anchor &a, const Anchor &b) {
+        return a.Time < b.Time || (a.Time == b.Time && a.Track < b.Track);
+    });
+
+    Tracks.resize(tracks.size());
+    for (int t = 0; t < tracks.size(); t++) {
+        Tracks[t].CueRows.resize(tracks.at(t)->size());
+    }
+
+    RowTimes.resize(Anchors.size());
+    for (int row = 0; row < Anchors.size(); row++) {
+        const Anchor &anchor = Anchors.at(row);
+        RowTimes[row] = anchor.Time;
+        Tracks[anchor.Track].CueRows[anchor.Cue] = row;
+    }
+
+    for (int t = 1; t < tracks.size(); t++) {
+        for (int j = 0; j < Matches.at(t).size(); j++) {
+            int Match = Matches.at(t).at(j);
+            if (Match >= 0) {
+                Tracks[t].CueRows[j] = Tracks.at(0).CueRows.at(Match);
+            }
+        }
+    }
+
+    // Counting sort of every track's cues by row
+    for (Track &track : Tracks) {
+        track.RowStarts.fill(0, RowTimes.size() + 1);
+        for (int row : qAsConst(track.CueRows)) {
+            track.RowStarts[row + 1]++;
+        }
+
+        for (int row = 0; row < RowTimes.size(); row++) {
+            track.RowStarts[row + 1] += track.RowStarts.at(row);
+        }
+
+        QVector<int> Next = track.RowStarts;
+        track.Cues.resize(track.CueRows.size());
+        for (int cue = 0; cue < track.CueRows.size(); cue++) {
+            track.Cues[Next[track.CueRows.at(cue)]++] = cue;
+        }
+    }
+}
+
+void TrackAlignment::Clear() {
+    Tracks.clear();
+    RowTimes.clear();
+}
+
+QVector<int> TrackAlignment::getCues(int track, int row) const {
+    const Track &Entry = Tracks.at(track);
+
+    int From = Entry.RowStarts.at(row);
+    int To = Entry.RowStarts.at(row + 1);
+
+    return Entry.Cues.mid(From, To - From);
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <QVector>
+
+#include "subtitlestore.h"
+
+// Lines up the cues of several subtitle tracks by time, for showing them
+// side by side. Every cue of the first track gets a row of its own. A cue
+// of another track joins the row of the first track's cue it overlaps the
+// most, or gets a row of its own if it overlaps none. Rows are in show time
+// order, and a track's cues in a row in their own order.
+//
+// Every cue is looked up in the first track's show times and compared with
+// at most MaxCandidates of the first track's cues before it ends, so
+// aligning takes O(n log n) in the cues of all tracks together even when a
+// long cue overlaps many others. A cue only overlapping ones further back
+// than that gets a row of its own. The rows are kept in a few flat arrays
+// per track.
+class TrackAlignment {
+public:
+    static const int MaxCandidates = 64;
+
+    // The stores have to be sorted by show time
+    void Align(const QVector<const SubtitleStore *> &tracks);
+    void Clear();
+
+    int getRowCount() const { return RowTimes.size(); }
+    int getTrackCount() const { return Tracks.size(); }
+
+    // Earliest show time of the row's cues
+    qint64 getRowTime(int row) const { return RowTimes.at(row); }
+
+    // Cues of track when it was lined up
+    int getCueCount(int track) const { return Tracks.at(track).CueRows.size(); }
+
+    // Rows of track's cues in row, in the track's store
+    QVector<int> getCues(int track, int row) const;
+    // Row the track's cue is in
+    int getRow(int track, int cue) const { return Tracks.at(track).CueRows.at(cue); }
+
+private:
+    struct Track {
+        QVector<int> CueRows;
+        // The track's cues grouped by row, row r's are
+        // Cues[RowStarts[r]] up to Cues[RowStarts[r + 1]]
+        QVector<int> RowStarts;
+        QVector<int> Cues;
+    };
+
+    QVector<Track> Tracks;
+    QVector<qint64> RowTimes;
+};
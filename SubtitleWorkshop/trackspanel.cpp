@@ -0,0 +1,85 @@
+#include "trackspanel.h"
+
+#include <QHeaderView>
+
+TracksPanel::TracksPanel(QWidget *parent) : QDockWidget("Tracks", parent) {
+    setObjectName("TracksPanel");
+
+    Model = new AlignedTracksModel(this);
+
+    View = new QTableView(this);
+    View->setModel(Model);
+    View->setSelectionBehavior(QAbstractItemView::SelectRows);
+    View->setSelectionMode(QAbstractItemView::SingleSelection);
+    View->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    View->setWordWrap(false);
+
+    // Fixed row heights keep the view from measuring every row of big files
+    View->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    View->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+
+    setWidget(View);
+
+    RefreshTimer = new QTimer(this);
+    RefreshTimer->setSingleShot(true);
+    RefreshTimer->setInterval(200);
+
+    connect(RefreshTimer, SIGNAL(timeout()), this, SLOT(Refresh()));
+    connect(View, SIGNAL(clicked(QModelIndex)), this, SLOT(RowClicked(QModelIndex)));
+    connect(View, SIGNAL(activated(QModelIndex)), this, SLOT(RowClicked(QModelIndex)));
+}
+
+void TracksPanel::setTracks(const QVector<const SubtitleStore *> &tracks, const QStringList &names) {
+    Tracks = tracks;
+    Names = names;
+
+    Refresh();
+}
+
+void TracksPanel::ScheduleRefresh() {
+    RefreshTimer->start();
+}
+
+void TracksPanel::Refresh() {
+    RefreshTimer->stop();
+
+    if (!isVisible()) {
+        isStale = true;
+        return;
+    }
+
+    isStale = false;
+    Model->setTracks(Tracks, Names);
+
+    // The time column only needs to fit a time, measuring its contents
+    // would go through every row
+    QHeaderView *Header = View->horizontalHeader();
+    Header->setSectionResizeMode(AlignedTracksModel::TimeColumn, QHeaderView::Interactive);
+    Header->resizeSection(AlignedTracksModel::TimeColumn, View->fontMetrics().horizontalAdvance("00:00:00,000") + 16);
+}
+
+void TracksPanel::SelectCue(int cue) {
+    if (!isVisible())
+        return;
+
+    int row = Model->getRow(0, cue);
+    if (row < 0)
+        return;
+
+    View->selectRow(row);
+}
+
+void TracksPanel::showEvent(QShowEvent *e) {
+    QDockWidget::showEvent(e);
+
+    if (isStale) {
+        Refresh();
+    }
+}
+
+void TracksPanel::RowClicked(const QModelIndex &index) {
+    if (!index.isValid())
+        return;
+
+    emit RowActivated(Model->getRowTime(index.row()), Model->getCue(0, index.row()));
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <QDockWidget>
+#include <QTableView>
+#include <QTimer>
+
+#include "alignedtracksmodel.h"
+
+// The edited subtitles and the reference tracks side by side, lined up by
+// time. Lining them up is put off while the panel is hidden, and changes
+// in bursts are lined up once.
+class TracksPanel : public QDockWidget {
+    Q_OBJECT
+
+public:
+    TracksPanel(QWidget *parent = nullptr);
+
+    // The first track is the edited one. Stores have to stay around until
+    // the next call.
+    void setTracks(const QVector<const SubtitleStore *> &tracks, const QStringList &names);
+
+public slots:
+    // Lines the tracks up again shortly, e.g. after the cues changed
+    void ScheduleRefresh();
+    void Refresh();
+
+    // Scrolls to the row of the edited track's cue
+    void SelectCue(int cue);
+
+signals:
+    // cue is the edited track's first cue in the row, or -1
+    void RowActivated(qint64 time, int cue);
+
+protected:
+    void showEvent(QShowEvent *e);
+
+private slots:
+    void RowClicked(const QModelIndex &index);
+
+private:
+    QVector<const SubtitleStore *> Tracks;
+    QStringList Names;
+
+    AlignedTracksModel *Model;
+    QTableView *View;
+
+    QTimer *RefreshTimer;
+    bool isStale = false;
+};
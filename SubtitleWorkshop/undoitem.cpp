@@ -1,19 +1,209 @@
 #include "undoitem.h"
 
-UndoItem::UndoItem(const SubtitleItem &newItem, ItemType type) {
-    OldItem = SubtitleItem();
-    NewItem = newItem;
+#include "subtitletablemodel.h"
+
+UndoItem::UndoItem(ItemType type) : Type(type) {}
+
+UndoItem::UndoItem(const SubtitleItem &item, ItemType type) {
     Type = type;
+    Id = item.getId();
+    Item = item;
 }
 
 UndoItem::UndoItem(const SubtitleItem &oldItem, const SubtitleItem &newItem, ItemType type) {
-    OldItem = oldItem;
-    NewItem = newItem;
     Type = type;
+    Id = oldItem.getId();
+
+    OldShowTime = oldItem.getShowTime();
+    NewShowTime = newItem.getShowTime();
+    OldHideTime = oldItem.getHideTime();
+    NewHideTime = newItem.getHideTime();
+
+    // Only keep the span between the common prefix and suffix
+    QString OldSubtitle = oldItem.getSubtitle();
+    QString NewSubtitle = newItem.getSubtitle();
+    int common = qMin(OldSubtitle.size(), NewSubtitle.size());
+
+    int prefix = 0;
+    while (prefix < common && OldSubtitle.at(prefix) == NewSubtitle.at(prefix)) {
+        prefix++;
+    }
+
+    int suffix = 0;
+    while (suffix < common - prefix && OldSubtitle.at(OldSubtitle.size() - 1 - suffix) == NewSubtitle.at(NewSubtitle.size() - 1 - suffix)) {
+        suffix++;
+    }
+
+    TextPosition = prefix;
+    OldText = OldSubtitle.mid(prefix, OldSubtitle.size() - prefix - suffix);
+    NewText = NewSubtitle.mid(prefix, NewSubtitle.size() - prefix - suffix);
+}
+
+UndoItem UndoItem::Retimed(int first, const QVector<qint64> &oldShowTimes, const QVector<qint64> &oldHideTimes, const QVector<qint64> &newShowTimes, const QVector<qint64> &newHideTimes) {
+    UndoItem Result(TIMING);
+    Result.FirstRow = first;
+    Result.RowCount = oldShowTimes.size();
+    Result.OldShowTimes = oldShowTimes;
+    Result.OldHideTimes = oldHideTimes;
+    Result.NewShowTimes = newShowTimes;
+    Result.NewHideTimes = newHideTimes;
+    return Result;
+}
+
+UndoItem UndoItem::Shifted(int first, int count, qint64 offset) {
+    UndoItem Result(TIMING);
+    Result.FirstRow = first;
+    Result.RowCount = count;
+    Result.Offset = offset;
+    return Result;
+}
+
+SubtitleItem UndoItem::getOldItem(const SubtitleItem &current) const {
+    SubtitleItem Result(current);
+    Result.setShowTime(OldShowTime);
+    Result.setHideTime(OldHideTime);
+    if (OldText != NewText) {
+        Result.setSubtitle(QString(current.getSubtitle()).replace(TextPosition, NewText.size(), OldText));
+    }
+
+    return Result;
+}
+
+SubtitleItem UndoItem::getNewItem(const SubtitleItem &current) const {
+    SubtitleItem Result(current);
+    Result.setShowTime(NewShowTime);
+    Result.setHideTime(NewHideTime);
+    if (OldText != NewText) {
+        Result.setSubtitle(QString(current.getSubtitle()).replace(TextPosition, OldText.size(), NewText));
+    }
+
+    return Result;
+}
+
+int UndoItem::Undo(SubtitleTableModel *model) const {
+    switch (Type) {
+        case ADD:
+            return Remove(model);
+        case REMOVE:
+            return Insert(model);
+        case EDIT: {
+            int row = model->getSubtitles()->indexOfId(Id);
+            if (row < 0)
+                return -1;
+
+            return model->Replace(row, getOldItem(model->getSubtitles()->at(row)));
+        }
+        case TIMING:
+            if (OldShowTimes.isEmpty()) {
+                model->ShiftTimes(FirstRow, RowCount, -Offset);
+            }
+            else {
+                model->SetTimes(FirstRow, OldShowTimes, OldHideTimes);
+            }
+
+            return FirstRow;
+    }
+
+    return -1;
+}
+
+int UndoItem::Redo(SubtitleTableModel *model) const {
+    switch (Type) {
+        case ADD:
+            return Insert(model);
+        case REMOVE:
+            return Remove(model);
+        case EDIT: {
+            int row = model->getSubtitles()->indexOfId(Id);
+            if (row < 0)
+                return -1;
+
+            return model->Replace(row, getNewItem(model->getSubtitles()->at(row)));
+        }
+        case TIMING:
+            if (NewShowTimes.isEmpty()) {
+                model->ShiftTimes(FirstRow, RowCount, Offset);
+            }
+            else {
+                model->SetTimes(FirstRow, NewShowTimes, NewHideTimes);
+            }
+
+            return FirstRow;
+    }
+
+    return -1;
+}
+
+int UndoItem::Insert(SubtitleTableModel *model) const {
+    // Already there, e.g. the history got out of step with the file
+    if (model->getSubtitles()->indexOfId(Id) != -1)
+        return -1;
+
+    return model->Insert(Item);
+}
+
+int UndoItem::Remove(SubtitleTableModel *model) const {
+    int row = model->getSubtitles()->indexOfId(Id);
+    if (row >= 0) {
+        model->Remove(row);
+    }
+
+    return -1;
+}
+
+qint64 UndoItem::getSize() const {
+    return qint64(sizeof(UndoItem)) +
+            (Item.getSubtitle().size() + OldText.size() + NewText.size()) * qint64(sizeof(QChar)) +
+            (OldShowTimes.size() + OldHideTimes.size() + NewShowTimes.size() + NewHideTimes.size()) * qint64(sizeof(qint64));
+}
+
+void UndoItem::Write(QDataStream &out) const {
+    out << qint32(Type) << Id;
+    out << Item.getId() << Item.getShowTime() << Item.getHideTime() << qint32(Item.getStyle()) << Item.getSubtitle();
+    out << OldShowTime << NewShowTime << OldHideTime << NewHideTime;
+    out << qint32(TextPosition) << OldText << NewText;
+    out << qint32(FirstRow) << qint32(RowCount) << Offset;
+    out << OldShowTimes << OldHideTimes << NewShowTimes << NewHideTimes;
+}
+
+UndoItem UndoItem::Read(QDataStream &in) {
+    qint32 type;
+    in >> type;
+
+    UndoItem Result(ItemType(type));
+    in >> Result.Id;
+
+    quint64 itemId;
+    qint64 showTime, hideTime;
+    qint32 style;
+    QString subtitle;
+    in >> itemId >> showTime >> hideTime >> style >> subtitle;
+
+    Result.Item = SubtitleItem(showTime, hideTime, subtitle);
+    Result.Item.setId(itemId);
+    Result.Item.setStyle(style);
+
+    in >> Result.OldShowTime >> Result.NewShowTime >> Result.OldHideTime >> Result.NewHideTime;
+
+    qint32 textPosition, firstRow, rowCount;
+    in >> textPosition >> Result.OldText >> Result.NewText;
+    in >> firstRow >> rowCount >> Result.Offset;
+    in >> Result.OldShowTimes >> Result.OldHideTimes >> Result.NewShowTimes >> Result.NewHideTimes;
+
+    Result.TextPosition = textPosition;
+    Result.FirstRow = firstRow;
+    Result.RowCount = rowCount;
+    return Result;
 }
 
 bool operator==(const UndoItem& lhs, const UndoItem& rhs) {
-    return lhs.getNewItem() == rhs.getNewItem() &&
-            lhs.getOldItem() == rhs.getOldItem() &&
-            lhs.getItemType() == rhs.getItemType();
+    return lhs.Type == rhs.Type &&
+            lhs.Id == rhs.Id &&
+            lhs.Item == rhs.Item &&
+            lhs.OldShowTime == rhs.OldShowTime && lhs.NewShowTime == rhs.NewShowTime &&
+            lhs.OldHideTime == rhs.OldHideTime && lhs.NewHideTime == rhs.NewHideTime &&
+            lhs.TextPosition == rhs.TextPosition && lhs.OldText == rhs.OldText && lhs.NewText == rhs.NewText &&
+            lhs.FirstRow == rhs.FirstRow && lhs.RowCount == rhs.RowCount && lhs.Offset == rhs.Offset &&
+            lhs.OldShowTimes == rhs.OldShowTimes && lhs.OldHideTimes == rhs.OldHideTimes &&
+            lhs.NewShowTimes == rhs.NewShowTimes && lhs.NewHideTimes == rhs.NewHideTimes;
 }
@@ -1,27 +1,82 @@
 #pragma once
 
+#include <QDataStream>
 #include <QString>
+#include <QVector>
 
 #include "subtitleitem.h"
 
+class SubtitleTableModel;
+
+// One change to the subtitles that knows how to take itself back and apply
+// itself again. Single cue changes are tied to their cue by id: added and
+// removed cues are kept whole so they can be put back, edits keep the new
+// and old times and only the part of the text that changed. Bulk retiming
+// covers a range of rows, and a plain shift only keeps its offset.
 class UndoItem {
 public:
     enum ItemType {
         ADD,
         REMOVE,
-        EDIT
+        EDIT,
+        TIMING
     };
 
-    UndoItem(const SubtitleItem &newItem, ItemType type);
+    UndoItem(const SubtitleItem &item, ItemType type);
     UndoItem(const SubtitleItem &oldItem, const SubtitleItem &newItem, ItemType type);
 
+    // Rows [first, first + count) retimed
+    static UndoItem Retimed(int first, const QVector<qint64> &oldShowTimes, const QVector<qint64> &oldHideTimes, const QVector<qint64> &newShowTimes, const QVector<qint64> &newHideTimes);
+    static UndoItem Shifted(int first, int count, qint64 offset);
+
     ItemType getItemType() const { return Type; }
-    SubtitleItem getOldItem() const { return OldItem; }
-    SubtitleItem getNewItem() const { return NewItem; }
+    quint64 getId() const { return Id; }
+
+    // ADD/REMOVE: the cue that was added or removed
+    SubtitleItem getItem() const { return Item; }
+
+    // EDIT: current with the edit taken back / applied again
+    SubtitleItem getOldItem(const SubtitleItem &current) const;
+    SubtitleItem getNewItem(const SubtitleItem &current) const;
+
+    // Apply the change to the model, return the row it ended up in or -1
+    int Undo(SubtitleTableModel *model) const;
+    int Redo(SubtitleTableModel *model) const;
+
+    // Rough number of bytes this item keeps alive
+    qint64 getSize() const;
+
+    // For keeping the history in project files
+    void Write(QDataStream &out) const;
+    static UndoItem Read(QDataStream &in);
 
     friend bool operator==(const UndoItem& lhs, const UndoItem& rhs);
 private:
+    UndoItem(ItemType type);
+
     ItemType Type;
-    SubtitleItem OldItem;
-    SubtitleItem NewItem;
+    quint64 Id = 0;
+    SubtitleItem Item;
+
+    qint64 OldShowTime = 0;
+    qint64 NewShowTime = 0;
+    qint64 OldHideTime = 0;
+    qint64 NewHideTime = 0;
+
+    // Text edits: OldText was replaced by NewText at TextPosition
+    int TextPosition = 0;
+    QString OldText;
+    QString NewText;
+
+    // Retiming
+    int FirstRow = 0;
+    int RowCount = 0;
+    qint64 Offset = 0;
+    QVector<qint64> OldShowTimes;
+    QVector<qint64> OldHideTimes;
+    QVector<qint64> NewShowTimes;
+    QVector<qint64> NewHideTimes;
+
+    int Insert(SubtitleTableModel *model) const;
+    int Remove(SubtitleTableModel *model) const;
 };
@@ -0,0 +1,209 @@
+#include "undostack.h"
+
+// UndoCommand
+UndoCommand::UndoCommand(const QString &text) : Text(text) {}
+
+void UndoCommand::Append(const UndoItem &item) {
+    Items.append(item);
+    Size += item.getSize();
+}
+
+int UndoCommand::Undo(SubtitleTableModel *model) const {
+    int row = -1;
+    for (int i = Items.size() - 1; i >= 0; i--) {
+        int itemRow = Items.at(i).Undo(model);
+        if (itemRow >= 0) row = itemRow;
+    }
+
+    return row;
+}
+
+int UndoCommand::Redo(SubtitleTableModel *model) const {
+    int row = -1;
+    for (int i = 0; i < Items.size(); i++) {
+        int itemRow = Items.at(i).Redo(model);
+        if (itemRow >= 0) row = itemRow;
+    }
+
+    return row;
+}
+
+void UndoCommand::Write(QDataStream &out) const {
+    out << Text << qint32(Items.size());
+    for (const UndoItem &item : Items) {
+        item.Write(out);
+    }
+}
+
+UndoCommand UndoCommand::Read(QDataStream &in) {
+    QString text;
+    qint32 count;
+    in >> text >> count;
+
+    UndoCommand Result(text);
+    for (int i = 0; i < count && in.status() == QDataStream::Ok; i++) {
+        Result.Append(UndoItem::Read(in));
+    }
+
+    return Result;
+}
+
+// UndoStack
+UndoStack::UndoStack(qint64 memoryBudget) : MemoryBudget(memoryBudget) {}
+
+void UndoStack::setMemoryBudget(qint64 bytes) {
+    MemoryBudget = bytes;
+    Trim();
+}
+
+void UndoStack::Push(const UndoItem &item, const QString &text) {
+    if (Record) {
+        Record(item, false);
+    }
+
+    if (MacroDepth > 0) {
+        Macro.Append(item);
+        return;
+    }
+
+    UndoCommand Command(text);
+    Command.Append(item);
+    PushCommand(Command);
+}
+
+void UndoStack::BeginMacro(const QString &text) {
+    if (MacroDepth++ == 0) {
+        Macro = UndoCommand(text);
+    }
+}
+
+void UndoStack::EndMacro() {
+    if (MacroDepth == 0 || --MacroDepth > 0)
+        return;
+
+    if (!Macro.isEmpty()) {
+        PushCommand(Macro);
+    }
+
+    Macro = UndoCommand();
+}
+
+UndoCommand UndoStack::Undo() {
+    if (UndoCommands.isEmpty())
+        return UndoCommand();
+
+    UndoCommand Command = UndoCommands.takeLast();
+    RedoCommands.append(Command);
+
+    if (Record) {
+        const QVector<UndoItem> &Items = Command.getItems();
+        for (int i = Items.size() - 1; i >= 0; i--) {
+            Record(Items.at(i), true);
+        }
+    }
+
+    return Command;
+}
+
+UndoCommand UndoStack::Redo() {
+    if (RedoCommands.isEmpty())
+        return UndoCommand();
+
+    UndoCommand Command = RedoCommands.takeLast();
+    UndoCommands.append(Command);
+
+    if (Record) {
+        for (const UndoItem &item : Command.getItems()) {
+            Record(item, false);
+        }
+    }
+
+    return Command;
+}
+
+void UndoStack::Clear() {
+    UndoCommands.clear();
+    RedoCommands.clear();
+
+    MacroDepth = 0;
+    Macro = UndoCommand();
+
+    MemoryUsage = 0;
+}
+
+QByteArray UndoStack::Save() const {
+    QByteArray Data;
+    QDataStream out(&Data, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_12);
+
+    out << qint32(UndoCommands.size());
+    for (const UndoCommand &command : UndoCommands) {
+        command.Write(out);
+    }
+
+    out << qint32(RedoCommands.size());
+    for (const UndoCommand &command : RedoCommands) {
+        command.Write(out);
+    }
+
+    return Data;
+}
+
+bool UndoStack::Restore(const QByteArray &data) {
+    Clear();
+
+    QDataStream in(data);
+    in.setVersion(QDataStream::Qt_5_12);
+
+    qint32 undoCount;
+    in >> undoCount;
+    for (int i = 0; i < undoCount && in.status() == QDataStream::Ok; i++) {
+        UndoCommands.append(UndoCommand::Read(in));
+    }
+
+    qint32 redoCount;
+    in >> redoCount;
+    for (int i = 0; i < redoCount && in.status() == QDataStream::Ok; i++) {
+        RedoCommands.append(UndoCommand::Read(in));
+    }
+
+    if (in.status() != QDataStream::Ok) {
+        Clear();
+        return false;
+    }
+
+    for (const UndoCommand &command : UndoCommands) {
+        MemoryUsage += command.getSize();
+    }
+    for (const UndoCommand &command : RedoCommands) {
+        MemoryUsage += command.getSize();
+    }
+
+    Trim();
+    return true;
+}
+
+void UndoStack::PushCommand(const UndoCommand &command) {
+    for (const UndoCommand &redo : RedoCommands) {
+        MemoryUsage -= redo.getSize();
+    }
+    RedoCommands.clear();
+
+    UndoCommands.append(command);
+    MemoryUsage += command.getSize();
+
+    Trim();
+}
+
+void UndoStack::Trim() {
+    // The oldest undo goes first, then the redo furthest away. The newest
+    // command always stays, however big it is.
+    while (MemoryUsage > MemoryBudget && UndoCommands.size() + RedoCommands.size() > 1) {
+        if (UndoCommands.size() > 1 || RedoCommands.isEmpty()) {
+            MemoryUsage -= UndoCommands.takeFirst().getSize();
+        }
+        else {
+            MemoryUsage -= RedoCommands.takeFirst().getSize();
+        }
+    }
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <functional>
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+#include <QVector>
+
+#include "undoitem.h"
+
+// A group of changes undone and redone as a single step, e.g. everything a
+// shift or an import did
+class UndoCommand {
+public:
+    UndoCommand(const QString &text = QString());
+
+    QString getText() const { return Text; }
+    bool isEmpty() const { return Items.isEmpty(); }
+    qint64 getSize() const { return Size; }
+    const QVector<UndoItem> &getItems() const { return Items; }
+
+    void Append(const UndoItem &item);
+
+    // Return the row of the last cue touched, or -1
+    int Undo(SubtitleTableModel *model) const;
+    int Redo(SubtitleTableModel *model) const;
+
+    void Write(QDataStream &out) const;
+    static UndoCommand Read(QDataStream &in);
+
+private:
+    QString Text;
+    QVector<UndoItem> Items;
+    qint64 Size = 0;
+};
+
+// Undo/redo history. Changes pushed between BeginMacro and EndMacro make up
+// one command. Once the history, undo and redo side together, takes more
+// memory than its budget the oldest commands are dropped, then the redo
+// commands furthest from the present.
+class UndoStack {
+public:
+    static const qint64 DefaultMemoryBudget = 64 * 1024 * 1024;
+
+    // Called with every change as it is pushed, undone or redone, in the
+    // order they get applied. undone tells which way the item went.
+    typedef std::function<void(const UndoItem &item, bool undone)> Recorder;
+
+    UndoStack(qint64 memoryBudget = DefaultMemoryBudget);
+
+    void setRecorder(const Recorder &recorder) { Record = recorder; }
+
+    void setMemoryBudget(qint64 bytes);
+    qint64 getMemoryBudget() const { return MemoryBudget; }
+    qint64 getMemoryUsage() const { return MemoryUsage; }
+
+    // Clears the redo history
+    void Push(const UndoItem &item, const QString &text = QString());
+
+    void BeginMacro(const QString &text);
+    void EndMacro();
+
+    bool canUndo() const { return !UndoCommands.isEmpty(); }
+    bool canRedo() const { return !RedoCommands.isEmpty(); }
+
+    // Move the top command over to the other side and return it for the
+    // caller to apply
+    UndoCommand Undo();
+    UndoCommand Redo();
+
+    void Clear();
+
+    // The whole history as bytes for a project file, and back. Restore
+    // leaves the history empty if data isn't one.
+    QByteArray Save() const;
+    bool Restore(const QByteArray &data);
+
+private:
+    QList<UndoCommand> UndoCommands;
+    QList<UndoCommand> RedoCommands;
+
+    int MacroDepth = 0;
+    UndoCommand Macro;
+
+    qint64 MemoryBudget;
+    qint64 MemoryUsage = 0;
+
+    Recorder Record;
+
+    void PushCommand(const UndoCommand &command);
+    void Trim();
+};
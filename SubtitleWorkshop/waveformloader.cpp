@@ -0,0 +1,166 @@
+#include "waveformloader.h"
+
+#include <cstring>
+
+#include <QSysInfo>
+
+namespace {
+
+bool isNativeOrder(const QAudioFormat &format) {
+    return format.sampleSize() == 8 || format.byteOrder() == (QSysInfo::ByteOrder == QSysInfo::LittleEndian ? QAudioFormat::LittleEndian : QAudioFormat::BigEndian);
+}
+
+// Scales count samples of data to 16 bits. The formats backends actually
+// hand out are covered, false for anything else.
+bool ToInt16(const QAudioFormat &format, const void *data, int count, qint16 *samples) {
+    if (!isNativeOrder(format))
+        return false;
+
+    switch (format.sampleType()) {
+    case QAudioFormat::SignedInt:
+        if (format.sampleSize() == 16) {
+            std::memcpy(samples, data, size_t(count) * sizeof(qint16));
+            return true;
+        }
+        if (format.sampleSize() == 32) {
+            const qint32 *In = static_cast<const qint32 *>(data);
+            for (int i = 0; i < count; i++) samples[i] = qint16(In[i] >> 16);
+            return true;
+        }
+        if (format.sampleSize() == 8) {
+            const qint8 *In = static_cast<const qint8 *>(data);
+            for (int i = 0; i < count; i++) samples[i] = qint16(In[i] * 256);
+            return true;
+        }
+        return false;
+
+    case QAudioFormat::UnSignedInt:
+        if (format.sampleSize() == 8) {
+            const quint8 *In = static_cast<const quint8 *>(data);
+            for (int i = 0; i < count; i++) samples[i] = qint16((int(In[i]) - 128) * 256);
+            return true;
+        }
+        if (format.sampleSize() == 16) {
+            const quint16 *In = static_cast<const quint16 *>(data);
+            for (int i = 0; i < count; i++) samples[i] = qint16(int(In[i]) - 32768);
+            return true;
+        }
+        return false;
+
+    case QAudioFormat::Float:
+        if (format.sampleSize() == 32) {
+            const float *In = static_cast<const float *>(data);
+            for (int i = 0; i < count; i++) samples[i] = qint16(qBound(-32768.0f, In[i] * 32767.0f, 32767.0f));
+            return true;
+        }
+        return false;
+
+    default:
+        return false;
+    }
+}
+
+}
+
+WaveformLoader::WaveformLoader(const QString &mediaPath, int loadId) : MediaPath(mediaPath), LoadId(loadId), Cancelled(false) {}
+
+void WaveformLoader::Cancel() {
+    Cancelled = true;
+}
+
+void WaveformLoader::Run() {
+    if (Peaks.Read(MediaPath)) {
+        emit ProgressChanged(LoadId, 100);
+        Done(true);
+        return;
+    }
+
+    // The output format is left to the backend, not every one converts,
+    // buffers are scaled to 16 bits here instead
+    Decoder = new QAudioDecoder(this);
+    Decoder->setSourceFilename(MediaPath);
+
+    connect(Decoder, SIGNAL(bufferReady()), this, SLOT(DecoderBufferReady()));
+    connect(Decoder, SIGNAL(finished()), this, SLOT(DecoderFinished()));
+    connect(Decoder, SIGNAL(error(QAudioDecoder::Error)), this, SLOT(DecoderError(QAudioDecoder::Error)));
+
+    Decoder->start();
+}
+
+void WaveformLoader::DecoderBufferReady() {
+    if (isDone)
+        return;
+
+    if (Cancelled) {
+        Done(false);
+        return;
+    }
+
+    QAudioBuffer Buffer = Decoder->read();
+    if (!Buffer.isValid())
+        return;
+
+    QAudioFormat Format = Buffer.format();
+    if (Format.sampleRate() <= 0 || Format.channelCount() <= 0) {
+        Done(false);
+        return;
+    }
+
+    if (Peaks.getSampleRate() == 0) {
+        Peaks.Start(Format.sampleRate());
+    }
+
+    // Streams with holes in them, pad so the peaks stay in time
+    if (Buffer.startTime() >= 0) {
+        qint64 StartFrame = Buffer.startTime() * Peaks.getSampleRate() / 1000000;
+        if (StartFrame > Peaks.getFrameCount() + Peaks.getSampleRate() / 10) {
+            Peaks.PadTo(StartFrame);
+        }
+    }
+
+    Samples.resize(Buffer.sampleCount());
+    if (!ToInt16(Format, Buffer.constData(), Samples.size(), Samples.data())) {
+        Done(false);
+        return;
+    }
+
+    Peaks.Append(Samples.constData(), Buffer.frameCount(), Format.channelCount());
+
+    qint64 Duration = Decoder->duration();
+    int percent = Duration > 0 ? int(qBound<qint64>(0, Decoder->position() * 100 / Duration, 100)) : 0;
+    if (percent != Progress) {
+        Progress = percent;
+        emit ProgressChanged(LoadId, percent);
+    }
+}
+
+void WaveformLoader::DecoderFinished() {
+    if (isDone)
+        return;
+
+    Peaks.Finish();
+
+    // Failing to cache only costs decoding again next time
+    if (!Cancelled && !Peaks.isEmpty()) {
+        Peaks.Write(MediaPath);
+    }
+
+    Done(!Peaks.isEmpty());
+}
+
+void WaveformLoader::DecoderError(QAudioDecoder::Error) {
+    Done(false);
+}
+
+void WaveformLoader::Done(bool success) {
+    if (isDone)
+        return;
+
+    isDone = true;
+
+    if (Decoder) {
+        Decoder->stop();
+    }
+
+    emit Finished(LoadId, success && !Cancelled);
+}
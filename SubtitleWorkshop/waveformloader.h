@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+
+#include <QAudioDecoder>
+#include <QObject>
+#include <QVector>
+
+#include "waveformpeaks.h"
+
+// Decodes the audio of a media file on whatever thread it lives in and
+// reduces it to peaks as the buffers come in, so nothing the size of the
+// decoded audio is ever held. Media opened before is read from the cache
+// instead, and freshly decoded peaks are written to it. Signals carry the
+// loadId it was made with, like SubtitleLoader's.
+class WaveformLoader : public QObject {
+    Q_OBJECT
+
+public:
+    WaveformLoader(const QString &mediaPath, int loadId);
+
+    // Safe to call from any thread
+    void Cancel();
+
+    // Complete once Finished is emitted with success
+    const WaveformPeaks &getPeaks() const { return Peaks; }
+
+public slots:
+    void Run();
+
+signals:
+    void ProgressChanged(int loadId, int percent);
+    void Finished(int loadId, bool success);
+
+private slots:
+    void DecoderBufferReady();
+    void DecoderFinished();
+    void DecoderError(QAudioDecoder::Error error);
+
+private:
+    QString MediaPath;
+    int LoadId;
+    WaveformPeaks Peaks;
+    QAudioDecoder *Decoder = nullptr;
+    // A buffer converted to 16 bit samples
+    QVector<qint16> Samples;
+
+    std::atomic<bool> Cancelled;
+    bool isDone = false;
+    int Progress = -1;
+
+    void Done(bool success);
+};
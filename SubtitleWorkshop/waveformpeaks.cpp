@@ -0,0 +1,226 @@
+#include "waveformpeaks.h"
+
+#include <climits>
+#include <cstring>
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+namespace {
+
+const char Magic[8] = { 'S', 'S', 'P', 'E', 'A', 'K', 'S', '\0' };
+const quint32 FormatVersion = 1;
+// Reads back as 0x04030201 on a machine of the other byte order
+const quint32 ByteOrderMark = 0x01020304;
+
+// Levels stop once they would be shorter than this
+const int MinLevelSize = 64;
+
+struct Header {
+    char Magic[8];
+    quint32 Version;
+    quint32 ByteOrder;
+    quint32 SampleRate;
+    quint32 BlockSize;
+    // Of the media the peaks were read from, a cache of anything else is stale
+    qint64 MediaSize;
+    qint64 MediaModified;
+    qint64 Frames;
+    qint64 PeakCount;
+};
+
+}
+
+const QString WaveformPeaks::Suffix = ".peaks";
+
+qint64 WaveformPeaks::getDuration() const {
+    return SampleRate > 0 ? Frames * 1000 / SampleRate : 0;
+}
+
+int WaveformPeaks::LevelFor(double framesPerPixel) const {
+    int Level = 0;
+    while (Level + 1 < Levels.size() && getBlockSize(Level + 1) <= framesPerPixel) {
+        Level++;
+    }
+
+    return Level;
+}
+
+void WaveformPeaks::Start(int sampleRate) {
+    SampleRate = sampleRate;
+    Frames = 0;
+    PendingFrames = 0;
+
+    Levels.clear();
+    Levels.append(QVector<Peak>());
+}
+
+void WaveformPeaks::Append(const qint16 *samples, int frames, int channels) {
+    if (Levels.isEmpty() || channels <= 0)
+        return;
+
+    QVector<Peak> &Base = Levels.first();
+
+    for (int i = 0; i < frames; i++) {
+        const qint16 *Frame = samples + qint64(i) * channels;
+
+        if (PendingFrames == 0) {
+            Pending.Min = Pending.Max = Frame[0];
+        }
+
+        for (int c = 0; c < channels; c++) {
+            Pending.Min = qMin(Pending.Min, Frame[c]);
+            Pending.Max = qMax(Pending.Max, Frame[c]);
+        }
+
+        if (++PendingFrames == BlockSize) {
+            Base.append(Pending);
+            PendingFrames = 0;
+        }
+    }
+
+    Frames += frames;
+}
+
+void WaveformPeaks::PadTo(qint64 frame) {
+    static const qint16 Silence[BlockSize] = {};
+
+    while (Frames < frame) {
+        Append(Silence, int(qMin<qint64>(BlockSize, frame - Frames)), 1);
+    }
+}
+
+void WaveformPeaks::Finish() {
+    if (Levels.isEmpty())
+        return;
+
+    if (PendingFrames > 0) {
+        Levels.first().append(Pending);
+        PendingFrames = 0;
+    }
+
+    BuildLevels();
+}
+
+bool WaveformPeaks::Read(const QString &mediaPath) {
+    QFileInfo Media(mediaPath);
+    if (!Media.exists())
+        return false;
+
+    const QString Paths[] = { CachePathFor(mediaPath), FallbackCachePathFor(mediaPath) };
+
+    for (const QString &path : Paths) {
+        QFile File(path);
+        if (!File.open(QIODevice::ReadOnly))
+            continue;
+
+        Header header;
+        if (File.read(reinterpret_cast<char *>(&header), sizeof(Header)) != qint64(sizeof(Header)))
+            continue;
+
+        if (std::memcmp(header.Magic, Magic, sizeof(Magic)) != 0 || header.Version != FormatVersion || header.ByteOrder != ByteOrderMark || header.BlockSize != quint32(BlockSize) || header.SampleRate == 0)
+            continue;
+
+        if (header.MediaSize != Media.size() || header.MediaModified != Media.lastModified().toMSecsSinceEpoch())
+            continue;
+
+        if (header.PeakCount < 0 || header.PeakCount > INT_MAX || File.size() != qint64(sizeof(Header)) + header.PeakCount * qint64(sizeof(Peak)))
+            continue;
+
+        // The finest level is read straight into place, the rest takes a
+        // few milliseconds even for a feature length movie
+        QVector<Peak> Base(int(header.PeakCount));
+        qint64 Size = header.PeakCount * qint64(sizeof(Peak));
+        if (File.read(reinterpret_cast<char *>(Base.data()), Size) != Size)
+            continue;
+
+        SampleRate = int(header.SampleRate);
+        Frames = header.Frames;
+        PendingFrames = 0;
+
+        Levels.clear();
+        Levels.append(Base);
+        BuildLevels();
+
+        return true;
+    }
+
+    return false;
+}
+
+bool WaveformPeaks::Write(const QString &mediaPath) const {
+    QFileInfo Media(mediaPath);
+    if (isEmpty() || !Media.exists())
+        return false;
+
+    const QVector<Peak> &Base = Levels.first();
+
+    Header header;
+    std::memset(&header, 0, sizeof(Header));
+    std::memcpy(header.Magic, Magic, sizeof(Magic));
+    header.Version = FormatVersion;
+    header.ByteOrder = ByteOrderMark;
+    header.SampleRate = quint32(SampleRate);
+    header.BlockSize = quint32(BlockSize);
+    header.MediaSize = Media.size();
+    header.MediaModified = Media.lastModified().toMSecsSinceEpoch();
+    header.Frames = Frames;
+    header.PeakCount = Base.size();
+
+    auto WriteTo = [&](const QString &path) {
+        QSaveFile File(path);
+        if (!File.open(QIODevice::WriteOnly))
+            return false;
+
+        qint64 Size = qint64(Base.size()) * qint64(sizeof(Peak));
+        if (File.write(reinterpret_cast<const char *>(&header), sizeof(Header)) != qint64(sizeof(Header)) ||
+            File.write(reinterpret_cast<const char *>(Base.constData()), Size) != Size) {
+            File.cancelWriting();
+            return false;
+        }
+
+        return File.commit();
+    };
+
+    // Next to the media, unless it's on a read-only disc or share
+    if (WriteTo(CachePathFor(mediaPath)))
+        return true;
+
+    QString Fallback = FallbackCachePathFor(mediaPath);
+    QDir().mkpath(QFileInfo(Fallback).absolutePath());
+
+    return WriteTo(Fallback);
+}
+
+void WaveformPeaks::BuildLevels() {
+    Levels.resize(1);
+
+    while (Levels.last().size() > MinLevelSize) {
+        const QVector<Peak> &Below = Levels.last();
+
+        QVector<Peak> Level((Below.size() + 1) / 2);
+        for (int i = 0; i < Level.size(); i++) {
+            Peak First = Below.at(2 * i);
+            Peak Second = 2 * i + 1 < Below.size() ? Below.at(2 * i + 1) : First;
+
+            Level[i].Min = qMin(First.Min, Second.Min);
+            Level[i].Max = qMax(First.Max, Second.Max);
+        }
+
+        Levels.append(Level);
+    }
+}
+
+QString WaveformPeaks::CachePathFor(const QString &mediaPath) {
+    return QFileInfo(mediaPath).absoluteFilePath() + Suffix;
+}
+
+QString WaveformPeaks::FallbackCachePathFor(const QString &mediaPath) {
+    QByteArray Hash = QCryptographicHash::hash(QFileInfo(mediaPath).absoluteFilePath().toUtf8(), QCryptographicHash::Sha1);
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/waveforms/" + QString::fromLatin1(Hash.toHex()) + Suffix;
+}
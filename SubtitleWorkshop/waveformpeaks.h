@@ -0,0 +1,62 @@
+#pragma once
+
+#include <QString>
+#include <QVector>
+
+// Min/max envelope of a media file's audio at a range of resolutions. The
+// finest level has a peak per BlockSize sample frames, over all channels,
+// and every level above merges pairs of the one below, so drawing at any
+// zoom reads about one peak per pixel whatever the length of the media.
+//
+// Only the finest level is cached, next to the media or in the cache folder
+// if that isn't writable, the others are rebuilt from it when read back.
+class WaveformPeaks {
+public:
+    struct Peak {
+        qint16 Min;
+        qint16 Max;
+    };
+
+    // Sample frames per peak of the finest level, about 5 ms at 48 kHz
+    static const int BlockSize = 256;
+    static const QString Suffix;
+
+    bool isEmpty() const { return Levels.isEmpty() || Levels.first().isEmpty(); }
+    int getSampleRate() const { return SampleRate; }
+    // In ms
+    qint64 getDuration() const;
+
+    int getLevelCount() const { return Levels.size(); }
+    const QVector<Peak> &getLevel(int level) const { return Levels.at(level); }
+    // Sample frames covered by each peak of level
+    qint64 getBlockSize(int level) const { return qint64(BlockSize) << level; }
+    // Coarsest level with at least a peak per framesPerPixel
+    int LevelFor(double framesPerPixel) const;
+
+    // Building: Start, Append all the audio in order, then Finish
+    void Start(int sampleRate);
+    // Interleaved frames of channels samples each
+    void Append(const qint16 *samples, int frames, int channels);
+    // Fills a gap in the decoded stream with silence up to frame
+    void PadTo(qint64 frame);
+    qint64 getFrameCount() const { return Frames; }
+    void Finish();
+
+    // Returns false if there's no cache for the media as it is now
+    bool Read(const QString &mediaPath);
+    bool Write(const QString &mediaPath) const;
+
+private:
+    int SampleRate = 0;
+    qint64 Frames = 0;
+    QVector<QVector<Peak>> Levels;
+
+    // The block being appended
+    Peak Pending = { 0, 0 };
+    int PendingFrames = 0;
+
+    void BuildLevels();
+
+    static QString CachePathFor(const QString &mediaPath);
+    static QString FallbackCachePathFor(const QString &mediaPath);
+};
@@ -0,0 +1,281 @@
+#include "waveformwidget.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <QMouseEvent>
+#include <QPainter>
+#include <QPaintEvent>
+#include <QTime>
+#include <QWheelEvent>
+
+namespace {
+
+// ms per pixel, a finest peak is about 5 ms so closer than this shows nothing new
+const double MinScale = 0.25;
+const double DefaultScale = 20.0;
+// Zoom per wheel step
+const double ZoomStep = 1.25;
+
+// Tick spacing, the first that leaves room for the labels is used
+const qint64 TickSteps[] = { 100, 200, 500, 1000, 2000, 5000, 10000, 15000, 30000, 60000, 120000, 300000, 600000, 1800000, 3600000 };
+const int MinTickSpacing = 80;
+
+const QColor BackgroundColor(24, 24, 24);
+const QColor WaveColor(96, 196, 128);
+const QColor CueColor(80, 140, 230, 70);
+const QColor CueEdgeColor(80, 140, 230);
+const QColor TickColor(140, 140, 140);
+const QColor PlayheadColor(230, 60, 60);
+
+}
+
+WaveformWidget::WaveformWidget(const SubtitleStore *subtitles, SubtitleTimeline *timeline, QWidget *parent) : QWidget(parent), Subtitles(subtitles), Timeline(timeline), Scale(DefaultScale) {
+    setMinimumHeight(60);
+    setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Fixed);
+    setAttribute(Qt::WA_OpaquePaintEvent);
+}
+
+void WaveformWidget::setPeaks(const WaveformPeaks &peaks) {
+    Peaks = peaks;
+    Status.clear();
+    setView(ViewStart, Scale);
+    update();
+}
+
+void WaveformWidget::setStatus(const QString &text) {
+    Status = text;
+    update();
+}
+
+void WaveformWidget::Clear() {
+    Peaks = WaveformPeaks();
+    Status.clear();
+    Duration = 0;
+    Position = 0;
+    ViewStart = 0;
+    Scale = DefaultScale;
+    update();
+}
+
+void WaveformWidget::setDuration(qint64 duration) {
+    Duration = duration;
+    setView(ViewStart, Scale);
+    update();
+}
+
+void WaveformWidget::setPosition(qint64 position) {
+    int OldX = XAt(Position);
+    Position = position;
+
+    double ViewEnd = TimeAt(width());
+    if (!isSeeking && (position < ViewStart || position >= ViewEnd)) {
+        // A page at a time, with a little of the last one left in view
+        setView(position - (ViewEnd - ViewStart) / 8, Scale);
+        update();
+        return;
+    }
+
+    // Only the columns under the old and new playhead change
+    int NewX = XAt(Position);
+    update(OldX - 1, 0, 3, height());
+    update(NewX - 1, 0, 3, height());
+}
+
+QSize WaveformWidget::sizeHint() const {
+    return QSize(400, 90);
+}
+
+void WaveformWidget::paintEvent(QPaintEvent *e) {
+    QPainter painter(this);
+    QRect Rect = e->rect();
+
+    painter.fillRect(Rect, BackgroundColor);
+
+    if (Peaks.isEmpty() && !Status.isEmpty()) {
+        painter.setPen(TickColor);
+        painter.drawText(rect(), Qt::AlignCenter, Status);
+        return;
+    }
+
+    DrawCues(painter, Rect);
+    DrawWaveform(painter, Rect);
+    DrawTicks(painter, Rect);
+
+    int PlayheadX = XAt(Position);
+    if (Rect.left() <= PlayheadX && PlayheadX <= Rect.right()) {
+        painter.setPen(PlayheadColor);
+        painter.drawLine(PlayheadX, 0, PlayheadX, height());
+    }
+}
+
+void WaveformWidget::mousePressEvent(QMouseEvent *e) {
+    if (e->button() != Qt::LeftButton) {
+        QWidget::mousePressEvent(e);
+        return;
+    }
+
+    isSeeking = true;
+    emit SeekRequested(qMax<qint64>(0, qint64(TimeAt(e->pos().x()))));
+}
+
+void WaveformWidget::mouseMoveEvent(QMouseEvent *e) {
+    if (!isSeeking) {
+        QWidget::mouseMoveEvent(e);
+        return;
+    }
+
+    emit SeekRequested(qMax<qint64>(0, qint64(TimeAt(qBound(0, e->pos().x(), width() - 1)))));
+}
+
+void WaveformWidget::mouseReleaseEvent(QMouseEvent *e) {
+    if (e->button() == Qt::LeftButton) {
+        isSeeking = false;
+    }
+
+    QWidget::mouseReleaseEvent(e);
+}
+
+void WaveformWidget::wheelEvent(QWheelEvent *e) {
+    QPoint Delta = e->angleDelta();
+    double Steps = (Delta.y() != 0 ? Delta.y() : Delta.x()) / 120.0;
+
+    if (Delta.x() != 0 || (e->modifiers() & Qt::ShiftModifier)) {
+        // A tenth of the view per step
+        setView(ViewStart - Steps * width() * Scale / 10, Scale);
+    }
+    else {
+        // The time under the cursor stays where it is
+        double X = e->position().x();
+        double Anchor = TimeAt(X);
+        double NewScale = Scale * std::pow(ZoomStep, -Steps);
+        setView(Anchor - X * NewScale, NewScale);
+    }
+
+    update();
+    e->accept();
+}
+
+void WaveformWidget::resizeEvent(QResizeEvent *e) {
+    setView(ViewStart, Scale);
+    QWidget::resizeEvent(e);
+}
+
+qint64 WaveformWidget::getLength() const {
+    return qMax(Duration, Peaks.getDuration());
+}
+
+void WaveformWidget::setView(double start, double scale) {
+    qint64 Length = getLength();
+    int Width = qMax(1, width());
+
+    // Zoomed out no further than the whole media in view
+    double MaxScale = qMax(DefaultScale, double(Length) / Width);
+    Scale = qBound(MinScale, scale, MaxScale);
+
+    ViewStart = qBound(0.0, start, qMax(0.0, Length - Width * Scale));
+}
+
+void WaveformWidget::DrawTicks(QPainter &painter, const QRect &rect) {
+    qint64 Step = TickSteps[0];
+    for (qint64 step : TickSteps) {
+        Step = step;
+        if (step / Scale >= MinTickSpacing) break;
+    }
+
+    QString Format = Step < 1000 ? "mm:ss.zzz" : "hh:mm:ss";
+
+    painter.setPen(TickColor);
+    QFont Font = painter.font();
+    Font.setPointSize(7);
+    painter.setFont(Font);
+
+    // From a label's width left of the dirty rect, for labels cut in half
+    qint64 First = qint64(TimeAt(rect.left() - MinTickSpacing) / Step) * Step;
+    qint64 Last = qint64(TimeAt(rect.right() + 1));
+
+    for (qint64 time = qMax<qint64>(0, First); time <= Last; time += Step) {
+        int X = XAt(time);
+        painter.drawLine(X, 0, X, 4);
+        painter.drawText(X + 3, 11, QTime::fromMSecsSinceStartOfDay(int(time % 86400000)).toString(Format));
+    }
+}
+
+void WaveformWidget::DrawCues(QPainter &painter, const QRect &rect) {
+    if (Subtitles->isEmpty())
+        return;
+
+    qint64 From = qint64(TimeAt(rect.left()));
+    qint64 To = qint64(TimeAt(rect.right() + 1));
+
+    // However long ago the cues still showing at the left edge started
+    int First = Timeline->FirstEndingAfter(From);
+
+    QFontMetrics Metrics(painter.font());
+
+    for (int row = First; row < Subtitles->size() && Subtitles->getShowTime(row) < To; row++) {
+        qint64 HideTime = Subtitles->getHideTime(row);
+        if (HideTime <= From)
+            continue;
+
+        int Left = XAt(Subtitles->getShowTime(row));
+        int Right = XAt(HideTime);
+        QRect Span(Left, 0, qMax(1, Right - Left), height());
+
+        painter.fillRect(Span, CueColor);
+        painter.setPen(CueEdgeColor);
+        painter.drawLine(Span.topLeft(), Span.bottomLeft());
+
+        if (Span.width() > 20) {
+            QString Text = Metrics.elidedText(Subtitles->getSubtitle(row).simplified(), Qt::ElideRight, Span.width() - 6);
+            painter.setPen(Qt::white);
+            painter.drawText(Span.adjusted(3, 0, -3, -2), Qt::AlignLeft | Qt::AlignBottom, Text);
+        }
+    }
+}
+
+void WaveformWidget::DrawWaveform(QPainter &painter, const QRect &rect) {
+    if (Peaks.isEmpty())
+        return;
+
+    double FramesPerMs = Peaks.getSampleRate() / 1000.0;
+    int Level = Peaks.LevelFor(Scale * FramesPerMs);
+    double BlockSize = double(Peaks.getBlockSize(Level));
+    const QVector<WaveformPeaks::Peak> &LevelPeaks = Peaks.getLevel(Level);
+
+    // Below the tick labels
+    int Middle = 6 + height() / 2;
+    double HalfHeight = (height() - 16) / 2.0;
+
+    QVector<QLine> Lines;
+    Lines.reserve(rect.width());
+
+    for (int x = rect.left(); x <= rect.right(); x++) {
+        // Peaks overlapping the pixel's span of time
+        qint64 FirstPeak = qint64(std::floor(TimeAt(x) * FramesPerMs / BlockSize));
+        qint64 LastPeak = qint64(std::ceil(TimeAt(x + 1) * FramesPerMs / BlockSize));
+        LastPeak = qMax(LastPeak, FirstPeak + 1);
+
+        if (FirstPeak >= LevelPeaks.size())
+            break;
+        if (LastPeak <= 0)
+            continue;
+
+        FirstPeak = qMax<qint64>(0, FirstPeak);
+        LastPeak = qMin<qint64>(LevelPeaks.size(), LastPeak);
+
+        qint16 Min = LevelPeaks.at(int(FirstPeak)).Min;
+        qint16 Max = LevelPeaks.at(int(FirstPeak)).Max;
+        for (qint64 i = FirstPeak + 1; i < LastPeak; i++) {
+            Min = qMin(Min, LevelPeaks.at(int(i)).Min);
+            Max = qMax(Max, LevelPeaks.at(int(i)).Max);
+        }
+
+        int Top = Middle - int(Max * HalfHeight / 32768.0);
+        int Bottom = Middle - int(Min * HalfHeight / 32768.0);
+        Lines.append(QLine(x, Top, x, Bottom));
+    }
+
+    painter.setPen(WaveColor);
+    painter.drawLines(Lines);
+}
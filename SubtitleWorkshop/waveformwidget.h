@@ -0,0 +1,69 @@
+#pragma once
+
+#include <QWidget>
+
+#include "subtitlestore.h"
+#include "subtitletimeline.h"
+#include "waveformpeaks.h"
+
+// Waveform of the media's audio, with the cues drawn as spans over it and
+// a playhead that follows the player. Only the columns being repainted are
+// drawn, each from the peak level closest to a peak per pixel, so zooming
+// and scrolling cost the same for a short clip as for a whole film.
+//
+// The wheel zooms around the cursor, Shift+wheel scrolls, clicking or
+// dragging seeks.
+class WaveformWidget : public QWidget {
+    Q_OBJECT
+
+public:
+    // timeline has to be of subtitles
+    WaveformWidget(const SubtitleStore *subtitles, SubtitleTimeline *timeline, QWidget *parent = nullptr);
+
+    void setPeaks(const WaveformPeaks &peaks);
+    // Shown in place of the waveform while there are no peaks
+    void setStatus(const QString &text);
+    void Clear();
+
+    void setDuration(qint64 duration);
+    // Pages the view along when the playhead leaves it
+    void setPosition(qint64 position);
+
+    QSize sizeHint() const override;
+
+signals:
+    void SeekRequested(qint64 position);
+
+protected:
+    void paintEvent(QPaintEvent *e) override;
+    void mousePressEvent(QMouseEvent *e) override;
+    void mouseMoveEvent(QMouseEvent *e) override;
+    void mouseReleaseEvent(QMouseEvent *e) override;
+    void wheelEvent(QWheelEvent *e) override;
+    void resizeEvent(QResizeEvent *e) override;
+
+private:
+    const SubtitleStore *Subtitles;
+    SubtitleTimeline *Timeline;
+    WaveformPeaks Peaks;
+    QString Status;
+
+    qint64 Duration = 0;
+    qint64 Position = 0;
+    bool isSeeking = false;
+
+    // Time at the left edge and ms per pixel
+    double ViewStart = 0;
+    double Scale;
+
+    double TimeAt(double x) const { return ViewStart + x * Scale; }
+    int XAt(qint64 time) const { return int((time - ViewStart) / Scale); }
+
+    qint64 getLength() const;
+    // Clamped so the view stays over the media
+    void setView(double start, double scale);
+
+    void DrawTicks(QPainter &painter, const QRect &rect);
+    void DrawCues(QPainter &painter, const QRect &rect);
+    void DrawWaveform(QPainter &painter, const QRect &rect);
+};